@@ -0,0 +1,171 @@
+// AffineAugmenter.cpp
+// This file contains the implementation of class AffineAugmenter
+
+#include "AffineAugmenter.h"
+
+using namespace cv;
+
+// Class construction and destruction
+
+AffineAugmenter::AffineAugmenter(CvSize size, bool spectral, int n) 
+  : roiSize(size), blockSize(n), spectralTranslations(spectral), nVariants(0),
+    nextVariant(0), grayFrame(0), nImages(0) {
+  if (blockSize < 1)
+    blockSize = 1;
+
+  offset.x = offset.y = 0;
+  location.x = location.y = 0;
+
+  // the first variant is the frame itself. The others are small rotations
+  // of the frame, each followed by a set of translations. Translations are
+  // not generated when they are accounted for by weights
+  Variant variant = { 0, 0, 0 };
+  variants.push_back(variant);
+  for (double angle = -2.0; angle < 2.0; angle += 0.25) {
+    // the frame itself is already a variant
+    if (angle == 0) continue;
+
+    for (double xdist = -20; xdist <= 20; xdist += 10)
+      for (double ydist = -20; ydist <= 20; ydist += 10) {
+	if (spectralTranslations && (xdist || ydist))
+	  continue;
+	variant.angle = angle;
+	variant.xdist = xdist;
+	variant.ydist = ydist;
+	variants.push_back(variant);
+      }
+  }
+
+  for (int i = 0; i < blockSize; i++) {
+    images.push_back(cvCreateImage(roiSize, IPL_DEPTH_8U, 1));
+    locations.push_back(location);
+    weights.push_back(0);
+  }
+}
+
+AffineAugmenter::~AffineAugmenter() {
+  for (unsigned int i = 0; i < images.size(); i++)
+    cvReleaseImage(&images[i]);
+  if (grayFrame)
+    cvReleaseImage(&grayFrame);
+}
+
+// setFrame
+// Method used to start generating the variants of a frame. We keep a
+// grayscale copy of the frame, which is re-used for frames of the same size
+
+void AffineAugmenter::setFrame(IplImage* frame, CvPoint& roiOffset, CvPoint& loc,
+			       bool augment) {
+  if (!frame) {
+    string err = "AffineAugmenter::setFrame. frame parameter is NULL.";
+    throw (err);
+  }
+  if (roiOffset.x < 0 || roiOffset.y < 0 ||
+      roiOffset.x + roiSize.width > frame->width ||
+      roiOffset.y + roiSize.height > frame->height) {
+    string err = "AffineAugmenter::setFrame. The ROI is not within the frame.";
+    throw (err);
+  }
+
+  CvSize size = cvGetSize(frame);
+  if (grayFrame && (grayFrame->width != size.width || grayFrame->height != size.height))
+    cvReleaseImage(&grayFrame);
+  if (!grayFrame)
+    grayFrame = cvCreateImage(size, IPL_DEPTH_8U, 1);
+
+  if (frame->nChannels != 1)
+    cvCvtColor(frame, grayFrame, CV_BGR2GRAY);
+  else
+    cvCopy(frame, grayFrame);
+
+  offset = roiOffset;
+  location = loc;
+  nVariants = (augment)? variants.size() : 1;
+  nextVariant = 0;
+  nImages = 0;
+}
+
+// next
+// Method used to generate the next block of variants. The variants of a block
+// are warped in parallel, and those whose LOI falls outside the ROI are then
+// dropped. Blocks in which all variants are dropped are skipped. With
+// spectral translations, the weight of a rotation is the number of its
+// translations, itself included, whose LOI is within the ROI
+
+int AffineAugmenter::next() {
+  nImages = 0;
+  while (!nImages && nextVariant < nVariants) {
+    int n = min((unsigned int)blockSize, nVariants - nextVariant);
+
+    #pragma omp parallel for num_threads(omp_get_max_threads())
+    for (int i = 0; i < n; i++) {
+      Variant& variant = variants[nextVariant + i];
+      CvPoint& loc = locations[i];
+      warp(variant, images[i], loc);
+
+      // the frame itself is always used, and is not translated
+      if (!variant.angle && !variant.xdist && !variant.ydist)
+	weights[i] = 1;
+      else if (!spectralTranslations)
+	weights[i] = isInROI(loc)? 1 : 0;
+      else {
+	weights[i] = 0;
+	for (int xdist = -20; xdist <= 20; xdist += 10)
+	  for (int ydist = -20; ydist <= 20; ydist += 10) {
+	    CvPoint shifted = cvPoint(loc.x + xdist, loc.y + ydist);
+	    if (isInROI(shifted))
+	      weights[i]++;
+	  }
+      }
+    }
+    nextVariant += n;
+
+    // move the images that are used to the front of the block
+    for (int i = 0; i < n; i++) {
+      if (!weights[i])
+	continue;
+      swap(images[nImages], images[i]);
+      swap(locations[nImages], locations[i]);
+      swap(weights[nImages], weights[i]);
+      nImages++;
+    }
+  }
+
+  return nImages;
+}
+
+// warp
+// Method used to generate the ROI of a variant of the current frame. The
+// rotation, the translation and the move to the ROI are composed into a
+// single affine transform, so each variant is warped once, and only the
+// ROI is computed. The frame itself is simply copied
+
+void AffineAugmenter::warp(Variant& variant, IplImage* image, CvPoint& roiLocation) {
+  if (!variant.angle && !variant.xdist && !variant.ydist) {
+    for (int i = 0; i < roiSize.height; i++) {
+      unsigned char* src = (unsigned char*)grayFrame->imageData +
+	(offset.y + i) * grayFrame->widthStep + offset.x;
+      unsigned char* dest = (unsigned char*)image->imageData + i * image->widthStep;
+      memcpy(dest, src, roiSize.width);
+    }
+    roiLocation.x = location.x - offset.x;
+    roiLocation.y = location.y - offset.y;
+    return;
+  }
+
+  Mat frameMat(grayFrame);
+  Point2f center(frameMat.cols / 2.0F, frameMat.rows / 2.0F);
+  Mat transform = getRotationMatrix2D(center, variant.angle, 1.0);
+  transform.at<double>(0, 2) += variant.xdist - offset.x;
+  transform.at<double>(1, 2) += variant.ydist - offset.y;
+
+  Mat dest(image);
+  warpAffine(frameMat, dest, transform, dest.size());
+
+  roiLocation.x = cvRound(transform.at<double>(0, 0) * location.x +
+			  transform.at<double>(0, 1) * location.y +
+			  transform.at<double>(0, 2));
+  roiLocation.y = cvRound(transform.at<double>(1, 0) * location.x +
+			  transform.at<double>(1, 1) * location.y +
+			  transform.at<double>(1, 2));
+}
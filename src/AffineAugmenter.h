@@ -0,0 +1,99 @@
+#ifndef __AFFINEAUGMENTER_H
+#define __AFFINEAUGMENTER_H
+
+// AffineAugmenter.h
+// This file contains the definition of class AffineAugmenter. An augmenter
+// generates the small rotations and translations of a training frame that
+// filters are trained on when affine transforms are set. Variants are not
+// kept for the whole frame. They are generated a block at a time, in
+// parallel, as grayscale images of the filter ROI, into buffers that are
+// re-used from block to block and from frame to frame
+// Translations can be approximated in the frequency domain. A circular shift
+// of an unwindowed image multiplies its spectrum by a phase ramp, and the
+// gaussian target moves with the LOI, so it picks up the same ramp. The ramps
+// cancel in both the numerator and the denominator terms of the filter, and
+// the shifted image adds the terms of the unshifted one. Variants are neither
+// circular shifts nor unwindowed, since translations fill the uncovered border
+// with zeros and preprocessing applies a fixed window, so this only holds
+// approximately, and it drops what translations add to training. With
+// spectral translations, only rotations are warped, and each carries the
+// weight of the translations of it whose LOI is within the ROI
+
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+// The standard OpenCV headers
+#include <cv.h>
+
+#include "Globals.h"
+
+using namespace std;
+
+class AffineAugmenter {
+ private:
+  // the parameters of a variant. The frame is rotated by the angle about
+  // its center and then translated
+  struct Variant {
+    double angle;
+    double xdist;
+    double ydist;
+  };
+
+  CvSize roiSize;               // the size of the generated images
+  int blockSize;                // the number of images generated at a time
+  bool spectralTranslations;    // set to weight rotations instead of shifting
+
+  vector<Variant> variants;     // all the variants of a frame
+  unsigned int nVariants;       // the number of variants of the current frame
+  unsigned int nextVariant;     // the next variant to generate
+
+  IplImage* grayFrame;          // the grayscale version of the current frame
+  CvPoint offset;               // the offset of the ROI in the frame
+  CvPoint location;             // the location of the LOI in the frame
+
+  // the images and LOI locations of the current block. Only the first
+  // nImages are valid
+  vector<IplImage*> images;
+  vector<CvPoint> locations;
+  vector<int> weights;
+  int nImages;
+
+  // augmenters are not copied
+  AffineAugmenter(const AffineAugmenter& other);
+  AffineAugmenter& operator=(const AffineAugmenter& other);
+
+ public:
+  AffineAugmenter(CvSize roiSize,
+		  bool spectralTranslations = Globals::spectralTranslations,
+		  int blockSize = Globals::augmentBlockSize);
+  ~AffineAugmenter();
+
+  // method to start generating the variants of a frame. The ROI is the
+  // rectangle of the ROI size at the given offset, and the location is that
+  // of the LOI in the frame. When augment is not set, the only variant is
+  // the ROI itself
+  void setFrame(IplImage* frame, CvPoint& offset, CvPoint& location, bool augment);
+
+  // method to generate the next block of variants. Returns the number of
+  // images generated, which is zero once all variants have been generated.
+  // Variants whose LOI falls outside the ROI are skipped
+  int next();
+
+  // methods to get the images, LOI locations, relative to the ROI, and
+  // weights of the current block. The weight of an image is the number of
+  // variants it stands for. Images are valid until the next call to next
+  IplImage* getImage(int i) { return images[i]; }
+  CvPoint& getLocation(int i) { return locations[i]; }
+  int getWeight(int i) { return weights[i]; }
+
+ private:
+  void warp(Variant& variant, IplImage* image, CvPoint& roiLocation);
+  bool isInROI(CvPoint& roiLocation) {
+    return roiLocation.x >= 0 && roiLocation.x <= roiSize.width &&
+      roiLocation.y >= 0 && roiLocation.y <= roiSize.height;
+  }
+};
+
+#endif // __AFFINEAUGMENTER_H
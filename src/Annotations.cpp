@@ -1,7 +1,8 @@
 // Annotations.cpp
 // This file contains the implementation of class Annotations.
 // This class is used to read an annotations XML doc and provide an
-// iterator to the frame annotations.
+// iterator to the frame annotations. Parsed docs are cached in binary
+// indexes.
 
 #include <string>
 #include <iostream>
@@ -12,8 +13,12 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <string.h>
+#include <stdio.h>
 
 #include "Annotations.h"
 
@@ -21,6 +26,8 @@
 
 Annotations::Annotations() {
   framesDirectory = "";
+  frames = 0;
+  nFrames = 0;
   center.x = Globals::imgWidth / 2;
   center.y = Globals::imgHeight / 2;
   useBins = false;
@@ -38,168 +45,311 @@ Annotations::Annotations() {
 Annotations::~Annotations()
 {
   // delete annotations
-  for (unsigned int i = 0; i < frameAnnotations.size(); i++)
-    delete frameAnnotations[i];
+  delete[] frames;
 }
 
-// getData
-// This function takes as input a string and returns an annotation tag 
-// corresponding to the annotation. It fills the CvPoint object with
-// the data read from that line
-
-Annotations::Tag Annotations::getData(string str, CvPoint& point) {
-  const char* token = strtok((char*)str.c_str(), " <>");
-  if (token) {
-    if (!strcmp(token, "/frame"))
-      return EndFrame;
-    else if (!strcmp(token, "annotations")) {
-      token = strtok(NULL, " <>\"");
-      if (token && !strncmp(token, "dir=", 4)) {
-	token = strtok(NULL, " <>\"");
-	if (!token) {
-	  string err = "Annotations::getData. Malformed annotations.xml. No directory name.";
-	  throw err;
-	}
-	framesDirectory = token;
-      }
-      token = strtok(NULL, " <>\"");
-      if (token && !strncmp(token, "center=", 7)) {
-	token = strtok(NULL, " <>\"");
-	if (!token) {
-	  string err = "Annotations::getData. Malformed annotations.xml. No center.";
-	  throw err;
-	}
-	char* chP = (char*)strchr(token, ',');
-	if (!chP) {
-	  string err = "Annotations::getData. Malformed annotations.xml. No center.";
-	  throw err;
-	}
-	*chP = 0;
-	chP++;
-	center.x = atoi(token);
-	center.y = atoi(chP);
-      }
-      return Root;
-    } else if (!strcmp(token, "frame"))
-      return Frame;
-    else if (!strcmp(token, "frameNumber")) {
-      token = strtok(NULL, " <>");
-      point.x = (token)? atoi(token) : 0;
-      return FrameNumber;
-    } else if (!strcmp(token, "zone")) {
-      token = strtok(NULL, " <>");
-      point.x = (token)? atoi(token) : 0;
-
-      // keep track of min and max zone numbers
-      if (minZone > point.x)
-	minZone = point.x;
-      if (maxZone < point.x)
-	maxZone = point.x;
-
-      return Zone;
-    } else if (token[0] != '/') {
-      string tag = token;
-
-      token = strtok(NULL, " <>");
-      const char* field = strtok((char*)token, ",");
-      point.y = (field)? atoi(field) : 0;
-      field = strtok(NULL, ",");
-      point.x = (field)? atoi(field) : 0;
-
-      if (tag == "leftEye") {
-	if (minLeftEyeX > point.x)
-	  minLeftEyeX = point.x;
-	if (maxLeftEyeX < point.x)
-	  maxLeftEyeX = point.x;
- 	return LeftEye;
-      } else if (tag == "rightEye") {
-	if (minRightEyeX > point.x)
-	  minRightEyeX = point.x;
-	if (maxRightEyeX < point.x)
-	  maxRightEyeX = point.x;
-	return RightEye;
-      } else if (tag == "face") {
-	return Face;
-      } else {
-	if (minNoseX > point.x)
-	  minNoseX = point.x;
-	if (maxNoseX < point.x)
-	  maxNoseX = point.x;
-	return Nose;
-      }
-    }
-  }
-  return Ignore;
+const unsigned int Annotations::version = 2;
+static const char s_magic[8] = "MOSSEAI";
+
+// getIndexFileName
+// Method used to get the name of the index of an annotations file
+
+string Annotations::getIndexFileName(string filename) {
+  return filename + ".idx";
 }
 
 // readAnnotations
-// The following method reads an XML file and populates the annotations vector
+// The following method reads an annotations file and adds its frames to the
+// annotations. The frames are taken from the index of the file when the index
+// is valid. Otherwise the file is parsed and the index is written
 
 void Annotations::readAnnotations(string& filename) {
+  struct stat info;
+  if (stat((const char*)filename.c_str(), &info))
+    return;
+
+  ParsedFileT parsed;
+  if (!Globals::annotationIndexes || !readIndex(filename, info, parsed)) {
+    memset(&parsed.header, 0, sizeof(parsed.header));
+    parsed.header.fileSize = info.st_size;
+    parsed.header.fileTime = info.st_mtime;
+    parsed.header.fileTimeNsec = info.st_mtim.tv_nsec;
+    if (!parse(filename, parsed))
+      return;
+    if (Globals::annotationIndexes)
+      writeIndex(filename, parsed);
+  }
+  addFrames(parsed);
+}
+
+// parse
+// Method used to parse an annotations file in a single pass over its
+// contents. Each element is of the form <tag>value</tag>, except for the root
+// element, which holds the frames directory and the face center as attributes,
+// and the frame elements. LOIs are given as "y,x". A frame without a face
+// takes its nose as the face, and its LOIs carry over to the next frame. The
+// frame number and zone always carry over. Unknown elements are ignored
+
+bool Annotations::parse(string& filename, ParsedFileT& parsed) {
   ifstream file;
+  file.open((const char*)filename.c_str(), ios::in | ios::binary);
+  if (!file.good())
+    return false;
 
-  file.open((const char*)filename.c_str());
-  if (file.good()) {
-    string line;
-    int nFrame = 0;
-    int zone = 0;
-    CvPoint temp, face, leftEye, rightEye, nose;
-    face.x = face.y = leftEye.x = leftEye.y = rightEye.x = rightEye.y = nose.x = nose.y = 0;
-
-    getline(file, line); // ignore the first line
-
-    while (!file.eof()) {
-      getline(file, line);
-      Tag tag = getData(line, temp);
-      switch (tag) {
-      case FrameNumber: {
-	nFrame = temp.x;
-	break;
-      }
-      case Zone: {
-	zone = temp.x;
-	break;
-      }
-      case Face: {
-	face.x = temp.x;
-	face.y = temp.y;
-	break;
-      }
-      case LeftEye: {
-	leftEye.x = temp.x;
-	leftEye.y = temp.y;
-	break;
-      }
-      case RightEye: {
-	rightEye.x = temp.x;
-	rightEye.y = temp.y;
-	break;
-      }
-      case Nose: {
-	nose.x = temp.x;
-	nose.y = temp.y;
-	break;
-      }
-      case EndFrame: {
-	if (face.x && face.y) {
-	  FrameAnnotation* annotation = 
-	    new FrameAnnotation(nFrame, face, leftEye, rightEye, nose, zone);
-	  frameAnnotations.push_back(annotation); 
-	  face.x = face.y = leftEye.x = leftEye.y = rightEye.x = 
-	    rightEye.y = nose.x = nose.y = 0;
-	} else {
-	  FrameAnnotation* annotation = 
-	    new FrameAnnotation(nFrame, nose /* face */, leftEye, rightEye, nose, zone);
-	  frameAnnotations.push_back(annotation); 
-	}
-	break;
-      }
-      default: {
-	break;
+  string text((size_t)parsed.header.fileSize, 0);
+  if (text.size())
+    file.read(&text[0], text.size());
+  text.resize(file.gcount());
+
+  AnnotationIndexHeader& header = parsed.header;
+  header.minZone = INT_MAX;
+  header.maxZone = INT_MIN;
+  header.minLeftEyeX = INT_MAX;
+  header.maxLeftEyeX = INT_MIN;
+  header.minRightEyeX = INT_MAX;
+  header.maxRightEyeX = INT_MIN;
+  header.minNoseX = INT_MAX;
+  header.maxNoseX = INT_MIN;
+
+  AnnotationRecord record;
+  memset(&record, 0, sizeof(record));
+
+  size_t pos = 0;
+  while ((pos = text.find('<', pos)) != string::npos) {
+    size_t end = text.find('>', pos);
+    if (end == string::npos)
+      break;
+    size_t nameStart = pos + 1;
+    size_t nameEnd = text.find_first_of(" \t\r\n/>", nameStart + 1);
+    string name = text.substr(nameStart, nameEnd - nameStart);
+    pos = end + 1;
+
+    if (name.empty() || name[0] == '?' || name[0] == '!')
+      continue;
+    if (name == "/frame") {
+      parsed.records.push_back(record);
+      if (record.face[0] && record.face[1]) {
+	memset(record.face, 0, sizeof(record.face));
+	memset(record.leftEye, 0, sizeof(record.leftEye));
+	memset(record.rightEye, 0, sizeof(record.rightEye));
+	memset(record.nose, 0, sizeof(record.nose));
       }
+      else {
+	parsed.records.back().face[0] = record.nose[0];
+	parsed.records.back().face[1] = record.nose[1];
       }
+      continue;
+    }
+    if (name == "annotations") {
+      string element = text.substr(nameStart, end - nameStart);
+      parseRoot(element, parsed);
+      continue;
+    }
+    if (name[0] == '/' || name == "frame" || text[end - 1] == '/')
+      continue;
+
+    // the value runs up to the next tag
+    size_t valueEnd = text.find('<', pos);
+    string value = text.substr(pos, (valueEnd == string::npos)? string::npos : valueEnd - pos);
+
+    if (name == "frameNumber")
+      record.nFrame = atoi(value.c_str());
+    else if (name == "zone") {
+      record.zone = atoi(value.c_str());
+      updateRange(record.zone, header.minZone, header.maxZone);
+    } else if (name == "face")
+      parsePoint(value.c_str(), record.face);
+    else if (name == "leftEye") {
+      parsePoint(value.c_str(), record.leftEye);
+      updateRange(record.leftEye[0], header.minLeftEyeX, header.maxLeftEyeX);
+    } else if (name == "rightEye") {
+      parsePoint(value.c_str(), record.rightEye);
+      updateRange(record.rightEye[0], header.minRightEyeX, header.maxRightEyeX);
+    } else if (name == "nose") {
+      parsePoint(value.c_str(), record.nose);
+      updateRange(record.nose[0], header.minNoseX, header.maxNoseX);
+    }
+  }
+
+  header.nFrames = parsed.records.size();
+  header.dirLength = parsed.directory.size();
+  return true;
+}
+
+// parseRoot
+// Method used to read the frames directory and the face center, given as
+// "x,y", from the attributes of the root element
+
+void Annotations::parseRoot(string& element, ParsedFileT& parsed) {
+  size_t pos = element.find("dir=");
+  if (pos != string::npos) {
+    size_t start = element.find('"', pos);
+    size_t end = (start == string::npos)? start : element.find('"', start + 1);
+    if (end == string::npos || end == start + 1) {
+      string err = "Annotations::parseRoot. Malformed annotations.xml. No directory name.";
+      throw err;
     }
+    parsed.directory = element.substr(start + 1, end - start - 1);
+    parsed.header.hasDirectory = 1;
   }
+  pos = element.find("center=");
+  if (pos != string::npos) {
+    size_t start = element.find('"', pos);
+    size_t comma = (start == string::npos)? start : element.find(',', start);
+    if (comma == string::npos) {
+      string err = "Annotations::parseRoot. Malformed annotations.xml. No center.";
+      throw err;
+    }
+    parsed.header.centerX = atoi(element.c_str() + start + 1);
+    parsed.header.centerY = atoi(element.c_str() + comma + 1);
+    parsed.header.hasCenter = 1;
+  }
+}
+
+// parsePoint
+// Method used to read a LOI given as "y,x". A missing coordinate is 0
+
+void Annotations::parsePoint(const char* value, int* point) {
+  char* end;
+  point[1] = strtol(value, &end, 10);
+  const char* comma = strchr(end, ',');
+  point[0] = (comma)? strtol(comma + 1, 0, 10) : 0;
+}
+
+// updateRange
+// Method used to extend a range to include a value
+
+void Annotations::updateRange(int value, int& minValue, int& maxValue) {
+  if (minValue > value)
+    minValue = value;
+  if (maxValue < value)
+    maxValue = value;
+}
+
+// mergeRange
+// Method used to extend a range to include another range. Empty ranges, of
+// values that did not occur in a file, leave the range as it is
+
+void Annotations::mergeRange(int otherMin, int otherMax, int& minValue, int& maxValue) {
+  if (otherMin > otherMax)
+    return;
+  updateRange(otherMin, minValue, maxValue);
+  updateRange(otherMax, minValue, maxValue);
+}
+
+// readIndex
+// Method used to read the frames of an annotations file from its index. The
+// method returns false when there is no index, or when the index does not
+// match the file, in which case the file has to be parsed
+
+bool Annotations::readIndex(string& filename, struct stat& info, ParsedFileT& parsed) {
+  string indexFileName = getIndexFileName(filename);
+  int fd = open((const char*)indexFileName.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat indexInfo;
+  if (fstat(fd, &indexInfo) || indexInfo.st_size < (off_t)sizeof(AnnotationIndexHeader)) {
+    close(fd);
+    return false;
+  }
+  size_t mappingSize = indexInfo.st_size;
+  void* mapping = mmap(0, mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED)
+    return false;
+
+  const char* data = (const char*)mapping;
+  const AnnotationIndexHeader* header = (const AnnotationIndexHeader*)data;
+  size_t recordsSize = (size_t)header->nFrames * sizeof(AnnotationRecord);
+  bool valid = !memcmp(header->magic, s_magic, sizeof(s_magic)) &&
+    header->version == version &&
+    header->fileSize == (long long)info.st_size &&
+    header->fileTime == (long long)info.st_mtime &&
+    header->fileTimeNsec == (long long)info.st_mtim.tv_nsec &&
+    mappingSize == sizeof(AnnotationIndexHeader) + recordsSize + header->dirLength;
+
+  if (valid) {
+    parsed.header = *header;
+    const AnnotationRecord* records =
+      (const AnnotationRecord*)(data + sizeof(AnnotationIndexHeader));
+    parsed.records.assign(records, records + header->nFrames);
+    parsed.directory.assign((const char*)records + recordsSize, header->dirLength);
+  }
+  munmap(mapping, mappingSize);
+  return valid;
+}
+
+// writeIndex
+// Method used to write the index of an annotations file. The index is written
+// to a temporary file that is then renamed, so that readers never see a
+// partial index. Indexes are only a cache, so the method silently gives up
+// when the index cannot be written, as for read only data sets
+
+void Annotations::writeIndex(string& filename, ParsedFileT& parsed) {
+  string indexFileName = getIndexFileName(filename);
+  char buffer[Globals::smallBufferSize];
+  sprintf(buffer, ".%d.%d", (int)getpid(), omp_get_thread_num());
+  string tempFileName = indexFileName + buffer;
+
+  memcpy(parsed.header.magic, s_magic, sizeof(s_magic));
+  parsed.header.version = version;
+
+  ofstream file;
+  file.open((const char*)tempFileName.c_str(), ios::out | ios::binary);
+  if (!file.good())
+    return;
+  file.write((const char*)&parsed.header, sizeof(parsed.header));
+  if (parsed.records.size())
+    file.write((const char*)&parsed.records[0],
+	       parsed.records.size() * sizeof(AnnotationRecord));
+  file.write(parsed.directory.c_str(), parsed.directory.size());
+  file.close();
+
+  if (file.fail() || rename((const char*)tempFileName.c_str(),
+			    (const char*)indexFileName.c_str()))
+    unlink((const char*)tempFileName.c_str());
+}
+
+// addFrames
+// Method used to add the frames of a file to the annotations. The frames are
+// kept in a single array, which is grown to hold the new frames
+
+void Annotations::addFrames(ParsedFileT& parsed) {
+  AnnotationIndexHeader& header = parsed.header;
+  if (header.hasDirectory)
+    framesDirectory = parsed.directory;
+  if (header.hasCenter) {
+    center.x = header.centerX;
+    center.y = header.centerY;
+  }
+  mergeRange(header.minZone, header.maxZone, minZone, maxZone);
+  mergeRange(header.minLeftEyeX, header.maxLeftEyeX, minLeftEyeX, maxLeftEyeX);
+  mergeRange(header.minRightEyeX, header.maxRightEyeX, minRightEyeX, maxRightEyeX);
+  mergeRange(header.minNoseX, header.maxNoseX, minNoseX, maxNoseX);
+
+  int n = parsed.records.size();
+  if (!n)
+    return;
+
+  FrameAnnotation* all = new FrameAnnotation[nFrames + n];
+  for (int i = 0; i < nFrames; i++)
+    all[i] = frames[i];
+  for (int i = 0; i < n; i++) {
+    AnnotationRecord& r = parsed.records[i];
+    CvPoint face = cvPoint(r.face[0], r.face[1]);
+    CvPoint leftEye = cvPoint(r.leftEye[0], r.leftEye[1]);
+    CvPoint rightEye = cvPoint(r.rightEye[0], r.rightEye[1]);
+    CvPoint nose = cvPoint(r.nose[0], r.nose[1]);
+    all[nFrames + i] = FrameAnnotation(r.nFrame, face, leftEye, rightEye, nose, r.zone);
+  }
+  delete[] frames;
+  frames = all;
+  nFrames += n;
+
+  frameAnnotations.resize(nFrames);
+  for (int i = 0; i < nFrames; i++)
+    frameAnnotations[i] = &frames[i];
 }
 
 // createBins
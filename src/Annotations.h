@@ -4,7 +4,17 @@
 // Annotations.h
 // This file contains the definition of class Annotations. It provides an interface
 // to read and access the frames stored in an annotations file.
+//
+// An annotations file is parsed once. The frames read from it are saved next to
+// it in a binary index, <annotations file>.idx, which is memory mapped in place
+// of parsing the file for as long as the size and modification time of the file
+// match those recorded in the index. The index layout is as follows,
+//   header        (128 bytes, see AnnotationIndexHeader)
+//   frames        AnnotationRecord[nFrames]
+//   directory     the frames directory, dirLength chars
 
+#include <sys/types.h>
+#include <sys/stat.h>
 #include <string>
 #include <vector>
 
@@ -19,6 +29,40 @@ using namespace std;
 // forward declaration
 class FrameAnnotation;
 
+// the on-disk header of an annotation index
+typedef struct {
+  char magic[8];                // "MOSSEAI" and a null
+  unsigned int version;         // the format version
+  unsigned int nFrames;         // the number of frames
+  long long fileSize;           // the size of the annotations file
+  long long fileTime;           // the modification time of the annotations file
+  long long fileTimeNsec;       // the nanoseconds of the modification time
+  int hasDirectory;             // set when the file names the frames directory
+  int hasCenter;                // set when the file gives the face center
+  int centerX;
+  int centerY;
+  int minZone;
+  int maxZone;
+  int minLeftEyeX;
+  int maxLeftEyeX;
+  int minRightEyeX;
+  int maxRightEyeX;
+  int minNoseX;
+  int maxNoseX;
+  unsigned int dirLength;       // the length of the frames directory name
+  char reserved[36];
+} AnnotationIndexHeader;
+
+// a frame as read from an annotations file and kept in an index
+typedef struct {
+  int nFrame;
+  int zone;
+  int face[2];                  // x and y of each LOI
+  int leftEye[2];
+  int rightEye[2];
+  int nose[2];
+} AnnotationRecord;
+
 class Annotations {
  private:
   // the directory containing the frames for a given annotations.xml file
@@ -27,7 +71,10 @@ class Annotations {
   // the center of the face in zone 3 (straight ahead)
   CvPoint center;
 
-  // the set of all annotations
+  // the set of all annotations. The frames are held in a single array, and
+  // frameAnnotations points at each of them
+  FrameAnnotation* frames;
+  int nFrames;
   vector<FrameAnnotation*> frameAnnotations;
 
   // bins for annotations. We want to only return annotations that are uniformly
@@ -53,6 +100,8 @@ class Annotations {
 
   // flag used to indicate we want binned annotations
   bool useBins;
+
+  static const unsigned int version;
   
  public:  
   enum Tag {
@@ -71,6 +120,9 @@ class Annotations {
   Annotations();
   ~Annotations();
 
+  // method to read an annotations file. Frames are appended to those read
+  // from earlier files. The index of the file is used when it is valid, and
+  // is written otherwise
   void readAnnotations(string& filename);
   CvPoint& getCenter() { return center; }
   string getFramesDirectory() { return framesDirectory; }
@@ -93,11 +145,33 @@ class Annotations {
   }
   void createBins(Annotations::Tag tag = Annotations::Ignore);
 
+  // method to get the name of the index of an annotations file
+  static string getIndexFileName(string filename);
+
  private:
-  Annotations::Tag getData(string str, CvPoint& point);
+  // the header of the file being read, which holds the root attributes
+  // and the extremal values, and the frames read from it
+  typedef struct {
+    AnnotationIndexHeader header;
+    string directory;
+    vector<AnnotationRecord> records;
+  } ParsedFileT;
+
+  bool parse(string& filename, ParsedFileT& parsed);
+  bool readIndex(string& filename, struct stat& info, ParsedFileT& parsed);
+  void writeIndex(string& filename, ParsedFileT& parsed);
+  void addFrames(ParsedFileT& parsed);
+
+  static void parseRoot(string& element, ParsedFileT& parsed);
+  static void parsePoint(const char* value, int* point);
+  static void updateRange(int value, int& minValue, int& maxValue);
+  static void mergeRange(int otherMin, int otherMax, int& minValue, int& maxValue);
 };
 
-// Frame annotations class
+// Frame annotations class. LOIs are kept as pixels, and as sub-pixel
+// locations for LOIs found by filters. Setting a LOI to a pixel sets its
+// sub-pixel location to the pixel, and setting a sub-pixel location sets the
+// pixel to the nearest pixel
 
 class FrameAnnotation {
  private:
@@ -106,31 +180,51 @@ class FrameAnnotation {
   CvPoint leftIris;
   CvPoint rightIris;
   CvPoint nose;
+  CvPoint2D64f face2D;
+  CvPoint2D64f leftIris2D;
+  CvPoint2D64f rightIris2D;
+  CvPoint2D64f nose2D;
   int zone;
 
+  static void setPoint(CvPoint& point, CvPoint2D64f& point2D, CvPoint& value) {
+    point.x = value.x;
+    point.y = value.y;
+    point2D.x = value.x;
+    point2D.y = value.y;
+  }
+  static void setPoint(CvPoint& point, CvPoint2D64f& point2D, CvPoint2D64f& value) {
+    point.x = cvRound(value.x);
+    point.y = cvRound(value.y);
+    point2D.x = value.x;
+    point2D.y = value.y;
+  }
+
  public:
   FrameAnnotation() {
     nFrame = 0;
-    face.x = face.y = 0;
-    leftIris.x = leftIris.y = rightIris.x = rightIris.y = nose.x = nose.y = 0;
+    CvPoint origin = cvPoint(0, 0);
+    setFace(origin);
+    setLeftIris(origin);
+    setRightIris(origin);
+    setNose(origin);
     zone = 0;
   }
   FrameAnnotation(int frame, CvPoint& f, CvPoint& l, CvPoint& r, CvPoint& n, int z) {
     nFrame = frame;
 
-    face.x = f.x; face.y = f.y;
-    leftIris.x = l.x; leftIris.y = l.y;
-    rightIris.x = r.x; rightIris.y = r.y;
-    nose.x = n.x; nose.y = n.y;
+    setFace(f);
+    setLeftIris(l);
+    setRightIris(r);
+    setNose(n);
 
     zone = z;
   }
   FrameAnnotation(FrameAnnotation* fa) {
     nFrame = fa->getFrameNumber();
-    setFace(fa->getFace());
-    setLeftIris(fa->getLeftIris());
-    setRightIris(fa->getRightIris());
-    setNose(fa->getNose());
+    setFace(fa->getFace2D());
+    setLeftIris(fa->getLeftIris2D());
+    setRightIris(fa->getRightIris2D());
+    setNose(fa->getNose2D());
     zone = fa->getZone();
   }
 
@@ -139,6 +233,10 @@ class FrameAnnotation {
   CvPoint& getLeftIris() { return leftIris; }
   CvPoint& getRightIris() { return rightIris; }
   CvPoint& getNose() { return nose; }
+  CvPoint2D64f& getFace2D() { return face2D; }
+  CvPoint2D64f& getLeftIris2D() { return leftIris2D; }
+  CvPoint2D64f& getRightIris2D() { return rightIris2D; }
+  CvPoint2D64f& getNose2D() { return nose2D; }
   int getZone() { return zone; }
 
   CvPoint& getLOI(Annotations::Tag tag) {
@@ -157,24 +255,32 @@ class FrameAnnotation {
     }
     }
   }
+  CvPoint2D64f& getLOI2D(Annotations::Tag tag) {
+    switch (tag) {
+    case Annotations::Face:
+      return getFace2D();
+    case Annotations::LeftEye:
+      return getLeftIris2D();
+    case Annotations::RightEye:
+      return getRightIris2D();
+    case Annotations::Nose:
+      return getNose2D();
+    default: {
+      string err = "FrameAnnotation::getLOI2D. Unknown tag.";
+      throw(err);
+    }
+    }
+  }
 
   // set functions
-  void setFace(CvPoint& point) {
-    face.x = point.x;
-    face.y = point.y;
-  }
-  void setLeftIris(CvPoint& point) {
-    leftIris.x = point.x;
-    leftIris.y = point.y;
-  }
-  void setRightIris(CvPoint& point) {
-    rightIris.x = point.x;
-    rightIris.y = point.y;
-  }
-  void setNose(CvPoint& point) {
-    nose.x = point.x;
-    nose.y = point.y;
-  }
+  void setFace(CvPoint& point) { setPoint(face, face2D, point); }
+  void setLeftIris(CvPoint& point) { setPoint(leftIris, leftIris2D, point); }
+  void setRightIris(CvPoint& point) { setPoint(rightIris, rightIris2D, point); }
+  void setNose(CvPoint& point) { setPoint(nose, nose2D, point); }
+  void setFace(CvPoint2D64f& point) { setPoint(face, face2D, point); }
+  void setLeftIris(CvPoint2D64f& point) { setPoint(leftIris, leftIris2D, point); }
+  void setRightIris(CvPoint2D64f& point) { setPoint(rightIris, rightIris2D, point); }
+  void setNose(CvPoint2D64f& point) { setPoint(nose, nose2D, point); }
 
   // print functions
   void print() {
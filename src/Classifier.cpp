@@ -4,11 +4,15 @@
 // 1. Load models generated by the learner
 // 2. Create location objects to acquire LOIs
 // 3. Extract features using the feature extractor objects
-// 4. Normalize using extremal values seen during learning
+// 4. Normalize using extremal values seen during learning. For models that we
+//    expand into primal weights, the normalization is folded into the weights
 // 5. Classify
 
 #include "Classifier.h"
 
+// static member initialization
+int Classifier::nFramesPerBatch = 16;
+
 // Construction and destruction
 
 // The field outputDirectory will be used to generate all classification data.
@@ -28,29 +32,13 @@ Classifier::Classifier(string output, Trainer::KernelType kernel,
   outputDirectory = output;
   roiFunction = roiFn;
   kernelType = kernel;
+  isCopy = false;
 
   // Build a set of feature extraction objects and stuff them into the
   // extractor vector
-  Feature* f = (Feature*) new FeatureLX();
-  featureExtractors.push_back(f);
-  f = (Feature*) new FeatureRX();
-  featureExtractors.push_back(f);
-  f = (Feature*) new FeatureNX();
-  featureExtractors.push_back(f);
-  f = (Feature*) new FeatureLRDist();
-  featureExtractors.push_back(f);
-  f = (Feature*) new FeatureLNDist();
-  featureExtractors.push_back(f);
-  f = (Feature*) new FeatureRNDist();
-  featureExtractors.push_back(f);
-  f = (Feature*) new FeatureLNAngle();
-  featureExtractors.push_back(f);
-  f = (Feature*) new FeatureRNAngle();
-  featureExtractors.push_back(f);
-  f = (Feature*) new FeatureLRNArea();
-  featureExtractors.push_back(f);
-
-  nFeatures = (int)Feature::End - 1;
+  Trainer::createFeatureExtractors(featureExtractors);
+
+  nFeatures = FeaturePipeline<FeatureSet>::size;
 
   // read extremal feature values and other data generated during
   // training that we need for classification
@@ -79,16 +67,70 @@ Classifier::Classifier(string output, Trainer::KernelType kernel,
     }
     models.push_back(model);
   }
+
+  // expand linear and polynomial models into primal weights when the
+  // expansion is small enough
+  expandModels();
+}
+
+// The copy constructor creates an evaluation worker. The worker shares the
+// models of the given classifier and has its own feature extractors and its own
+// copies of the location extractors, so that workers can classify concurrently
+
+Classifier::Classifier(const Classifier& other)
+  : outputDirectory(other.outputDirectory), roiFunction(other.roiFunction),
+    models(other.models), primalModels(other.primalModels),
+    kernelType(other.kernelType), nFeatures(other.nFeatures),
+    scales(other.scales), offsets(other.offsets), isCopy(true) {
+  Trainer::createFeatureExtractors(featureExtractors);
+  leftEye = other.leftEye->clone();
+  rightEye = other.rightEye->clone();
+  nose = other.nose->clone();
 }
 
 Classifier::~Classifier() {
   for (int i = 0; i < nFeatures; i++)
     delete featureExtractors[i];
 
+  if (isCopy) {
+    delete leftEye;
+    delete rightEye;
+    delete nose;
+    return;
+  }
+
+  for (unsigned int i = 0; i < primalModels.size(); i++)
+    delete primalModels[i];
   for (unsigned int i = 0; i < Globals::numZones; i++)
     free_model(models[i], 1);
 }
 
+// expandModels
+// Method used to convert the loaded models into primal weight vectors over the
+// monomials of the features. We only use the expansion if every zone model can
+// be expanded to the same degree, so that the monomials of a feature vector are
+// computed once and shared by all zones. The feature normalization is folded
+// into the weights so that the expansions take raw feature values. Otherwise we
+// leave primalModels empty and fall back to classifying with the support vectors
+
+void Classifier::expandModels() {
+  for (unsigned int i = 0; i < models.size(); i++) {
+    PrimalModel* primal = PrimalModel::create(models[i], nFeatures,
+					      Globals::maxPrimalTerms,
+					      &scales[0], &offsets[0]);
+    if (!primal ||
+	(primalModels.size() && primalModels[0]->getDegree() != primal->getDegree())) {
+      if (primal)
+	delete primal;
+      for (unsigned int j = 0; j < primalModels.size(); j++)
+	delete primalModels[j];
+      primalModels.clear();
+      return;
+    }
+    primalModels.push_back(primal);
+  }
+}
+
 // readParameters
 // Method that reads parameters.xml from the output directory to get the min
 // and max values for each feature that were seen during training.
@@ -125,13 +167,36 @@ void Classifier::readParameters() {
 	  token = strtok(NULL, " <>");
 	  char* ptr;
 	  max = (token)? strtod(token, &ptr) : max;
-	  featureExtractors[index]->setMinVal(min);
-	  featureExtractors[index]->setMaxVal(max);
+	  if (index < nFeatures) {
+	    featureExtractors[index]->setMinVal(min);
+	    featureExtractors[index]->setMaxVal(max);
+	  }
 	  index++;
 	}
       }
     }    
     file.close();
+
+    // the models are only valid for the feature set they were trained with
+    if (index != nFeatures) {
+      string err = "Classifier::readParameters. " + Globals::paramsFileName +
+	" in output directory " + outputDirectory +
+	" does not match the feature set of this build.";
+      throw (err);
+    }
+
+    // we normalize all data points to lie in the interval [-1, 1] using the
+    // average of the extremal values and their spread. Precompute that as
+    // an affine map per feature
+    for (unsigned int i = 0; i < featureExtractors.size(); i++) {
+      double min = featureExtractors[i]->getMinVal();
+      double max = featureExtractors[i]->getMaxVal();
+      double average = (max + min) / 2.0;
+      double spread = max - min;
+
+      scales.push_back(1.0 / spread);
+      offsets.push_back(-average / spread);
+    }
   } else {
     string err = "Classifier::readParameters. Cannot open " +
       Globals::paramsFileName + " in output directory " +
@@ -142,29 +207,11 @@ void Classifier::readParameters() {
 
 // normalize
 // Method used to normalize data from a given image using extremal values
-// seen during training
+// seen during training. The affine map is computed in readParameters
 
 void Classifier::normalize(vector<double>& data) {
-  // first compute averages and ranges
-  vector<double> average;
-  vector<double> spread;
-
-  // we normalize all data points to lie in the interval [-1, 1] using the
-  // average of the extremal values and their spread
-  for (unsigned int i = 0; i < featureExtractors.size(); i++) {
-    // feature specific normalization
-    double min = featureExtractors[i]->getMinVal();
-    double max = featureExtractors[i]->getMaxVal();
-
-    average.push_back((max + min) / 2.0);
-    spread.push_back(max - min);
-  }
-
-  // normalize values
-  #pragma omp parallel for num_threads(omp_get_max_threads())
-  for (unsigned int i = 0; i < data.size(); i++) {
-    data[i] = (data[i] - average[i]) / spread[i]; 
-  }
+  for (unsigned int i = 0; i < data.size(); i++)
+    data[i] = data[i] * scales[i] + offsets[i];
 }
 
 // getZone
@@ -193,9 +240,9 @@ int Classifier::getZone(IplImage* frame, double& confidence, FrameAnnotation& fa
   CvPoint offset;
 
   // LOIs
-  CvPoint leftEyeLocation;
-  CvPoint rightEyeLocation;
-  CvPoint noseLocation;
+  CvPoint2D64f leftEyeLocation;
+  CvPoint2D64f rightEyeLocation;
+  CvPoint2D64f noseLocation;
 
   // computing the confidence of the location identification
   double leftPSR;
@@ -212,59 +259,93 @@ int Classifier::getZone(IplImage* frame, double& confidence, FrameAnnotation& fa
   offset.x = offset.y = 0;
   IplImage* roi = (roiFunction)? roiFunction(frame, fa, offset, Annotations::Face) : 0;
 
-  // all location extractors do identical preprocessing. Therefore, preprocess
-  // once using say the left eye extractor and re-use it for all three extractors
-  fftw_complex* preprocessedImage = leftEye->getPreprocessedImage((roi)? roi : frame);
+  // in tracking mode, the extractors first look for their LOIs in small
+  // patches around the last locations. In pyramid mode, they then look for
+  // them coarse to fine. The image is only searched in full for the LOIs
+  // that are not found either way
+  IplImage* image = (roi)? roi : frame;
+  bool leftTracked = leftEye->track(image, offset, leftEyeLocation, leftPSR);
+  bool rightTracked = rightEye->track(image, offset, rightEyeLocation, rightPSR);
 
-  #pragma omp parallel sections num_threads(2)
-  {
-    #pragma omp section
+  // all location extractors do identical preprocessing. Therefore, preprocess
+  // once using say the left eye extractor and re-use it for the band limited
+  // searches and the full searches of both eyes
+  fftw_complex* preprocessedImage = 0;
+  if ((!leftTracked && leftEye->searchesSpectrum()) ||
+      (!rightTracked && rightEye->searchesSpectrum()))
+    preprocessedImage = leftEye->getPreprocessedImage(image, faceSpectrum);
+  if (!leftTracked)
+    leftTracked = leftEye->search(image, offset, leftEyeLocation, leftPSR, true,
+				  preprocessedImage);
+  if (!rightTracked)
+    rightTracked = rightEye->search(image, offset, rightEyeLocation, rightPSR, true,
+				    preprocessedImage);
+
+  if (!leftTracked || !rightTracked) {
+    if (!preprocessedImage)
+      preprocessedImage = leftEye->getPreprocessedImage(image, faceSpectrum);
+
+    // when neither eye was tracked, apply both eye filters at once if we can
+    bool paired = !leftTracked && !rightTracked &&
+      Location::applyPair(leftEye, rightEye, preprocessedImage);
+
+    #pragma omp parallel sections num_threads(2)
     {
-      leftEye->setImage(preprocessedImage);
-      leftEye->apply();
-      leftEye->getMaxLocation(leftEyeLocation, leftPSR);
-      leftEyeLocation.x += offset.x;
-      leftEyeLocation.y += offset.y;
-    }
+      #pragma omp section
+      {
+	if (!leftTracked) {
+	  if (!paired) {
+	    leftEye->setImage(preprocessedImage);
+	    leftEye->apply();
+	  }
+	  leftEye->getMaxLocation(leftEyeLocation, leftPSR);
+	  leftEyeLocation.x += offset.x;
+	  leftEyeLocation.y += offset.y;
+	  leftEye->lock(leftEyeLocation);
+	}
+      }
 
-    #pragma omp section
-    {
-      // get the location of the right eye
-      rightEye->setImage(preprocessedImage);
-      rightEye->apply();
-      rightEye->getMaxLocation(rightEyeLocation, rightPSR);
-      rightEyeLocation.x += offset.x;
-      rightEyeLocation.y += offset.y;
+      #pragma omp section
+      {
+	// get the location of the right eye
+	if (!rightTracked) {
+	  if (!paired) {
+	    rightEye->setImage(preprocessedImage);
+	    rightEye->apply();
+	  }
+	  rightEye->getMaxLocation(rightEyeLocation, rightPSR);
+	  rightEyeLocation.x += offset.x;
+	  rightEyeLocation.y += offset.y;
+	  rightEye->lock(rightEyeLocation);
+	}
+      }
     }
   }
 
   if (roi)
     cvReleaseImage(&roi);
 
-  center.x = (leftEyeLocation.x + rightEyeLocation.x) / 2;
-  center.y = leftEyeLocation.y + Globals::noseDrop;
+  center.x = cvRound((leftEyeLocation.x + rightEyeLocation.x) / 2);
+  center.y = cvRound(leftEyeLocation.y) + Globals::noseDrop;
 
   fa.setNose(center);
 
   offset.x = offset.y = 0;
   roi = (roiFunction)? roiFunction(frame, fa, offset, Annotations::Nose) : 0;
-
-  // free the preprocessed image
-  fftw_free(preprocessedImage);
-
-  // all location extractors do identical preprocessing. Therefore, preprocess
-  // once using say the left eye extractor and re-use it for all three extractors
-  preprocessedImage = nose->getPreprocessedImage((roi)? roi : frame);
-
-  // get the location of the nose
-  nose->setImage(preprocessedImage);
-  nose->apply();
-  nose->getMaxLocation(noseLocation, nosePSR);
-  noseLocation.x += offset.x;
-  noseLocation.y += offset.y;
-
-  // free the preprocessed image
-  fftw_free(preprocessedImage);
+  image = (roi)? roi : frame;
+
+  if (!nose->track(image, offset, noseLocation, nosePSR) &&
+      !nose->search(image, offset, noseLocation, nosePSR)) {
+    fftw_complex* preprocessedImage = nose->getPreprocessedImage(image, noseSpectrum);
+
+    // get the location of the nose
+    nose->setImage(preprocessedImage);
+    nose->apply();
+    nose->getMaxLocation(noseLocation, nosePSR);
+    noseLocation.x += offset.x;
+    noseLocation.y += offset.y;
+    nose->lock(noseLocation);
+  }
 
   fa.setLeftIris(leftEyeLocation);
   fa.setRightIris(rightEyeLocation);
@@ -278,21 +359,210 @@ int Classifier::getZone(IplImage* frame, double& confidence, FrameAnnotation& fa
   //    rightPSR << ")" << endl;
 
   // extract features vector
-  vector<double> data;
-  for (int i = 0; i < nFeatures; i++) {
-    double value = featureExtractors[i]->extract(&fa);
-    data.push_back(value);
+  FeatureBatch batch(1);
+  batch.set(0, fa);
+  vector<double> data(nFeatures);
+  batch.extractRows(&data[0]);
+
+  int maxIndex = 0;
+  confidence = -FLT_MAX;
+
+  double dists[Globals::numZones];
+
+  if (primalModels.size()) {
+    // expand the raw feature vector once and score it against each zone.
+    // The normalization is part of the primal weights
+    double terms[primalModels[0]->getNTerms()];
+    primalModels[0]->expand(&data[0], terms);
+    for (unsigned int i = 0; i < Globals::numZones; i++)
+      dists[i] = primalModels[i]->score(terms);
+  } else {
+    normalize(data);
+    classify(data, dists);
+  }
+
+  for (unsigned int i = 0; i < Globals::numZones; i++) {
+    if (confidence < dists[i]) {
+      confidence = dists[i];
+      maxIndex = i + 1;
+    }
   }
 
-  // normalize
-  normalize(data);
+  setZone(maxIndex);
+  return maxIndex;
+}
+
+// getGrayROI
+// Method that returns a grayscale copy of the ROI of a frame for a given LOI,
+// or of the whole frame if there is no ROI function. The caller is expected to
+// release the returned image
+
+IplImage* Classifier::getGrayROI(IplImage* frame, FrameAnnotation& fa,
+				 Annotations::Tag tag, CvPoint& offset) {
+  offset.x = offset.y = 0;
+  IplImage* roi = (roiFunction)? roiFunction(frame, fa, offset, tag) : cvCloneImage(frame);
+
+  if (roi->nChannels != 1 && strcmp(roi->colorModel, "GRAY")) {
+    IplImage* gray = cvCreateImage(cvGetSize(roi), IPL_DEPTH_8U, 1);
+    cvCvtColor(roi, gray, CV_BGR2GRAY);
+    cvReleaseImage(&roi);
+    roi = gray;
+  }
+  return roi;
+}
 
+// getZones
+// Method used to get the zones for a batch of frames. The frames go through the
+// same steps as in getZone, one stage at a time for the whole batch,
+// 1. Crop the face ROI of all frames and convert them to grayscale
+// 2. Preprocess all ROIs and transform them using a batched plan
+// 3. Apply the eye filters to all spectra using a batched inverse plan
+// 4. Repeat 1 to 3 for the nose ROIs, which depend on the eye locations
+// 5. Extract features and score all feature vectors against all zone models
+
+void Classifier::getZones(vector<IplImage*>& frames, vector<FrameAnnotation>& annotations,
+			  vector<int>& zones, vector<double>& confidences,
+			  bool smooth) {
+  if (!leftEye || !rightEye || !nose) {
+    string err = "Classifier::getZones. Location extractors malformed.";
+    throw (err);
+  }
+
+  int n = frames.size();
+  annotations.resize(n);
+  zones.assign(n, 0);
+  confidences.assign(n, -FLT_MAX);
+  if (!n)
+    return;
+
+  vector<IplImage*> rois(n);
+  vector<CvPoint> offsets(n);
+
+  // crop and convert the face ROIs
+  #pragma omp parallel for num_threads(omp_get_max_threads())
+  for (int i = 0; i < n; i++) {
+    CvPoint center = annotations[i].getLOI(Annotations::Face);
+    if (!center.x || !center.y) {
+      center.x = Globals::imgWidth / 2;
+      center.y = Globals::imgHeight / 2;
+      annotations[i].setFace(center);
+    }
+    rois[i] = getGrayROI(frames[i], annotations[i], Annotations::Face, offsets[i]);
+  }
+
+  // all location extractors do identical preprocessing. Therefore, preprocess
+  // once using the left eye extractor and re-use it for the right eye
+  fftw_complex* spectra = leftEye->getFilter()->preprocessBatch(rois);
+
+  vector<CvPoint2D64f> leftEyeLocations;
+  vector<CvPoint2D64f> rightEyeLocations;
+  vector<CvPoint2D64f> noseLocations;
+  vector<double> psrs;
+
+  leftEye->getMaxLocations(spectra, n, leftEyeLocations, psrs, smooth);
+  rightEye->getMaxLocations(spectra, n, rightEyeLocations, psrs, smooth);
+  fftw_free(spectra);
+
+  for (int i = 0; i < n; i++) {
+    cvReleaseImage(&rois[i]);
+
+    leftEyeLocations[i].x += offsets[i].x;
+    leftEyeLocations[i].y += offsets[i].y;
+    rightEyeLocations[i].x += offsets[i].x;
+    rightEyeLocations[i].y += offsets[i].y;
+
+    CvPoint center;
+    center.x = cvRound((leftEyeLocations[i].x + rightEyeLocations[i].x) / 2);
+    center.y = cvRound(leftEyeLocations[i].y) + Globals::noseDrop;
+    annotations[i].setNose(center);
+  }
+
+  // crop and convert the nose ROIs, and get the nose locations
+  #pragma omp parallel for num_threads(omp_get_max_threads())
+  for (int i = 0; i < n; i++)
+    rois[i] = getGrayROI(frames[i], annotations[i], Annotations::Nose, offsets[i]);
+
+  spectra = nose->getFilter()->preprocessBatch(rois);
+  nose->getMaxLocations(spectra, n, noseLocations, psrs, smooth);
+  fftw_free(spectra);
+
+  for (int i = 0; i < n; i++) {
+    cvReleaseImage(&rois[i]);
+
+    noseLocations[i].x += offsets[i].x;
+    noseLocations[i].y += offsets[i].y;
+
+    annotations[i].setLeftIris(leftEyeLocations[i]);
+    annotations[i].setRightIris(rightEyeLocations[i]);
+    annotations[i].setNose(noseLocations[i]);
+  }
+
+  // extract the feature vectors
+  FeatureBatch batch(n);
+  for (int i = 0; i < n; i++)
+    batch.set(i, annotations[i]);
+  vector<double> data(n * nFeatures);
+  batch.extractRows(&data[0]);
+
+  // score all feature vectors against all zones. With primal models, we
+  // expand all feature vectors and take the product of the matrix of
+  // monomials with the matrix of zone weights
+  int nZones = Globals::numZones;
+  vector<double> dists(n * nZones);
+
+  if (primalModels.size()) {
+    int nTerms = primalModels[0]->getNTerms();
+    vector<double> terms(n * nTerms);
+    for (int i = 0; i < n; i++)
+      primalModels[0]->expand(&data[i * nFeatures], &terms[i * nTerms]);
+
+    #pragma omp parallel for num_threads(omp_get_max_threads())
+    for (int i = 0; i < n; i++)
+      for (int z = 0; z < nZones; z++)
+	dists[i * nZones + z] = primalModels[z]->score(&terms[i * nTerms]);
+  } else {
+    for (int i = 0; i < n; i++) {
+      vector<double> row(data.begin() + i * nFeatures, data.begin() + (i + 1) * nFeatures);
+      normalize(row);
+      classify(row, &dists[i * nZones]);
+    }
+  }
+
+  for (int i = 0; i < n; i++) {
+    for (int z = 0; z < nZones; z++) {
+      if (confidences[i] < dists[i * nZones + z]) {
+	confidences[i] = dists[i * nZones + z];
+	zones[i] = z + 1;
+      }
+    }
+  }
+
+  for (int i = 0; i < n; i++)
+    setZone(zones[i]);
+}
+
+// setZone
+// Method used to tell the filters the zone classified for a frame. Online
+// filters use the zone changes for their update policy
+
+void Classifier::setZone(int zone) {
+  leftEye->getFilter()->setZone(zone);
+  rightEye->getFilter()->setZone(zone);
+  nose->getFilter()->setZone(zone);
+}
+
+// classify
+// Method used to compute the distance of a normalized feature vector from the
+// hyperplane of each zone model using the support vectors. This is the fall
+// back when the models cannot be expanded into primal weights
+
+void Classifier::classify(vector<double>& data, double* dists) {
   // create SVM Light objects to classify
   DOC* doc;
   WORD* words = (WORD*)malloc(sizeof(WORD) * (nFeatures + 1));
 
   for (int i = 0; i < nFeatures; i++) {
-    words[i].wnum = featureExtractors[i]->getId();
+    words[i].wnum = i + 1;
     words[i].weight = data[i];
   }
 
@@ -305,11 +575,6 @@ int Classifier::getZone(IplImage* frame, double& confidence, FrameAnnotation& fa
   string comment = "Gaze SVM";
   doc = create_example(-1, 0, 0, 0.0, create_svector(words, (char*)comment.c_str(), 1.0));
 
-  int maxIndex = 0;
-  confidence = -FLT_MAX;
-
-  double dists[Globals::numZones];
-
   // classify using each zone model
   #pragma omp parallel for num_threads(Globals::numZones)
   for (unsigned int i = 0; i < Globals::numZones; i++) {
@@ -318,101 +583,211 @@ int Classifier::getZone(IplImage* frame, double& confidence, FrameAnnotation& fa
     else
       dists[i] = classify_example(models[i], doc);
   }
-  
-  for (unsigned int i = 0; i < Globals::numZones; i++) {
-    if (confidence < dists[i]) {
-      confidence = dists[i];
-      maxIndex = i + 1;
-    }
-  }
 
   free_example(doc, 1);
   free(words);
+}
 
-  return maxIndex;
+// getFrames
+// Method used to collect the annotated frames of a shard across a set of
+// directories. For each frame we return the name of the image file and its
+// annotation
+
+void Classifier::getFrames(vector<string>& directories, int shard, int nShards,
+			   vector<string>& fileNames, vector<FrameAnnotation>& frames) {
+  if (nShards < 1 || shard < 0 || shard >= nShards) {
+    string err = "Classifier::getFrames. Invalid shard.";
+    throw (err);
+  }
+
+  long index = 0;
+  for (unsigned int i = 0; i < directories.size(); i++) {
+    Annotations annotations;
+
+    // read annotations
+    string locationsFileName = directories[i] + "/" + Globals::annotationsFileName;
+    annotations.readAnnotations(locationsFileName);
+
+    // get the frames directory
+    string framesDirectory = annotations.getFramesDirectory();
+
+    vector<FrameAnnotation*>& frameAnnotations = annotations.getFrameAnnotations();
+    for (unsigned int j = 0; j < frameAnnotations.size(); j++, index++) {
+      if (index % nShards != shard)
+	continue;
+
+      char buffer[Globals::midBufferSize];
+      sprintf(buffer, "frame_%d.png", frameAnnotations[j]->getFrameNumber());
+      fileNames.push_back(framesDirectory + "/" + buffer);
+      frames.push_back(*frameAnnotations[j]);
+    }
+  }
 }
 
-// getFilterError
-// Method that computes the error in locating LOIs for this filter with respect 
-// to all the annotated frames in a given training set. The operation is 
-// cummulative
+// evaluate
+// Method used to classify the annotated frames of a shard and compare the zones
+// with the annotated zones. Each worker thread has its own copy of the
+// classifier and its own result, and classifies batches of frames. The results
+// of the workers are merged at the end
+
+EvaluationResult Classifier::evaluate(vector<string>& directories, int shard, int nShards) {
+  vector<string> fileNames;
+  vector<FrameAnnotation> frames;
+  getFrames(directories, shard, nShards, fileNames, frames);
+
+  int nFrames = frames.size();
+  int nBatches = (nFrames + nFramesPerBatch - 1) / nFramesPerBatch;
+  int nWorkers = max(1, min(omp_get_max_threads(), nBatches));
+
+  vector<Classifier*> workers;
+  workers.push_back(this);
+  for (int i = 1; i < nWorkers; i++)
+    workers.push_back(new Classifier(*this));
+
+  vector<EvaluationResult> results(nWorkers, EvaluationResult(Globals::numZones));
+  vector<string> errors(nWorkers);
+
+  #pragma omp parallel for schedule(dynamic) num_threads(nWorkers)
+  for (int b = 0; b < nBatches; b++) {
+    int worker = omp_get_thread_num();
+    if (errors[worker] != "")
+      continue;
 
-double Classifier::getFilterError(string trainingDirectory, Annotations::Tag tag,
-				  ErrorType errorType) {
-  Annotations annotations;
-  Filter* filter = getFilter(tag);
+    int start = b * nFramesPerBatch;
+    int end = min(start + nFramesPerBatch, nFrames);
+    vector<IplImage*> images;
+    try {
+      for (int i = start; i < end; i++) {
+	IplImage* image = cvLoadImage((const char*)fileNames[i].c_str());
+	if (!image) {
+	  string err = "Classifier::evaluate. Cannot load file " + fileNames[i] + ".";
+	  throw (err);
+	}
+	images.push_back(image);
+      }
+
+      // classify with fresh annotations, so that the face center defaults to
+      // the image center as in getZone
+      vector<FrameAnnotation> annotations(images.size());
+      vector<int> zones;
+      vector<double> confidences;
+      workers[worker]->getZones(images, annotations, zones, confidences);
+
+      for (int i = start; i < end; i++)
+	results[worker].add(frames[i].getZone(), zones[i - start]);
+    } catch (string err) {
+      errors[worker] = err;
+    }
+    for (unsigned int i = 0; i < images.size(); i++)
+      cvReleaseImage(&images[i]);
+  }
 
-  // read annotations
-  string locationsFileName = trainingDirectory + "/" + Globals::annotationsFileName;
-  annotations.readAnnotations(locationsFileName);
+  for (int i = 1; i < nWorkers; i++)
+    delete workers[i];
+  for (int i = 0; i < nWorkers; i++)
+    if (errors[i] != "")
+      throw (errors[i]);
 
-  // get the frames directory
-  string framesDirectory = annotations.getFramesDirectory();
+  for (int i = 1; i < nWorkers; i++)
+    results[0].merge(results[i]);
+  return results[0];
+}
 
-  // reset total
-  double totalError = 0;
+// evaluateFilter
+// Method that computes the error in locating a LOI, with respect to the
+// annotated location, for the annotated frames of a shard. Frames without
+// an annotation for the LOI are skipped
+
+EvaluationResult Classifier::evaluateFilter(vector<string>& directories,
+					    Annotations::Tag tag,
+					    int shard, int nShards) {
+  // in pyramid mode, or with band limited filters, LOIs are searched for
+  // coarse to fine using the location extractor
+  Location* location = 0;
+  if (getLocation(tag)->getPyramid() > 1 || getFilter(tag)->isBandLimited())
+    location = getLocation(tag);
+
+  return evaluateFilter(getFilter(tag), location, directories, roiFunction,
+			shard, nShards);
+}
 
-  // iterate over the set of all annotations
-  vector<FrameAnnotation*>& frameAnnotations = annotations.getFrameAnnotations();
-  for (unsigned int i = 0; i < frameAnnotations.size(); i++) {
-    FrameAnnotation* fa = frameAnnotations[i];
+// evaluateFilter
+// Method used to evaluate a given filter on the annotated frames of a shard.
+// Each worker thread has its own copy of the filter, and of the location
+// extractor when one is given
+
+EvaluationResult Classifier::evaluateFilter(Filter* filter, Location* location,
+					    vector<string>& directories,
+					    roiFnT roiFunction,
+					    int shard, int nShards) {
+  Annotations::Tag tag = filter->getTag();
+
+  vector<string> fileNames;
+  vector<FrameAnnotation> frames;
+  getFrames(directories, shard, nShards, fileNames, frames);
+
+  int nFrames = frames.size();
+  int nWorkers = max(1, min(omp_get_max_threads(), nFrames));
+
+  vector<Filter*> filters;
+  filters.push_back(filter);
+  for (int i = 1; i < nWorkers; i++)
+    filters.push_back(filters[0]->clone());
+
+  // each worker searches coarse to fine using its own copy of the location
+  // extractor, and falls back to the filter when the refined location is
+  // not reliable
+  vector<Location*> locations(nWorkers, (Location*)0);
+  if (location)
+    for (int i = 0; i < nWorkers; i++)
+      locations[i] = location->clone();
+
+  vector<EvaluationResult> results(nWorkers, EvaluationResult(Globals::numZones));
+  vector<string> errors(nWorkers);
+
+  #pragma omp parallel for schedule(dynamic) num_threads(nWorkers)
+  for (int i = 0; i < nFrames; i++) {
+    int worker = omp_get_thread_num();
+    if (errors[worker] != "")
+      continue;
 
     // get LOI
-    CvPoint& location = fa->getLOI(tag);
+    CvPoint location = frames[i].getLOI(tag);
     if (!location.x && !location.y)
       continue;
 
-    // compose filename
-    char buffer[256];
-    sprintf(buffer, "frame_%d.png", fa->getFrameNumber());
-    string fileName = framesDirectory + "/" + buffer;
-
     // load image
-    IplImage* inputImg = cvLoadImage((const char*)fileName.c_str());
+    IplImage* inputImg = cvLoadImage((const char*)fileNames[i].c_str());
     if (!inputImg) {
-      string err = "Filter::update. Cannot load file " + fileName + ".";
-      throw (err);
+      errors[worker] = "Classifier::evaluateFilter. Cannot load file " + fileNames[i] + ".";
+      continue;
     }
     IplImage* image = cvCreateImage(cvGetSize(inputImg), IPL_DEPTH_8U, 1);
     cvCvtColor(inputImg, image, CV_BGR2GRAY);
 
-    // get the location of the left eye
     CvPoint offset;
     offset.x = offset.y = 0;
-    IplImage* roi = (roiFunction)? roiFunction(image, *fa, offset, Annotations::Face) : 0;
+    IplImage* roi = (roiFunction)? roiFunction(image, frames[i], offset, Annotations::Face) : 0;
 
     location.x -= offset.x;
     location.y -= offset.y;
 
-    // apply filter
-    fftw_complex* imageFFT = filter->preprocessImage((roi)? roi : image);
-    IplImage* postFilterImg = filter->apply(imageFFT);
-    
-    // compute location
-    double min;
-    double max;
-    CvPoint minLoc;
-    CvPoint maxLoc;
-    cvMinMaxLoc(postFilterImg, &min, &max, &minLoc, &maxLoc);
-
-    // compute squared error as the distance between the location
-    // found and the location as annotated
-    double xdiff = abs(maxLoc.x - location.x);
-    double ydiff = abs(maxLoc.y - location.y);
-
-    switch (errorType) {
-    case OneNorm:
-      totalError += (xdiff + ydiff);
-      break;
-    case TwoNorm:
-      totalError += sqrt(xdiff * xdiff + ydiff * ydiff);
-      break;
-    case MSE:
-      totalError += (xdiff * xdiff + ydiff * ydiff);
-      break;
-    default:
-      totalError += ((xdiff > ydiff)? xdiff : ydiff);
-      break;
+    try {
+      CvPoint origin;
+      CvPoint2D64f maxLoc;
+      double psr;
+      origin.x = origin.y = 0;
+      if (!locations[worker] ||
+	  !locations[worker]->search((roi)? roi : image, origin, maxLoc, psr, false)) {
+	// apply filter and get the location of the peak, refined as by search
+	Filter* filter = filters[worker];
+	fftw_complex* imageFFT = filter->preprocessImage((roi)? roi : image);
+	Location::refinePeak(filter->correlate(imageFFT), maxLoc);
+      }
+
+      results[worker].addFilterError(tag, maxLoc.x - location.x, maxLoc.y - location.y);
+    } catch (string err) {
+      errors[worker] = err;
     }
 
     if (roi)
@@ -421,82 +796,47 @@ double Classifier::getFilterError(string trainingDirectory, Annotations::Tag tag
     cvReleaseImage(&inputImg);
   }
 
-  return totalError / frameAnnotations.size();
+  for (int i = 1; i < nWorkers; i++)
+    delete filters[i];
+  for (int i = 0; i < nWorkers; i++)
+    if (locations[i])
+      delete locations[i];
+  for (int i = 0; i < nWorkers; i++)
+    if (errors[i] != "")
+      throw (errors[i]);
+
+  for (int i = 1; i < nWorkers; i++)
+    results[0].merge(results[i]);
+  return results[0];
 }
 
-// getError
-// Method used to compute an error percentage using the ratio of the number of
-// zones misclassified versus the number of zones correctly classified
-
-pair<double,string> Classifier::getError(string trainingDirectory) {
-  Annotations annotations;
-
-  // read annotations
-  string locationsFileName = trainingDirectory + "/" + Globals::annotationsFileName;
-  annotations.readAnnotations(locationsFileName);
-
-  // get the frames directory
-  string framesDirectory = annotations.getFramesDirectory();
-
-  double missclassified = 0;
+// getFilterError
+// Method that computes the mean error in locating LOIs for this filter with
+// respect to all the annotated frames in a given training set
 
-  int counts[Globals::numZones];
-  int missCounts[Globals::numZones];
-  for (unsigned int i = 0; i < 3; i++) {
-    counts[i] = 0;
-    missCounts[i] = 0;
+double Classifier::getFilterError(string trainingDirectory, Annotations::Tag tag,
+				  ErrorType errorType) {
+  vector<string> directories(1, trainingDirectory);
+  EvaluationResult result = evaluateFilter(directories, tag);
+
+  switch (errorType) {
+  case OneNorm:
+    return result.getOneNormError(tag);
+  case TwoNorm:
+    return result.getTwoNormError(tag);
+  default:
+    return result.getMSE(tag);
   }
+}
 
-  // iterate over the set of all annotations
-  vector<FrameAnnotation*>& frameAnnotations = annotations.getFrameAnnotations();
-  for (unsigned int i = 0; i < frameAnnotations.size(); i++) {
-    FrameAnnotation* fa = frameAnnotations[i];
-
-    int actualZone = fa->getZone();
-    if (actualZone < 3)
-	actualZone = 1;
-    else if (actualZone > 3)
-	actualZone = 3;
-    else
-	actualZone = 2;
-    counts[actualZone - 1]++;
-
-    // compose filename
-    char buffer[256];
-    sprintf(buffer, "frame_%d.png", fa->getFrameNumber());
-    string fileName = framesDirectory + "/" + buffer;
-
-    // load image
-    IplImage* inputImg = cvLoadImage((const char*)fileName.c_str());
-
-    double confidence;
-    FrameAnnotation tf;
-    int zone = getZone(inputImg, confidence, tf);
-    if (zone < 3)
-	zone = 1;
-    else if (zone > 3)
-	zone = 3;
-    else
-	zone = 2;
-
-    if (zone != actualZone) {
-      cout << "Classifier::getError. Expecting zone " << actualZone << 
-	" got zone " << zone << endl;
-      missclassified++;
-      missCounts[actualZone - 1]++;
-    }
-
-    cvReleaseImage(&inputImg);
-  }
+// getError
+// Method used to compute an error percentage using the ratio of the number of
+// frames misclassified by sector versus the number of frames. The message also
+// holds the error by zone
 
-  int nAnnotations = frameAnnotations.size();
-  char buffer[Globals::largeBufferSize];
-  sprintf(buffer, "%d out of %d were miss-classified.", (int)missclassified, nAnnotations);
-  string msg = buffer;
-  sprintf(buffer, " Zones [%d, %d, %d].", counts[0], counts[1], counts[2]);
-  msg += buffer;
-  sprintf(buffer, " Missed [%d, %d, %d].", missCounts[0], missCounts[1], missCounts[2]);
-  msg += buffer;
+pair<double,string> Classifier::getError(string trainingDirectory) {
+  vector<string> directories(1, trainingDirectory);
+  EvaluationResult result = evaluate(directories);
 
-  return make_pair((missclassified / frameAnnotations.size()) * 100, msg);
+  return make_pair(result.getError(), result.getMessage());
 }
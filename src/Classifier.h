@@ -22,6 +22,8 @@
 #include "Location.h"
 #include "Annotations.h"
 #include "Trainer.h"
+#include "PrimalModel.h"
+#include "EvaluationResult.h"
 
 // openCV stuff
 #include <cv.h>
@@ -53,11 +55,32 @@ class Classifier {
   // SVM models vector, one per zone
   vector<MODEL*> models;
 
+  // primal expansions of the models, one per zone. Empty when the models
+  // cannot be expanded, in which case we classify using the support vectors
+  vector<PrimalModel*> primalModels;
+
   // Kernel type
   Trainer::KernelType kernelType; // The kernel type used for training
 
   int nFeatures;                  // the number of features
 
+  // the normalization of feature x is scale * x + offset. The terms are
+  // computed once from the extremal values seen during training
+  vector<double> scales;
+  vector<double> offsets;
+
+  // set for copies created for parallel evaluation. Copies share the models
+  // of the original and own their location extractors
+  bool isCopy;
+
+  // the number of frames each evaluation worker classifies at a time
+  static int nFramesPerBatch;
+
+  // the spectra of the face and nose ROIs of the last frame classified by
+  // getZone. They are re-used from frame to frame
+  Spectrum faceSpectrum;
+  Spectrum noseSpectrum;
+
  public:
   // public types
   enum ErrorType {
@@ -75,6 +98,14 @@ class Classifier {
   // method to get the gaze zone and confidence
   virtual int getZone(IplImage* frame, double& confidence, FrameAnnotation& fa);
 
+  // method to get the gaze zones and confidences for a batch of frames. The
+  // annotations hold the face center of each frame on input and the LOIs on
+  // output. The results match those of getZone for each frame, except that
+  // LOIs are only smoothed over past frames when smooth is set
+  virtual void getZones(vector<IplImage*>& frames, vector<FrameAnnotation>& annotations,
+			vector<int>& zones, vector<double>& confidences,
+			bool smooth = false);
+
   // method to get the error rate
   virtual pair<double, string> getError(string trainingDirectory);
 
@@ -82,24 +113,57 @@ class Classifier {
   virtual double getFilterError(string trainingDirectory, Annotations::Tag tag,
 				ErrorType errorType);
 
+  // methods to evaluate the classifier, or the filter for a LOI, on the
+  // annotated frames in a set of directories. Frames are numbered across
+  // all directories, and only frames whose number modulo nShards is shard
+  // are evaluated. Frames are evaluated in parallel, and LOIs are not
+  // smoothed across frames
+  virtual EvaluationResult evaluate(vector<string>& directories,
+				    int shard = 0, int nShards = 1);
+  virtual EvaluationResult evaluateFilter(vector<string>& directories,
+					  Annotations::Tag tag,
+					  int shard = 0, int nShards = 1);
+
+  // method to evaluate a given filter on the annotated frames in a set of
+  // directories. When a location extractor is given, LOIs are first looked
+  // for using the extractor, as in evaluateFilter. No models are needed
+  static EvaluationResult evaluateFilter(Filter* filter, Location* location,
+					 vector<string>& directories,
+					 roiFnT roiFunction,
+					 int shard = 0, int nShards = 1);
+
   // methods to get and set Location extractors
   void setLeftEyeExtractor(Location* le) { leftEye = le; }
   void setRightEyeExtractor(Location* re) { rightEye = re; }
   void setNoseExtractor(Location* n) { nose = n; }
-  Filter* getFilter(Annotations::Tag tag) {
+  Location* getLocation(Annotations::Tag tag) {
     switch (tag) {
-    case Annotations::LeftEye: return leftEye->getFilter();
-    case Annotations::RightEye: return rightEye->getFilter();
-    case Annotations::Nose: return nose->getFilter();
+    case Annotations::LeftEye: return leftEye;
+    case Annotations::RightEye: return rightEye;
+    case Annotations::Nose: return nose;
     default:
-      string err = "Classifier::getFilter. Unknown tag";
+      string err = "Classifier::getLocation. Unknown tag";
       throw (err);
     }
   }
+  Filter* getFilter(Annotations::Tag tag) { return getLocation(tag)->getFilter(); }
+
+  // method to get the file names and annotations of the annotated frames of
+  // a shard of a set of directories. Frames are numbered across directories
+  static void getFrames(vector<string>& directories, int shard, int nShards,
+			vector<string>& fileNames, vector<FrameAnnotation>& frames);
 
  private:
+  // copy constructor used to create evaluation workers
+  Classifier(const Classifier& other);
+
   void readParameters();
+  void expandModels();
   void normalize(vector<double>& data);
+  void classify(vector<double>& data, double* dists);
+  void setZone(int zone);
+  IplImage* getGrayROI(IplImage* frame, FrameAnnotation& fa, Annotations::Tag tag,
+		       CvPoint& offset);
 };
 
 #endif
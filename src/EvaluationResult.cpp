@@ -0,0 +1,237 @@
+// EvaluationResult.cpp
+// This file contains the implementation of class EvaluationResult
+
+#include "EvaluationResult.h"
+
+// the number of annotation tags
+static const int s_nTags = (int)Annotations::Ignore + 1;
+
+// Class construction
+
+EvaluationResult::EvaluationResult(int n) : nZones(n) {
+  confusion.assign(nZones * (nZones + 1), 0);
+  filterCounts.assign(s_nTags, 0);
+  oneNormSums.assign(s_nTags, 0.0);
+  twoNormSums.assign(s_nTags, 0.0);
+  squaredSums.assign(s_nTags, 0.0);
+}
+
+// add
+// Method used to add the actual and predicted zone of a frame
+
+void EvaluationResult::add(int actualZone, int predictedZone) {
+  if (actualZone < 1 || actualZone > nZones)
+    return;
+  if (predictedZone < 0 || predictedZone > nZones)
+    predictedZone = 0;
+  confusion[(actualZone - 1) * (nZones + 1) + predictedZone]++;
+}
+
+// addFilterError
+// Method used to add the error of a LOI found by a filter with respect to its
+// annotated location
+
+void EvaluationResult::addFilterError(Annotations::Tag tag, double xdiff, double ydiff) {
+  filterCounts[tag]++;
+  oneNormSums[tag] += fabs(xdiff) + fabs(ydiff);
+  twoNormSums[tag] += sqrt(xdiff * xdiff + ydiff * ydiff);
+  squaredSums[tag] += xdiff * xdiff + ydiff * ydiff;
+}
+
+// merge
+// Method used to add the counts and sums of another result to this one
+
+void EvaluationResult::merge(EvaluationResult& other) {
+  if (other.nZones != nZones) {
+    string err = "EvaluationResult::merge. Results have different numbers of zones.";
+    throw (err);
+  }
+  for (unsigned int i = 0; i < confusion.size(); i++)
+    confusion[i] += other.confusion[i];
+  for (int i = 0; i < s_nTags; i++) {
+    filterCounts[i] += other.filterCounts[i];
+    oneNormSums[i] += other.oneNormSums[i];
+    twoNormSums[i] += other.twoNormSums[i];
+    squaredSums[i] += other.squaredSums[i];
+  }
+}
+
+// write
+// Method used to write a result into a text file. The first line has the
+// number of zones, followed by one line per row of the confusion matrix and
+// one line per annotation tag with the filter error count and sums
+
+void EvaluationResult::write(string filename) {
+  ofstream file;
+  file.open((const char*)filename.c_str());
+  if (!file.good()) {
+    string err = "EvaluationResult::write. Unable to open file " + filename;
+    throw (err);
+  }
+
+  file.precision(17);
+  file << nZones << endl;
+  for (int i = 0; i < nZones; i++) {
+    for (int j = 0; j <= nZones; j++)
+      file << ((j)? " " : "") << confusion[i * (nZones + 1) + j];
+    file << endl;
+  }
+  for (int i = 0; i < s_nTags; i++)
+    file << filterCounts[i] << " " << oneNormSums[i] << " " << twoNormSums[i] <<
+      " " << squaredSums[i] << endl;
+
+  if (!file.good()) {
+    string err = "EvaluationResult::write. Error writing file " + filename;
+    throw (err);
+  }
+  file.close();
+}
+
+// read
+// Method used to read a result written using write
+
+void EvaluationResult::read(string filename) {
+  ifstream file;
+  file.open((const char*)filename.c_str());
+  if (!file.good()) {
+    string err = "EvaluationResult::read. Unable to open file " + filename;
+    throw (err);
+  }
+
+  file >> nZones;
+  if (!file.good() || nZones < 1) {
+    string err = "EvaluationResult::read. Malformed result file " + filename;
+    throw (err);
+  }
+
+  confusion.assign(nZones * (nZones + 1), 0);
+  for (unsigned int i = 0; i < confusion.size(); i++)
+    file >> confusion[i];
+  for (int i = 0; i < s_nTags; i++)
+    file >> filterCounts[i] >> oneNormSums[i] >> twoNormSums[i] >> squaredSums[i];
+
+  if (file.fail()) {
+    string err = "EvaluationResult::read. Malformed result file " + filename;
+    throw (err);
+  }
+  file.close();
+}
+
+// getNFrames
+// Method that returns the number of classified frames
+
+long EvaluationResult::getNFrames() {
+  long count = 0;
+  for (unsigned int i = 0; i < confusion.size(); i++)
+    count += confusion[i];
+  return count;
+}
+
+// getSector
+// Method that groups zones into the sectors to the left of, straight ahead of,
+// and to the right of the driver, numbered 1 to 3. Frames for which no zone was
+// predicted fall in the left sector, as they always have
+
+int EvaluationResult::getSector(int zone) {
+  if (zone < 3)
+    return 1;
+  else if (zone > 3)
+    return 3;
+  return 2;
+}
+
+// getNMisclassified
+// Method that returns the number of frames whose predicted sector is not the
+// sector of the annotated zone
+
+long EvaluationResult::getNMisclassified() {
+  long count = 0;
+  for (int i = 1; i <= nZones; i++)
+    for (int j = 0; j <= nZones; j++)
+      if (getSector(i) != getSector(j))
+	count += getCount(i, j);
+  return count;
+}
+
+// getNZoneMisclassified
+// Method that returns the number of frames whose predicted zone is not the
+// annotated zone
+
+long EvaluationResult::getNZoneMisclassified() {
+  long count = 0;
+  for (int i = 1; i <= nZones; i++)
+    for (int j = 0; j <= nZones; j++)
+      if (i != j)
+	count += getCount(i, j);
+  return count;
+}
+
+// getError
+// Method that returns the percentage of frames misclassified by sector
+
+double EvaluationResult::getError() {
+  long nFrames = getNFrames();
+  return (nFrames)? (getNMisclassified() * 100.0) / nFrames : 0.0;
+}
+
+// getZoneError
+// Method that returns the percentage of frames misclassified by zone
+
+double EvaluationResult::getZoneError() {
+  long nFrames = getNFrames();
+  return (nFrames)? (getNZoneMisclassified() * 100.0) / nFrames : 0.0;
+}
+
+double EvaluationResult::getOneNormError(Annotations::Tag tag) {
+  return (filterCounts[tag])? oneNormSums[tag] / filterCounts[tag] : 0.0;
+}
+
+double EvaluationResult::getTwoNormError(Annotations::Tag tag) {
+  return (filterCounts[tag])? twoNormSums[tag] / filterCounts[tag] : 0.0;
+}
+
+double EvaluationResult::getMSE(Annotations::Tag tag) {
+  return (filterCounts[tag])? squaredSums[tag] / filterCounts[tag] : 0.0;
+}
+
+// getMessage
+// Method that returns the number of frames misclassified by sector, and the
+// number of frames and misses per sector, followed by the same numbers by zone
+
+string EvaluationResult::getMessage() {
+  char buffer[Globals::largeBufferSize];
+  sprintf(buffer, "%ld out of %ld were miss-classified.", getNMisclassified(), getNFrames());
+  string msg = buffer;
+
+  long counts[3] = { 0, 0, 0 };
+  long missCounts[3] = { 0, 0, 0 };
+  for (int i = 1; i <= nZones; i++) {
+    for (int j = 0; j <= nZones; j++) {
+      counts[getSector(i) - 1] += getCount(i, j);
+      if (getSector(i) != getSector(j))
+	missCounts[getSector(i) - 1] += getCount(i, j);
+    }
+  }
+  sprintf(buffer, " Zones [%ld, %ld, %ld].", counts[0], counts[1], counts[2]);
+  msg += buffer;
+  sprintf(buffer, " Missed [%ld, %ld, %ld].", missCounts[0], missCounts[1], missCounts[2]);
+  msg += buffer;
+
+  sprintf(buffer, " By zone, %ld out of %ld were miss-classified (%.2f%%).",
+	  getNZoneMisclassified(), getNFrames(), getZoneError());
+  msg += buffer;
+  string zones = " Zones [";
+  string missed = " Missed [";
+  for (int i = 1; i <= nZones; i++) {
+    long count = 0;
+    for (int j = 0; j <= nZones; j++)
+      count += getCount(i, j);
+    sprintf(buffer, "%s%ld", (i > 1)? ", " : "", count);
+    zones += buffer;
+    sprintf(buffer, "%s%ld", (i > 1)? ", " : "", count - getCount(i, i));
+    missed += buffer;
+  }
+  msg += zones + "]." + missed + "].";
+
+  return msg;
+}
@@ -0,0 +1,81 @@
+#ifndef __EVALUATIONRESULT_H
+#define __EVALUATIONRESULT_H
+
+// EvaluationResult.h
+// This file contains the definition of class EvaluationResult. An evaluation
+// result holds the counts and error sums gathered when evaluating the classifier
+// and the filters on annotated frames. Results only hold sums, so results computed
+// on disjoint sets of frames, by different threads, processes or machines, can be
+// merged into the result for the union of those frames. Results can be written to
+// and read from a text file for merging across processes
+
+#include <stdio.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+
+#include "Globals.h"
+#include "Annotations.h"
+
+using namespace std;
+
+class EvaluationResult {
+ private:
+  int nZones;                   // the number of zones
+
+  // the confusion matrix. Rows are actual zones and columns are predicted
+  // zones. Column 0 counts frames for which no zone was predicted
+  vector<long> confusion;
+
+  // filter errors per LOI, indexed by annotation tag. We keep the number of
+  // frames and the sums of the one norm, two norm and squared errors
+  vector<long> filterCounts;
+  vector<double> oneNormSums;
+  vector<double> twoNormSums;
+  vector<double> squaredSums;
+
+ public:
+  EvaluationResult(int nZones = Globals::numZones);
+  ~EvaluationResult() { }
+
+  // methods to add the outcome for a frame. Frames with an actual zone
+  // outside [1, nZones] are ignored
+  void add(int actualZone, int predictedZone);
+  void addFilterError(Annotations::Tag tag, double xdiff, double ydiff);
+
+  // method to add the counts and sums of another result
+  void merge(EvaluationResult& other);
+
+  // methods to write and read a result
+  void write(string filename);
+  void read(string filename);
+
+  int getNZones() { return nZones; }
+  long getCount(int actualZone, int predictedZone) {
+    return confusion[(actualZone - 1) * (nZones + 1) + predictedZone];
+  }
+  long getNFrames();
+
+  // the number and percentage of frames that were misclassified, when zones
+  // are grouped into left, ahead and right sectors, and by zone
+  long getNMisclassified();
+  long getNZoneMisclassified();
+  double getError();
+  double getZoneError();
+
+  // mean filter errors for a LOI
+  long getNFilterFrames(Annotations::Tag tag) { return filterCounts[tag]; }
+  double getOneNormError(Annotations::Tag tag);
+  double getTwoNormError(Annotations::Tag tag);
+  double getMSE(Annotations::Tag tag);
+
+  // method to get a readable summary of the classification results
+  string getMessage();
+
+  // the sector, from 1 to 3, of a zone
+  static int getSector(int zone);
+};
+
+#endif // __EVALUATIONRESULT_H
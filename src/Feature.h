@@ -25,12 +25,26 @@ class Feature : public FeatureBase {
     LNAngle,                   // angle between the left eye and the nose
     RNAngle,                   // angle between the right eye and the nose
     LRNArea,                   // the area of the triangle made by L, R and N
+    LCDist,                    // distance between the left eye and the image center
+    RCDist,                    // distance between the right eye and the image center
+    LCAngle,                   // angle between the left eye and the image center
+    RCAngle,                   // angle between the right eye and the image center
+    LRCArea,                   // the area of the triangle made by L, R and the center
+    LTLDist,                   // distance between the left top corner and the left eye
+    LTRDist,                   // distance between the left top corner and the right eye
+    RTLDist,                   // distance between the right top corner and the left eye
+    RTRDist,                   // distance between the right top corner and the right eye
     End,
   } FeatureTag;
 
   // short names for the features
   static string featureNames[Feature::End];
 
+  // the type of the functions that compute a feature from the coordinates
+  // of the left eye, right eye and nose
+  typedef double (*ValueFnT)(double lx, double ly, double rx, double ry,
+			     double nx, double ny);
+
  protected:
   FeatureTag id;               // the identifier for this feature
   double minVal;               // the smallest value of a feature
@@ -43,17 +57,41 @@ class Feature : public FeatureBase {
     return sqrt(xdiff * xdiff + ydiff * ydiff);
   }
 
+  // helper method that computes a feature for the LOIs in an annotation and
+  // widens the range of the feature to cover the result
+  double extractValue(FrameAnnotation* annotation, ValueFnT value) {
+    CvPoint2D64f& pointl = annotation->getLeftIris2D();
+    CvPoint2D64f& pointr = annotation->getRightIris2D();
+    CvPoint2D64f& pointn = annotation->getNose2D();
+
+    double result = value(pointl.x, pointl.y, pointr.x, pointr.y, pointn.x, pointn.y);
+    if (minVal > result)
+      minVal = result;
+    if (maxVal < result)
+      maxVal = result;
+    return result;
+  }
+
  public:  
   Feature(FeatureTag t) : id(t) {
     featureNames[0] = "LX";
     featureNames[1] = "RX";
     featureNames[2] = "NX";
     featureNames[3] = "LRDist";
-    featureNames[4] = "RNDist";
-    featureNames[5] = "LNDist";
+    featureNames[4] = "LNDist";
+    featureNames[5] = "RNDist";
     featureNames[6] = "LNAngle";
     featureNames[7] = "RNAngle";
     featureNames[8] = "LRNArea";
+    featureNames[9] = "LCDist";
+    featureNames[10] = "RCDist";
+    featureNames[11] = "LCAngle";
+    featureNames[12] = "RCAngle";
+    featureNames[13] = "LRCArea";
+    featureNames[14] = "LTLDist";
+    featureNames[15] = "LTRDist";
+    featureNames[16] = "RTLDist";
+    featureNames[17] = "RTRDist";
   }
   virtual ~Feature() {
   }
@@ -69,8 +107,11 @@ class Feature : public FeatureBase {
   void setMinVal(double min) { minVal = min; }
   void setMaxVal(double max) { maxVal = max; }
 
-  // get feature id as an integer for SVM Light
+  // get feature id as an integer
   long getId() { return (long)id; }
+
+  // get the short name of this feature
+  string getName() { return featureNames[id - 1]; }
 };
 
 #endif
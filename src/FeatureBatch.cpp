@@ -0,0 +1,99 @@
+// FeatureBatch.cpp
+// This file contains the implementation of class FeatureBatch
+
+#include "FeatureBatch.h"
+
+// Class construction
+
+FeatureBatch::FeatureBatch(int n) {
+  resize(n);
+}
+
+// resize
+// Method used to set the number of frames in the batch
+
+void FeatureBatch::resize(int n) {
+  nFrames = n;
+  lx.resize(n);
+  ly.resize(n);
+  rx.resize(n);
+  ry.resize(n);
+  nx.resize(n);
+  ny.resize(n);
+}
+
+// set
+// Method used to set the locations of interest of a frame
+
+void FeatureBatch::set(int frame, FrameAnnotation& fa) {
+  CvPoint2D64f& pointl = fa.getLeftIris2D();
+  CvPoint2D64f& pointr = fa.getRightIris2D();
+  CvPoint2D64f& pointn = fa.getNose2D();
+
+  lx[frame] = pointl.x;
+  ly[frame] = pointl.y;
+  rx[frame] = pointr.x;
+  ry[frame] = pointr.y;
+  nx[frame] = pointn.x;
+  ny[frame] = pointn.y;
+}
+
+void FeatureBatch::set(vector<FrameAnnotation*>& annotations) {
+  resize(annotations.size());
+  for (int i = 0; i < nFrames; i++)
+    set(i, *annotations[i]);
+}
+
+// extract
+// Method used to compute all features for all frames
+
+void FeatureBatch::extract(double* columns) {
+  if (!nFrames)
+    return;
+
+  FeaturePoints points;
+  points.lx = &lx[0];
+  points.ly = &ly[0];
+  points.rx = &rx[0];
+  points.ry = &ry[0];
+  points.nx = &nx[0];
+  points.ny = &ny[0];
+  FeaturePipeline<FeatureSet>::extract(points, nFrames, columns);
+}
+
+// extractRows
+// Method used to compute all features for all frames, with the features of
+// each frame stored together
+
+void FeatureBatch::extractRows(double* rows) {
+  int nFeatures = getNFeatures();
+  if (!nFrames)
+    return;
+  columnBuffer.resize(nFrames * nFeatures);
+  extract(&columnBuffer[0]);
+
+  for (int i = 0; i < nFrames; i++)
+    for (int j = 0; j < nFeatures; j++)
+      rows[i * nFeatures + j] = columnBuffer[j * nFrames + i];
+}
+
+// reduce
+// Method used to widen the given feature ranges to cover a set of features
+// computed as columns
+
+void FeatureBatch::reduce(const double* columns, int n, double* mins, double* maxs) {
+  int nFeatures = getNFeatures();
+  for (int j = 0; j < nFeatures; j++) {
+    const double* values = columns + j * n;
+    double minVal = mins[j];
+    double maxVal = maxs[j];
+    for (int i = 0; i < n; i++) {
+      if (minVal > values[i])
+	minVal = values[i];
+      if (maxVal < values[i])
+	maxVal = values[i];
+    }
+    mins[j] = minVal;
+    maxs[j] = maxVal;
+  }
+}
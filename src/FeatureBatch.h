@@ -0,0 +1,65 @@
+#ifndef __FEATUREBATCH_H
+#define __FEATUREBATCH_H
+
+// FeatureBatch.h
+// This file contains the definition of class FeatureBatch. A feature batch
+// holds the locations of interest of a set of frames as separate arrays of
+// coordinates, and computes the features of FeatureSet for all frames at once.
+// Each feature is computed by a single loop over the coordinate arrays, using
+// the value function of the matching Feature class.
+// Unlike the Feature classes, a batch does not track the range of the values
+// it computes. Ranges are computed by the separate reduce method, so batches
+// can be used concurrently and the reduction can be skipped when the ranges
+// are not needed
+
+#include <math.h>
+#include <float.h>
+#include <iostream>
+#include <vector>
+
+#include "Globals.h"
+#include "Annotations.h"
+#include "FeatureSet.h"
+
+using namespace std;
+
+class FeatureBatch {
+ private:
+  int nFrames;                  // the number of frames in the batch
+
+  // the coordinates of the left eye, right eye and nose of each frame
+  vector<double> lx;
+  vector<double> ly;
+  vector<double> rx;
+  vector<double> ry;
+  vector<double> nx;
+  vector<double> ny;
+
+  // buffer used to compute rows of features
+  vector<double> columnBuffer;
+
+ public:
+  FeatureBatch(int n = 0);
+  ~FeatureBatch() { }
+
+  // the number of features computed for each frame
+  static int getNFeatures() { return FeaturePipeline<FeatureSet>::size; }
+
+  // methods to set the number of frames and the locations of a frame
+  void resize(int n);
+  int getNFrames() { return nFrames; }
+  void set(int frame, FrameAnnotation& fa);
+  void set(vector<FrameAnnotation*>& annotations);
+
+  // methods to compute all features for all frames. The value of the j-th
+  // feature of the set for frame i is at columns[j * nFrames + i] when
+  // computed as columns, and at rows[i * nFeatures + j] when computed as rows
+  void extract(double* columns);
+  void extractRows(double* rows);
+
+  // method to widen the ranges in mins and maxs to cover the features of n
+  // frames computed as columns
+  static void reduce(const double* columns, int n, double* mins, double* maxs);
+};
+
+#endif // __FEATUREBATCH_H
@@ -15,32 +15,29 @@ class FeatureLCAngle : public Feature {
   virtual ~FeatureLCAngle() {
   }
 
-  // the extract method is expected to be implemented in each derived class
-  virtual double extract(FrameAnnotation* annotation) { 
-    CvPoint& pointl = annotation->getLeftIris();
-    CvPoint center;
-    center.x = Globals::imgWidth / 2;
-    center.y = Globals::imgHeight / 2;
-
-    // compute the drop point directly below the eye that is in line with
-    // the nose
-    CvPoint drop;
-    drop.x = pointl.x;
-    drop.y = center.y;
-
-    // compute distances
-    double lcdist = distance(pointl, center);
-    double lddist = distance(pointl, drop);
+  // method that computes the feature from the coordinates of the eyes and
+  // the nose. It is shared by extract and by the batch feature pipeline
+  static double value(double lx, double ly, double rx, double ry,
+		      double nx, double ny) {
+    double cx = Globals::imgWidth / 2;
+    double cy = Globals::imgHeight / 2;
+
+    // compute distances. The distance from the eye to the drop point directly
+    // below it that is in line with the center is their vertical distance
+    double xdiff = lx - cx;
+    double ydiff = ly - cy;
+    double lcdist = sqrt(xdiff * xdiff + ydiff * ydiff);
+    double lddist = fabs(ydiff);
 
     // compute and return angle
     double rads = acos(lddist / lcdist);
-    double result = (pointl.x < center.x)? 
+    return (lx < cx)? 
       90 - ((180 / M_PI) * rads) : 90 + ((180 / M_PI) * rads);
-    if (minVal > result)
-      minVal = result;
-    if (maxVal < result)
-      maxVal = result;
-    return result;
+  }
+
+  // the extract method is expected to be implemented in each derived class
+  virtual double extract(FrameAnnotation* annotation) { 
+    return extractValue(annotation, value);
   }
 };
 
@@ -15,22 +15,22 @@ class FeatureLCDist : public Feature {
   virtual ~FeatureLCDist() {
   }
 
+  // method that computes the feature from the coordinates of the eyes and
+  // the nose. It is shared by extract and by the batch feature pipeline
+  static double value(double lx, double ly, double rx, double ry,
+		      double nx, double ny) {
+    double cx = Globals::imgWidth / 2;
+    double cy = Globals::imgHeight / 2;
+
+    double xdiff = lx - cx;
+    double ydiff = ly - cy;
+
+    return sqrt(xdiff * xdiff + ydiff * ydiff);
+  }
+
   // the extract method is expected to be implemented in each derived class
   virtual double extract(FrameAnnotation* annotation) { 
-    CvPoint& pointl = annotation->getLeftIris();
-    CvPoint center;
-    center.x = Globals::imgWidth / 2;
-    center.y = Globals::imgHeight / 2;
-
-    double xdiff = pointl.x - center.x;
-    double ydiff = pointl.y - center.y;
-
-    double result = sqrt(xdiff * xdiff + ydiff * ydiff);
-    if (minVal > result)
-      minVal = result;
-    if (maxVal < result)
-      maxVal = result;
-    return result;
+    return extractValue(annotation, value);
   }
 };
 
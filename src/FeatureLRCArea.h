@@ -15,28 +15,28 @@ class FeatureLRCArea : public Feature {
   virtual ~FeatureLRCArea() {
   }
 
-  // the extract method is expected to be implemented in each derived class
-  virtual double extract(FrameAnnotation* annotation) { 
-    CvPoint& pointl = annotation->getLeftIris();
-    CvPoint& pointr = annotation->getRightIris();
-    CvPoint center;
-    center.x = Globals::imgWidth / 2;
-    center.y = Globals::imgHeight / 2;
+  // method that computes the feature from the coordinates of the eyes and
+  // the nose. It is shared by extract and by the batch feature pipeline
+  static double value(double lx, double ly, double rx, double ry,
+		      double nx, double ny) {
+    double cx = Globals::imgWidth / 2;
+    double cy = Globals::imgHeight / 2;
 
     // compute distances
-    double lcdist = abs(center.y - pointl.y);
-    double lrdist = abs(pointl.x - pointr.x);
+    double lcdist = fabs(cy - ly);
+    double lrdist = fabs(lx - rx);
 
     // compute area
     double result = lcdist * lrdist / 2.0;
-    if ((pointr.x + lrdist / 2) < center.x)
+    if ((rx + lrdist / 2) < cx)
       result = -result;
-    if (minVal > result)
-      minVal = result;
-    if (maxVal < result)
-      maxVal = result;
     return result;
   }
+
+  // the extract method is expected to be implemented in each derived class
+  virtual double extract(FrameAnnotation* annotation) { 
+    return extractValue(annotation, value);
+  }
 };
 
 #endif
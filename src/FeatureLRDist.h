@@ -15,20 +15,19 @@ class FeatureLRDist : public Feature {
   virtual ~FeatureLRDist() {
   }
 
-  // the extract method is expected to be implemented in each derived class
-  virtual double extract(FrameAnnotation* annotation) { 
-    CvPoint& pointl = annotation->getLeftIris();
-    CvPoint& pointr = annotation->getRightIris();
+  // method that computes the feature from the coordinates of the eyes and
+  // the nose. It is shared by extract and by the batch feature pipeline
+  static double value(double lx, double ly, double rx, double ry,
+		      double nx, double ny) {
+    double xdiff = lx - rx;
+    double ydiff = ly - ry;
 
-    double xdiff = pointl.x - pointr.x;
-    double ydiff = pointl.y - pointr.y;
+    return sqrt(xdiff * xdiff + ydiff * ydiff);
+  }
 
-    double result = sqrt(xdiff * xdiff + ydiff * ydiff);
-    if (minVal > result)
-      minVal = result;
-    if (maxVal < result)
-      maxVal = result;
-    return result;
+  // the extract method is expected to be implemented in each derived class
+  virtual double extract(FrameAnnotation* annotation) { 
+    return extractValue(annotation, value);
   }
 };
 
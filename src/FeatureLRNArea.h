@@ -15,26 +15,25 @@ class FeatureLRNArea : public Feature {
   virtual ~FeatureLRNArea() {
   }
 
-  // the extract method is expected to be implemented in each derived class
-  virtual double extract(FrameAnnotation* annotation) { 
-    CvPoint& pointl = annotation->getLeftIris();
-    CvPoint& pointr = annotation->getRightIris();
-    CvPoint& pointn = annotation->getNose();
-
+  // method that computes the feature from the coordinates of the eyes and
+  // the nose. It is shared by extract and by the batch feature pipeline
+  static double value(double lx, double ly, double rx, double ry,
+		      double nx, double ny) {
     // compute distances
-    double lndist = abs(pointn.y - pointl.y);
-    double lrdist = abs(pointl.x - pointr.x);
+    double lndist = fabs(ny - ly);
+    double lrdist = fabs(lx - rx);
 
     // compute area
     double result = lndist * lrdist / 2.0;
-    if (pointn.x < (pointr.x + lrdist / 2))
+    if (nx < (rx + lrdist / 2))
       result = -result;
-    if (minVal > result)
-      minVal = result;
-    if (maxVal < result)
-      maxVal = result;
     return result;
   }
+
+  // the extract method is expected to be implemented in each derived class
+  virtual double extract(FrameAnnotation* annotation) { 
+    return extractValue(annotation, value);
+  }
 };
 
 #endif
@@ -15,16 +15,16 @@ class FeatureLTLDist : public Feature {
   virtual ~FeatureLTLDist() {
   }
 
+  // method that computes the feature from the coordinates of the eyes and
+  // the nose. It is shared by extract and by the batch feature pipeline
+  static double value(double lx, double ly, double rx, double ry,
+		      double nx, double ny) {
+    return sqrt(lx * lx + ly * ly);
+  }
+
   // the extract method is expected to be implemented in each derived class
   virtual double extract(FrameAnnotation* annotation) { 
-    CvPoint& pointl = annotation->getLeftIris();
-
-    double result = sqrt(pointl.x * pointl.x + pointl.y * pointl.y);
-    if (minVal > result)
-      minVal = result;
-    if (maxVal < result)
-      maxVal = result;
-    return result;
+    return extractValue(annotation, value);
   }
 };
 
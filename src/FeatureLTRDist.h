@@ -15,16 +15,16 @@ class FeatureLTRDist : public Feature {
   virtual ~FeatureLTRDist() {
   }
 
+  // method that computes the feature from the coordinates of the eyes and
+  // the nose. It is shared by extract and by the batch feature pipeline
+  static double value(double lx, double ly, double rx, double ry,
+		      double nx, double ny) {
+    return sqrt(rx * rx + ry * ry);
+  }
+
   // the extract method is expected to be implemented in each derived class
   virtual double extract(FrameAnnotation* annotation) { 
-    CvPoint& pointr = annotation->getRightIris();
-
-    double result = sqrt(pointr.x * pointr.x + pointr.y * pointr.y);
-    if (minVal > result)
-      minVal = result;
-    if (maxVal < result)
-      maxVal = result;
-    return result;
+    return extractValue(annotation, value);
   }
 };
 
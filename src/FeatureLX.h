@@ -17,14 +17,16 @@ class FeatureLX : public Feature {
   virtual ~FeatureLX() {
   }
 
+  // method that computes the feature from the coordinates of the eyes and
+  // the nose. It is shared by extract and by the batch feature pipeline
+  static double value(double lx, double ly, double rx, double ry,
+		      double nx, double ny) {
+    return lx;
+  }
+
   // the extract method is expected to be implemented in each derived class
   virtual double extract(FrameAnnotation* annotation) { 
-    double result = annotation->getLeftIris().x; 
-    if (minVal > result)
-      minVal = result;
-    if (maxVal < result)
-      maxVal = result;
-    return result;
+    return extractValue(annotation, value);
   }
 };
 
@@ -15,32 +15,29 @@ class FeatureRCAngle : public Feature {
   virtual ~FeatureRCAngle() {
   }
 
-  // the extract method is expected to be implemented in each derived class
-  virtual double extract(FrameAnnotation* annotation) { 
-    CvPoint& pointr = annotation->getRightIris();
-    CvPoint center;
-    center.x = Globals::imgWidth / 2;
-    center.y = Globals::imgHeight / 2;
-
-    // compute the drop point directly below the eye that is in line with
-    // the nose
-    CvPoint drop;
-    drop.x = pointr.x;
-    drop.y = center.y;
-
-    // compute distances
-    double rcdist = distance(pointr, center);
-    double rddist = distance(pointr, drop);
+  // method that computes the feature from the coordinates of the eyes and
+  // the nose. It is shared by extract and by the batch feature pipeline
+  static double value(double lx, double ly, double rx, double ry,
+		      double nx, double ny) {
+    double cx = Globals::imgWidth / 2;
+    double cy = Globals::imgHeight / 2;
+
+    // compute distances. The distance from the eye to the drop point directly
+    // below it that is in line with the center is their vertical distance
+    double xdiff = rx - cx;
+    double ydiff = ry - cy;
+    double rcdist = sqrt(xdiff * xdiff + ydiff * ydiff);
+    double rddist = fabs(ydiff);
 
     // compute and return angle
     double rads = acos(rddist / rcdist);
-    double result = (pointr.x < center.x)? 
+    return (rx < cx)? 
       90 - ((180 / M_PI) * rads) : 90 + ((180 / M_PI) * rads);
-    if (minVal > result)
-      minVal = result;
-    if (maxVal < result)
-      maxVal = result;
-    return result;
+  }
+
+  // the extract method is expected to be implemented in each derived class
+  virtual double extract(FrameAnnotation* annotation) { 
+    return extractValue(annotation, value);
   }
 };
 
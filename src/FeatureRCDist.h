@@ -15,22 +15,22 @@ class FeatureRCDist : public Feature {
   virtual ~FeatureRCDist() {
   }
 
+  // method that computes the feature from the coordinates of the eyes and
+  // the nose. It is shared by extract and by the batch feature pipeline
+  static double value(double lx, double ly, double rx, double ry,
+		      double nx, double ny) {
+    double cx = Globals::imgWidth / 2;
+    double cy = Globals::imgHeight / 2;
+
+    double xdiff = rx - cx;
+    double ydiff = ry - cy;
+
+    return sqrt(xdiff * xdiff + ydiff * ydiff);
+  }
+
   // the extract method is expected to be implemented in each derived class
   virtual double extract(FrameAnnotation* annotation) { 
-    CvPoint& pointr = annotation->getRightIris();
-    CvPoint center;
-    center.x = Globals::imgWidth / 2;
-    center.y = Globals::imgHeight / 2;
-
-    double xdiff = pointr.x - center.x;
-    double ydiff = pointr.y - center.y;
-
-    double result = sqrt(xdiff * xdiff + ydiff * ydiff);
-    if (minVal > result)
-      minVal = result;
-    if (maxVal < result)
-      maxVal = result;
-    return result;
+    return extractValue(annotation, value);
   }
 };
 
@@ -15,30 +15,26 @@ class FeatureRNAngle : public Feature {
   virtual ~FeatureRNAngle() {
   }
 
-  // the extract method is expected to be implemented in each derived class
-  virtual double extract(FrameAnnotation* annotation) { 
-    CvPoint& pointr = annotation->getRightIris();
-    CvPoint& pointn = annotation->getNose();
-
-    // compute the drop point directly below the eye that is in line with
-    // the nose
-    CvPoint drop;
-    drop.x = pointr.x;
-    drop.y = pointn.y;
-
-    // compute distances
-    double rndist = distance(pointr, pointn);
-    double rddist = distance(pointr, drop);
+  // method that computes the feature from the coordinates of the eyes and
+  // the nose. It is shared by extract and by the batch feature pipeline
+  static double value(double lx, double ly, double rx, double ry,
+		      double nx, double ny) {
+    // compute distances. The distance from the eye to the drop point directly
+    // below it that is in line with the nose is their vertical distance
+    double xdiff = rx - nx;
+    double ydiff = ry - ny;
+    double rndist = sqrt(xdiff * xdiff + ydiff * ydiff);
+    double rddist = fabs(ydiff);
 
     // compute and return angle
     double rads = acos(rddist / rndist);
-    double result = (pointr.x < pointn.x)? 
+    return (rx < nx)? 
       90 - ((180 / M_PI) * rads) : 90 + ((180 / M_PI) * rads);
-    if (minVal > result)
-      minVal = result;
-    if (maxVal < result)
-      maxVal = result;
-    return result;
+  }
+
+  // the extract method is expected to be implemented in each derived class
+  virtual double extract(FrameAnnotation* annotation) { 
+    return extractValue(annotation, value);
   }
 };
 
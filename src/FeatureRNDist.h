@@ -15,20 +15,19 @@ class FeatureRNDist : public Feature {
   virtual ~FeatureRNDist() {
   }
 
-  // the extract method is expected to be implemented in each derived class
-  virtual double extract(FrameAnnotation* annotation) { 
-    CvPoint& pointr = annotation->getRightIris();
-    CvPoint& pointn = annotation->getNose();
+  // method that computes the feature from the coordinates of the eyes and
+  // the nose. It is shared by extract and by the batch feature pipeline
+  static double value(double lx, double ly, double rx, double ry,
+		      double nx, double ny) {
+    double xdiff = rx - nx;
+    double ydiff = ry - ny;
 
-    double xdiff = pointr.x - pointn.x;
-    double ydiff = pointr.y - pointn.y;
+    return sqrt(xdiff * xdiff + ydiff * ydiff);
+  }
 
-    double result = sqrt(xdiff * xdiff + ydiff * ydiff);
-    if (minVal > result)
-      minVal = result;
-    if (maxVal < result)
-      maxVal = result;
-    return result;
+  // the extract method is expected to be implemented in each derived class
+  virtual double extract(FrameAnnotation* annotation) { 
+    return extractValue(annotation, value);
   }
 };
 
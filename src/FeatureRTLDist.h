@@ -15,22 +15,19 @@ class FeatureRTLDist : public Feature {
   virtual ~FeatureRTLDist() {
   }
 
-  // the extract method is expected to be implemented in each derived class
-  virtual double extract(FrameAnnotation* annotation) { 
-    CvPoint& pointl = annotation->getLeftIris();
-    CvPoint rt;
-    rt.x = Globals::imgWidth;
-    rt.y = 0;
+  // method that computes the feature from the coordinates of the eyes and
+  // the nose. It is shared by extract and by the batch feature pipeline
+  static double value(double lx, double ly, double rx, double ry,
+		      double nx, double ny) {
+    double xdiff = lx - Globals::imgWidth;
+    double ydiff = ly;
 
-    double xdiff = pointl.x - rt.x;
-    double ydiff = pointl.y - rt.y;
+    return sqrt(xdiff * xdiff + ydiff * ydiff);
+  }
 
-    double result = sqrt(xdiff * xdiff + ydiff * ydiff);
-    if (minVal > result)
-      minVal = result;
-    if (maxVal < result)
-      maxVal = result;
-    return result;
+  // the extract method is expected to be implemented in each derived class
+  virtual double extract(FrameAnnotation* annotation) { 
+    return extractValue(annotation, value);
   }
 };
 
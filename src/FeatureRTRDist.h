@@ -15,22 +15,19 @@ class FeatureRTRDist : public Feature {
   virtual ~FeatureRTRDist() {
   }
 
-  // the extract method is expected to be implemented in each derived class
-  virtual double extract(FrameAnnotation* annotation) { 
-    CvPoint& pointr = annotation->getRightIris();
-    CvPoint rt;
-    rt.x = Globals::imgWidth;
-    rt.y = 0;
+  // method that computes the feature from the coordinates of the eyes and
+  // the nose. It is shared by extract and by the batch feature pipeline
+  static double value(double lx, double ly, double rx, double ry,
+		      double nx, double ny) {
+    double xdiff = Globals::imgWidth - rx;
+    double ydiff = -ry;
 
-    double xdiff = rt.x - pointr.x;
-    double ydiff = rt.y - pointr.y;
+    return sqrt(xdiff * xdiff + ydiff * ydiff);
+  }
 
-    double result = sqrt(xdiff * xdiff + ydiff * ydiff);
-    if (minVal > result)
-      minVal = result;
-    if (maxVal < result)
-      maxVal = result;
-    return result;
+  // the extract method is expected to be implemented in each derived class
+  virtual double extract(FrameAnnotation* annotation) { 
+    return extractValue(annotation, value);
   }
 };
 
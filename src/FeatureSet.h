@@ -0,0 +1,139 @@
+#ifndef __FEATURESET_H
+#define __FEATURESET_H
+
+// FeatureSet.h
+// This file contains the definition of the feature sets that can be used for
+// training and classification, and of the feature pipeline that computes the
+// features of a set.
+// A feature set is a list of feature classes built out of FeatureList types,
+// terminated by NullFeature. The position of a feature in the list is its
+// index in feature vectors. The pipeline for a set is expanded at compile time,
+// so the value functions of all features in the set are inlined into a single
+// function without virtual calls.
+// The set used by the trainer and the classifier is FeatureSet, which is chosen
+// at build time. The standard set is used unless CENTER_FEATURES or
+// CORNER_FEATURES is defined. Models and parameters are only valid for the set
+// they were trained with
+
+#include <vector>
+
+#include "Feature.h"
+#include "FeatureLX.h"
+#include "FeatureRX.h"
+#include "FeatureNX.h"
+#include "FeatureLRDist.h"
+#include "FeatureLNDist.h"
+#include "FeatureRNDist.h"
+#include "FeatureLNAngle.h"
+#include "FeatureRNAngle.h"
+#include "FeatureLRNArea.h"
+#include "FeatureLCDist.h"
+#include "FeatureRCDist.h"
+#include "FeatureLCAngle.h"
+#include "FeatureRCAngle.h"
+#include "FeatureLRCArea.h"
+#include "FeatureLTLDist.h"
+#include "FeatureLTRDist.h"
+#include "FeatureRTLDist.h"
+#include "FeatureRTRDist.h"
+
+using namespace std;
+
+// feature list types
+struct NullFeature { };
+
+template <class F, class Rest>
+struct FeatureList {
+  typedef F Head;
+  typedef Rest Tail;
+};
+
+// the coordinates of the left eye, right eye and nose of a set of frames,
+// one array per coordinate
+struct FeaturePoints {
+  const double* lx;
+  const double* ly;
+  const double* rx;
+  const double* ry;
+  const double* nx;
+  const double* ny;
+};
+
+// The feature pipeline of a feature list. size is the number of features in
+// the list, create creates the feature extraction objects of the list in order,
+// and extract computes the features of n frames with one loop per feature. The
+// value of the i-th feature of the list for frame j is at columns[i * n + j]
+
+template <class List>
+struct FeaturePipeline;
+
+template <>
+struct FeaturePipeline<NullFeature> {
+  enum { size = 0 };
+
+  static void create(vector<Feature*>& extractors) { }
+  static inline void extract(const FeaturePoints& points, int n, double* columns) { }
+};
+
+template <class F, class Rest>
+struct FeaturePipeline<FeatureList<F, Rest> > {
+  enum { size = 1 + FeaturePipeline<Rest>::size };
+
+  static void create(vector<Feature*>& extractors) {
+    extractors.push_back(new F());
+    FeaturePipeline<Rest>::create(extractors);
+  }
+
+  static inline void extract(const FeaturePoints& points, int n, double* columns) {
+    for (int i = 0; i < n; i++)
+      columns[i] = F::value(points.lx[i], points.ly[i], points.rx[i], points.ry[i],
+			    points.nx[i], points.ny[i]);
+    FeaturePipeline<Rest>::extract(points, n, columns + n);
+  }
+};
+
+// the standard feature set, using the eyes and the nose
+typedef FeatureList<FeatureLX,
+	FeatureList<FeatureRX,
+	FeatureList<FeatureNX,
+	FeatureList<FeatureLRDist,
+	FeatureList<FeatureLNDist,
+	FeatureList<FeatureRNDist,
+	FeatureList<FeatureLNAngle,
+	FeatureList<FeatureRNAngle,
+	FeatureList<FeatureLRNArea,
+	NullFeature> > > > > > > > > StandardFeatures;
+
+// a feature set that places the eyes with respect to the image center instead
+// of the nose
+typedef FeatureList<FeatureLX,
+	FeatureList<FeatureRX,
+	FeatureList<FeatureLRDist,
+	FeatureList<FeatureLCDist,
+	FeatureList<FeatureRCDist,
+	FeatureList<FeatureLCAngle,
+	FeatureList<FeatureRCAngle,
+	FeatureList<FeatureLRCArea,
+	NullFeature> > > > > > > > CenterFeatures;
+
+// a feature set that places the eyes with respect to the top corners of the
+// image
+typedef FeatureList<FeatureLX,
+	FeatureList<FeatureRX,
+	FeatureList<FeatureLRDist,
+	FeatureList<FeatureLTLDist,
+	FeatureList<FeatureLTRDist,
+	FeatureList<FeatureRTLDist,
+	FeatureList<FeatureRTRDist,
+	NullFeature> > > > > > > CornerFeatures;
+
+// the feature set used for training and classification
+#if defined(CENTER_FEATURES)
+typedef CenterFeatures FeatureSet;
+#elif defined(CORNER_FEATURES)
+typedef CornerFeatures FeatureSet;
+#else
+typedef StandardFeatures FeatureSet;
+#endif
+
+#endif // __FEATURESET_H
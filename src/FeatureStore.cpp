@@ -0,0 +1,262 @@
+// FeatureStore.cpp
+// This file contains the implementation of class FeatureStore
+
+#include "FeatureStore.h"
+
+// static member initialization
+const unsigned int FeatureStore::version = 1;
+
+// magic string at the start of a feature store file
+static const char s_magic[8] = "MOSSEFS";
+
+// Class construction and destruction
+
+FeatureStore::FeatureStore(int n) : nFeatures(n), nRows(0) {
+  minStorage.assign(nFeatures, 0.0);
+  maxStorage.assign(nFeatures, 0.0);
+  columnStorage.resize(nFeatures);
+  mapping = 0;
+  mappingSize = 0;
+  updateViews();
+}
+
+// The file is mapped read only and all views point into the mapping. We check
+// that the file is large enough for the sizes given in its header before we
+// set up the views
+
+FeatureStore::FeatureStore(string filename) {
+  mapping = 0;
+  mappingSize = 0;
+
+  int fd = open((const char*)filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    string err = "FeatureStore::FeatureStore. Unable to open file " + filename;
+    throw (err);
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) || info.st_size < (off_t)sizeof(FeatureStoreHeader)) {
+    close(fd);
+    string err = "FeatureStore::FeatureStore. Malformed feature file " + filename;
+    throw (err);
+  }
+
+  mappingSize = info.st_size;
+  mapping = mmap(0, mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    mapping = 0;
+    string err = "FeatureStore::FeatureStore. Unable to map file " + filename;
+    throw (err);
+  }
+
+  const FeatureStoreHeader* header = (const FeatureStoreHeader*)mapping;
+  if (memcmp(header->magic, s_magic, sizeof(s_magic)) || header->version != version) {
+    munmap(mapping, mappingSize);
+    string err = "FeatureStore::FeatureStore. Unknown feature file format in " + filename;
+    throw (err);
+  }
+
+  nFeatures = header->nFeatures;
+  nRows = header->nRows;
+
+  size_t size = sizeof(FeatureStoreHeader) + 2 * nFeatures * sizeof(double) +
+    (size_t)nRows * (nFeatures * sizeof(float) + 3 * sizeof(int)) +
+    header->sourceTableSize;
+  if (size != mappingSize) {
+    munmap(mapping, mappingSize);
+    string err = "FeatureStore::FeatureStore. Truncated feature file " + filename;
+    throw (err);
+  }
+
+  const char* base = (const char*)mapping + sizeof(FeatureStoreHeader);
+  minVals = (const double*)base;
+  maxVals = minVals + nFeatures;
+  const float* values = (const float*)(maxVals + nFeatures);
+  for (int i = 0; i < nFeatures; i++)
+    columns.push_back(values + (size_t)i * nRows);
+  zones = (const int*)(values + (size_t)nFeatures * nRows);
+  sources = zones + nRows;
+  frames = sources + nRows;
+
+  // the source table is a sequence of null terminated names
+  const char* name = (const char*)(frames + nRows);
+  const char* end = name + header->sourceTableSize;
+  for (unsigned int i = 0; i < header->nSources && name < end; i++) {
+    string str = name;
+    sourceNames.push_back(str);
+    name += str.size() + 1;
+  }
+  if (sourceNames.size() != header->nSources) {
+    munmap(mapping, mappingSize);
+    string err = "FeatureStore::FeatureStore. Malformed source table in " + filename;
+    throw (err);
+  }
+  for (long i = 0; i < nRows; i++) {
+    if (sources[i] < 0 || sources[i] >= (int)sourceNames.size()) {
+      munmap(mapping, mappingSize);
+      string err = "FeatureStore::FeatureStore. Malformed source index in " + filename;
+      throw (err);
+    }
+  }
+}
+
+FeatureStore::~FeatureStore() {
+  if (mapping)
+    munmap(mapping, mappingSize);
+}
+
+// updateViews
+// Method used to point the views at the in-memory storage. Needs to be called
+// whenever the storage may have been reallocated
+
+void FeatureStore::updateViews() {
+  minVals = (nFeatures)? &minStorage[0] : 0;
+  maxVals = (nFeatures)? &maxStorage[0] : 0;
+  columns.resize(nFeatures);
+  for (int i = 0; i < nFeatures; i++)
+    columns[i] = (nRows)? &columnStorage[i][0] : 0;
+  zones = (nRows)? &zoneStorage[0] : 0;
+  sources = (nRows)? &sourceStorage[0] : 0;
+  frames = (nRows)? &frameStorage[0] : 0;
+}
+
+// addSource
+// Method used to add a source directory. Returns the index of the source
+
+int FeatureStore::addSource(string directory) {
+  if (mapping) {
+    string err = "FeatureStore::addSource. Cannot modify a mapped feature store.";
+    throw (err);
+  }
+  sourceNames.push_back(directory);
+  return sourceNames.size() - 1;
+}
+
+// add
+// Method used to add a row of feature values along with its zone and provenance
+
+void FeatureStore::add(int zone, int source, int frame, vector<double>& values) {
+  if (mapping) {
+    string err = "FeatureStore::add. Cannot modify a mapped feature store.";
+    throw (err);
+  }
+  if ((int)values.size() != nFeatures) {
+    string err = "FeatureStore::add. Wrong number of feature values.";
+    throw (err);
+  }
+
+  for (int i = 0; i < nFeatures; i++)
+    columnStorage[i].push_back((float)values[i]);
+  zoneStorage.push_back(zone);
+  sourceStorage.push_back(source);
+  frameStorage.push_back(frame);
+  nRows++;
+
+  updateViews();
+}
+
+// setRange
+// Method used to set the range of values of a feature used for normalization
+
+void FeatureStore::setRange(int feature, double min, double max) {
+  if (mapping) {
+    string err = "FeatureStore::setRange. Cannot modify a mapped feature store.";
+    throw (err);
+  }
+  minStorage[feature] = min;
+  maxStorage[feature] = max;
+}
+
+// save
+// Method used to write the store into a file in the layout described in
+// FeatureStore.h
+
+void FeatureStore::save(string filename) {
+  ofstream file;
+  file.open((const char*)filename.c_str(), ios::out | ios::binary);
+  if (!file.good()) {
+    string err = "FeatureStore::save. Unable to open file " + filename;
+    throw (err);
+  }
+
+  unsigned int sourceTableSize = 0;
+  for (unsigned int i = 0; i < sourceNames.size(); i++)
+    sourceTableSize += sourceNames[i].size() + 1;
+
+  FeatureStoreHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, s_magic, sizeof(s_magic));
+  header.version = version;
+  header.nFeatures = nFeatures;
+  header.nRows = nRows;
+  header.nSources = sourceNames.size();
+  header.sourceTableSize = sourceTableSize;
+
+  file.write((const char*)&header, sizeof(header));
+  file.write((const char*)minVals, nFeatures * sizeof(double));
+  file.write((const char*)maxVals, nFeatures * sizeof(double));
+  for (int i = 0; i < nFeatures; i++)
+    file.write((const char*)columns[i], nRows * sizeof(float));
+  file.write((const char*)zones, nRows * sizeof(int));
+  file.write((const char*)sources, nRows * sizeof(int));
+  file.write((const char*)frames, nRows * sizeof(int));
+  for (unsigned int i = 0; i < sourceNames.size(); i++)
+    file.write(sourceNames[i].c_str(), sourceNames[i].size() + 1);
+
+  if (!file.good()) {
+    string err = "FeatureStore::save. Error writing file " + filename;
+    throw (err);
+  }
+  file.close();
+}
+
+// exportSVMLight
+// Method used to write the rows in the SVM-Light text format. Values are
+// normalized to lie in [-1, 1] using the feature ranges, the same way the
+// trainer normalizes them
+
+void FeatureStore::exportSVMLight(string directory) {
+  vector<double> average;
+  vector<double> spread;
+  for (int i = 0; i < nFeatures; i++) {
+    average.push_back((maxVals[i] + minVals[i]) / 2.0);
+    spread.push_back(maxVals[i] - minVals[i]);
+  }
+
+  vector<ofstream*> files;
+  for (unsigned int i = 0; i < Globals::numZones; i++) {
+    char buffer[Globals::smallBufferSize];
+    sprintf(buffer, "zone_%d.data", i + 1);
+    string str = buffer;
+    string filename = directory + "/" + str;
+    ofstream* file = new ofstream();
+    file->open((const char*)filename.c_str());
+    if (!file->good()) {
+      for (unsigned int j = 0; j < files.size(); j++)
+	delete files[j];
+      delete file;
+      string err = "FeatureStore::exportSVMLight. Unable to open file " + filename;
+      throw (err);
+    }
+    files.push_back(file);
+  }
+
+  // format each row once and write it to all zone files with the label
+  // for that zone
+  for (long row = 0; row < nRows; row++) {
+    string line = "";
+    for (int i = 0; i < nFeatures; i++) {
+      char buffer[Globals::smallBufferSize];
+      sprintf(buffer, " %d:%f", i + 1, (columns[i][row] - average[i]) / spread[i]);
+      line += buffer;
+    }
+    for (unsigned int i = 0; i < files.size(); i++)
+      (*files[i]) << ((zones[row] == (int)i + 1)? "1" : "-1") << line << endl;
+  }
+
+  for (unsigned int i = 0; i < files.size(); i++) {
+    files[i]->close();
+    delete files[i];
+  }
+}
@@ -0,0 +1,114 @@
+#ifndef __FEATURESTORE_H
+#define __FEATURESTORE_H
+
+// FeatureStore.h
+// This file contains the definition of class FeatureStore. A feature store holds
+// the raw feature values extracted from a set of annotated frames, together with
+// the zone of each frame, where each frame came from, and the feature ranges used
+// for normalization. Values are stored by column as floats. A store is built in
+// memory by the trainer, saved once as a single binary file, and can then be
+// memory mapped for training and analysis without parsing.
+//
+// The file layout is as follows,
+//   header        (64 bytes, see FeatureStoreHeader)
+//   min values    double[nFeatures]
+//   max values    double[nFeatures]
+//   columns       float[nFeatures][nRows]
+//   zones         int[nRows]
+//   sources       int[nRows], index into the source table
+//   frames        int[nRows], frame number within the source
+//   source table  nSources null terminated directory names
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "Globals.h"
+
+using namespace std;
+
+// the on-disk header of a feature store
+typedef struct {
+  char magic[8];                // "MOSSEFS" and a null
+  unsigned int version;         // the format version
+  unsigned int nFeatures;       // the number of features per row
+  unsigned long long nRows;     // the number of rows
+  unsigned int nSources;        // the number of source directories
+  unsigned int sourceTableSize; // the size of the source table in bytes
+  char reserved[32];
+} FeatureStoreHeader;
+
+class FeatureStore {
+ private:
+  int nFeatures;                // the number of features
+  long nRows;                   // the number of rows
+
+  // views of the data. These point either into the vectors below when the
+  // store is being built, or into the mapped file
+  const double* minVals;
+  const double* maxVals;
+  vector<const float*> columns;
+  const int* zones;
+  const int* sources;
+  const int* frames;
+  vector<string> sourceNames;
+
+  // storage used when building a store in memory
+  vector<double> minStorage;
+  vector<double> maxStorage;
+  vector<vector<float> > columnStorage;
+  vector<int> zoneStorage;
+  vector<int> sourceStorage;
+  vector<int> frameStorage;
+
+  // the mapped file
+  void* mapping;
+  size_t mappingSize;
+
+  static const unsigned int version;
+
+ public:
+  // Constructor for an empty store with n features, to be filled using add
+  FeatureStore(int n);
+
+  // Constructor that memory maps a store saved using save
+  FeatureStore(string filename);
+
+  ~FeatureStore();
+
+  // methods used to build a store. addSource returns the index of a source
+  // directory to be used when adding rows from that directory
+  int addSource(string directory);
+  void add(int zone, int source, int frame, vector<double>& values);
+  void setRange(int feature, double min, double max);
+
+  // method to write the store into a file
+  void save(string filename);
+
+  // method to write the normalized rows as SVM-Light training files, one per
+  // zone, with the rows of that zone as positive samples. The files are named
+  // zone_<zone>.data as expected by svm_learn
+  void exportSVMLight(string directory);
+
+  int getNFeatures() { return nFeatures; }
+  long getNRows() { return nRows; }
+  double getMinVal(int feature) { return minVals[feature]; }
+  double getMaxVal(int feature) { return maxVals[feature]; }
+  const float* getColumn(int feature) { return columns[feature]; }
+  int getZone(long row) { return zones[row]; }
+  string& getSource(long row) { return sourceNames[sources[row]]; }
+  int getFrameNumber(long row) { return frames[row]; }
+
+ private:
+  void updateViews();
+};
+
+#endif // __FEATURESTORE_H
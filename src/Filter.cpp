@@ -25,8 +25,10 @@ Filter::Filter(string output, Annotations::Tag tag, CvSize size,
 
   imgSize.height = size.height;
   imgSize.width = size.width;
+  bandSize = cvSize(0, 0);
   filter = 0;
   doAffineTransforms = false;
+  nSamples = 0;
 
   postFilterImg = cvCreateImage(imgSize, IPL_DEPTH_64F, 1);
 
@@ -68,20 +70,7 @@ Filter::Filter(string output, Annotations::Tag tag, CvSize size,
   fftBuffer = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * nElements);
 
   // compute plans
-  planForward = fftw_plan_dft_r2c_2d(imgSize.height, imgSize.width,
-				     imageBuffer, fftBuffer,
-				     FFTW_ESTIMATE);
-  if (!planForward) {
-    string err = "Filter::Filter. Error computing forward plan.";
-    throw (err);
-  }
-  planBackward = fftw_plan_dft_c2r_2d(imgSize.height, imgSize.width,
-				      fftBuffer, imageBuffer,
-				      FFTW_ESTIMATE);
-  if (!planBackward) {
-    string err = "Filter::Filter. Error computing backward plan.";
-    throw (err);
-  }
+  createPlans();
 }
 
 // The following constructor takes as input the name of a directory where filter
@@ -96,6 +85,7 @@ Filter::Filter(string output, Annotations::Tag tag, CvPoint& center)
   doAffineTransforms = false;
   gaussianSpread = 0.0;
   roiFunction = 0;
+  nSamples = 0;
 
   windowCenter.x = center.x;
   windowCenter.y = center.y;
@@ -127,20 +117,49 @@ Filter::Filter(string output, Annotations::Tag tag, CvPoint& center)
   fftBuffer = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * nElements);
 
   // compute plans
-  planForward = fftw_plan_dft_r2c_2d(imgSize.height, imgSize.width,
-				     imageBuffer, fftBuffer,
-				     FFTW_ESTIMATE);
-  if (!planForward) {
-    string err = "Filter::Filter. Error computing forward plan.";
-    throw (err);
+  createPlans();
+}
+
+// The copy constructor creates a filter with the same filter data, accumulated
+// terms and window as the given filter. The copy has its own buffers and plans
+// and can therefore be applied concurrently with the original
+
+Filter::Filter(const Filter& other) 
+  : FilterBase(), outputDirectory(other.outputDirectory), xmlTag(other.xmlTag),
+    imgSize(other.imgSize), gaussianSpread(other.gaussianSpread),
+    length(other.length), filter(0), roiFunction(other.roiFunction) {
+  doAffineTransforms = other.doAffineTransforms;
+  bandSize = other.bandSize;
+  nSamples = other.nSamples;
+
+  int nElements = imgSize.height * ((imgSize.width / 2) + 1);
+  if (other.filter) {
+    filter = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * nElements);
+    memcpy(filter, other.filter, sizeof(fftw_complex) * nElements);
   }
-  planBackward = fftw_plan_dft_c2r_2d(imgSize.height, imgSize.width,
-				      fftBuffer, imageBuffer,
-				      FFTW_ESTIMATE);
-  if (!planBackward) {
-    string err = "Filter::Filter. Error computing backward plan.";
-    throw (err);
+  mosseNum = (fftw_complex*)malloc(sizeof(fftw_complex) * nElements);
+  mosseDen = (fftw_complex*)malloc(sizeof(fftw_complex) * nElements);
+  memcpy(mosseNum, other.mosseNum, sizeof(fftw_complex) * nElements);
+  memcpy(mosseDen, other.mosseDen, sizeof(fftw_complex) * nElements);
+
+  postFilterImg = cvCreateImage(imgSize, IPL_DEPTH_64F, 1);
+  realImg = cvCreateImage(imgSize, IPL_DEPTH_64F, 1);
+  tempImg = cvCreateImage(imgSize, IPL_DEPTH_64F, 1);
+  imageBuffer = (double*)fftw_malloc(sizeof(double) * length);
+
+  windowCenter.x = other.windowCenter.x;
+  windowCenter.y = other.windowCenter.y;
+  window = (double*)fftw_malloc(sizeof(double) * length);
+  memcpy(window, other.window, sizeof(double) * length);
+
+  storageIndex = 0;
+  for (int i = 0; i < nComplexVectors; i++) {
+    fftw_complex* buffer = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * nElements);
+    complexVectors.push_back(buffer);
   }
+
+  fftBuffer = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * nElements);
+  createPlans();
 }
 
 Filter::~Filter() {
@@ -163,6 +182,112 @@ Filter::~Filter() {
   
   fftw_destroy_plan(planForward);
   fftw_destroy_plan(planBackward);  
+  fftw_destroy_plan(planResponse);
+  fftw_free(responseBuffer);
+  cvReleaseImageHeader(&imageView);
+  releaseBatch();
+  releasePair();
+  releaseBand();
+  if (augmenter)
+    delete augmenter;
+}
+
+// createPlans
+// Method used to create the forward and backward plans on imageBuffer and
+// fftBuffer. The FFTW planner is not thread safe, so all filters create their
+// plans inside the same named critical section
+
+void Filter::createPlans() {
+  // batch buffers and plans are created on demand by prepareBatch
+  batchSize = 0;
+  batchImages = 0;
+  batchSpectra = 0;
+  planBatchForward = planBatchBackward = 0;
+
+  // the pair buffer and plan are created on demand by preparePair, and the
+  // augmenter on the first update
+  pairBuffer = 0;
+  planPair = 0;
+  augmenter = 0;
+
+  // responses are transformed into their own buffer, so that they are kept
+  // until the post filter image is asked for
+  responseBuffer = (double*)fftw_malloc(sizeof(double) * length);
+  responsePending = false;
+
+  // view of the image buffer
+  imageView = cvCreateImageHeader(imgSize, IPL_DEPTH_64F, 1);
+  cvSetData(imageView, imageBuffer, sizeof(double) * imgSize.width);
+
+  #pragma omp critical(fftw_planner)
+  {
+    planForward = fftw_plan_dft_r2c_2d(imgSize.height, imgSize.width,
+				       imageBuffer, fftBuffer,
+				       FFTW_ESTIMATE);
+    planBackward = fftw_plan_dft_c2r_2d(imgSize.height, imgSize.width,
+					fftBuffer, imageBuffer,
+					FFTW_ESTIMATE);
+    planResponse = fftw_plan_dft_c2r_2d(imgSize.height, imgSize.width,
+					fftBuffer, responseBuffer,
+					FFTW_ESTIMATE);
+  }
+  if (!planForward) {
+    string err = "Filter::Filter. Error computing forward plan.";
+    throw (err);
+  }
+  if (!planBackward || !planResponse) {
+    string err = "Filter::Filter. Error computing backward plan.";
+    throw (err);
+  }
+
+  // band buffers and plan are only created for band limited filters
+  bandBuffer = 0;
+  bandReal = 0;
+  bandImg = 0;
+  planBand = 0;
+  if (isBandLimited())
+    createBandPlan();
+}
+
+// createBandPlan
+// Method used to allocate the band buffers and create the backward plan at
+// the band size
+
+void Filter::createBandPlan() {
+  releaseBand();
+
+  int nElements = bandSize.height * ((bandSize.width / 2) + 1);
+  bandBuffer = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * nElements);
+  bandReal = (double*)fftw_malloc(sizeof(double) * bandSize.height * bandSize.width);
+  bandImg = cvCreateImageHeader(bandSize, IPL_DEPTH_64F, 1);
+  cvSetData(bandImg, bandReal, sizeof(double) * bandSize.width);
+
+  #pragma omp critical(fftw_planner)
+  {
+    planBand = fftw_plan_dft_c2r_2d(bandSize.height, bandSize.width,
+				    bandBuffer, bandReal, FFTW_ESTIMATE);
+  }
+  if (!planBand) {
+    string err = "Filter::createBandPlan. Error computing band plan.";
+    throw (err);
+  }
+}
+
+// releaseBand
+// Method used to free the band buffers and plan
+
+void Filter::releaseBand() {
+  if (planBand)
+    fftw_destroy_plan(planBand);
+  if (bandBuffer)
+    fftw_free(bandBuffer);
+  if (bandReal)
+    fftw_free(bandReal);
+  if (bandImg)
+    cvReleaseImageHeader(&bandImg);
+  planBand = 0;
+  bandBuffer = 0;
+  bandReal = 0;
 }
 
 // setWindowCenter
@@ -255,11 +380,12 @@ void Filter::addTrainingSet(string trainingDirectory) {
 // Method used to update terms used to create a filter from an image file
 // and a location of interest. This method is called by the method addTrainingSet
 // for each image file in the test set and a location of interest for that
-// image
+// image. When affine transforms are set, the filter is also updated with
+// the variants of the image generated by the augmenter
 
 void Filter::update(string filename, FrameAnnotation* fa) {
   // get LOI
-  CvPoint& location = fa->getLOI(xmlTag);
+  CvPoint location = fa->getLOI(xmlTag);
 
   cout << "Processing " << filename << ". Location (" << location.x << ", " << 
     location.y << ")." << endl;
@@ -270,73 +396,80 @@ void Filter::update(string filename, FrameAnnotation* fa) {
     throw (err);
   }
 
-  // generate affine transforms if requested
-  vector<ImgLocPairT>& imgLocPairs = getAffineTransforms(image, location);
-  
-  for (unsigned int i = 0; i < imgLocPairs.size(); i++) {
-    image = imgLocPairs[i].first;
-    location = imgLocPairs[i].second;
-
-    CvPoint offset;
-    offset.x = offset.y = 0;
-    if (roiFunction) {
-      IplImage* roi = roiFunction(image, *fa, offset, Annotations::Face);
-      image = roi;
-    }
+  // the ROI is the same for all variants of the image
+  CvPoint offset;
+  offset.x = offset.y = 0;
+  CvSize size = cvGetSize(image);
+  if (roiFunction) {
+    IplImage* roi = roiFunction(image, *fa, offset, Annotations::Face);
+    size = cvGetSize(roi);
+    cvReleaseImage(&roi);
+  }
 
-    location.x -= offset.x;
-    location.y -= offset.y;
+  // check consistency
+  if (imgSize.height != size.height || imgSize.width != size.width) {
+    cvReleaseImage(&image);
+    char buffer[32];
+    sprintf(buffer, "(%d, %d).", imgSize.height, imgSize.width);
+    string err = "Filter::update. Inconsistent image sizes. Expecting" + string(buffer);
+    throw (err);
+  }
 
-    // compute size and length of the image data
-    CvSize size = cvGetSize(image);
+  if (!augmenter)
+    augmenter = new AffineAugmenter(imgSize);
+  augmenter->setFrame(image, offset, location, doAffineTransforms);
+  cvReleaseImage(&image);
 
-    // check consistency
-    if (imgSize.height != size.height || imgSize.width != size.width) {
-      char buffer[32];
-      sprintf(buffer, "(%d, %d).", imgSize.height, imgSize.width);
-      string err = "Filter::update. Inconsistent image sizes. Expecting" + string(buffer);
-      throw (err);
-    }
+  for (int n = augmenter->next(); n; n = augmenter->next())
+    for (int i = 0; i < n; i++)
+      addSample(augmenter->getImage(i), augmenter->getLocation(i),
+		augmenter->getWeight(i));
+}
 
-    // preprocess
-    fftw_complex* preImage = preprocessImage(image);
-    fftw_complex* fftImage = getBuffer();
-    int nElements = imgSize.height * ((imgSize.width / 2) + 1);
-    memcpy(fftImage, preImage, (sizeof(fftw_complex) * nElements));
-
-    // create a gaussian around the location centered at the location
-    CvSize sizeOfGaussian = {gaussianSpread, gaussianSpread}; // size and sd
-    double sd = gaussianSpread / 2;
-    fftw_complex* gaussian = createGaussian(location, sizeOfGaussian, sd);
-
-    // find the complex conjugate of fftImage
-    fftw_complex* fftImageC = getBuffer();
-    for (int i = 0; i < nElements; i++) {
-      fftImageC[i][0] = fftImage[i][0];
-      fftImageC[i][1] = -fftImage[i][1];
-    }
+// addSample
+// Method used to accumulate the numerator and denominator terms of an image
+// of the filter size and the location of interest in it. The terms are
+// scaled by the weight of the image
 
-    // Compute numerator and denominator terms for the filter update
-    fftw_complex* num = convolve(gaussian, fftImageC);
-    fftw_complex* den = convolve(fftImage, fftImageC);
+void Filter::addSample(IplImage* image, CvPoint& location, int weight) {
+  addSpectrum(preprocessImage(image, getBuffer()), location, weight);
+}
 
-    // accumulate into filter wide numerator and denominator terms
-    for(int i = 0; i < imgSize.height; i++) {
-      for(int j = 0; j < imgSize.width / 2 + 1; j++) {
-	int ij = i * (imgSize.width / 2 + 1) + j;
-	mosseNum[ij][0] += num[ij][0];
-	mosseNum[ij][1] += num[ij][1];
+// addSpectrum
+// Method used to accumulate the numerator and denominator terms of an image
+// spectrum and the location of interest in the image
 
-	mosseDen[ij][0] += den[ij][0];
-	mosseDen[ij][1] += den[ij][1];
-      }
-    }
+void Filter::addSpectrum(fftw_complex* fftImage, CvPoint& location, int weight) {
+  int nElements = imgSize.height * ((imgSize.width / 2) + 1);
+
+  // create a gaussian around the location centered at the location
+  CvSize sizeOfGaussian = {gaussianSpread, gaussianSpread}; // size and sd
+  double sd = gaussianSpread / 2;
+  fftw_complex* gaussian = createGaussian(location, sizeOfGaussian, sd);
 
-    if (roiFunction)
-      cvReleaseImage(&image);
+  // find the complex conjugate of fftImage
+  fftw_complex* fftImageC = getBuffer();
+  for (int i = 0; i < nElements; i++) {
+    fftImageC[i][0] = fftImage[i][0];
+    fftImageC[i][1] = -fftImage[i][1];
   }
 
-  destroyAffineTransforms(imgLocPairs);
+  // Compute numerator and denominator terms for the filter update
+  fftw_complex* num = convolve(gaussian, fftImageC);
+  fftw_complex* den = convolve(fftImage, fftImageC);
+
+  // accumulate into filter wide numerator and denominator terms
+  for(int i = 0; i < imgSize.height; i++) {
+    for(int j = 0; j < imgSize.width / 2 + 1; j++) {
+      int ij = i * (imgSize.width / 2 + 1) + j;
+      mosseNum[ij][0] += weight * num[ij][0];
+      mosseNum[ij][1] += weight * num[ij][1];
+
+      mosseDen[ij][0] += weight * den[ij][0];
+      mosseDen[ij][1] += weight * den[ij][1];
+    }
+  }
+  nSamples += weight;
 }
 
 // create
@@ -366,9 +499,10 @@ void Filter::create() {
       double re = a * c + b * d;
       double im = b * c - a * d;
 
-      // now assign
-      filter[ij][0] = re / denom;
-      filter[ij][1] = im / denom;
+      // now assign. Frequencies outside the band of a band limited filter
+      // have no terms
+      filter[ij][0] = (denom)? re / denom : 0.0;
+      filter[ij][1] = (denom)? im / denom : 0.0;
     }
   }
 }
@@ -382,6 +516,12 @@ void Filter::save() {
     throw(err);
   }
 
+  // band limit the filter if asked to. Only the terms in the band are saved
+  if (Globals::filterBandEnergy < 1.0)
+    limitBand(Globals::filterBandEnergy);
+  int height = (isBandLimited())? bandSize.height : imgSize.height;
+  int width = (isBandLimited())? bandSize.width / 2 + 1 : imgSize.width / 2 + 1;
+
   // compose filter filename
   string filename = outputDirectory + "/" + filterName(xmlTag);
 
@@ -390,10 +530,13 @@ void Filter::save() {
   if (file.good()) {
     file << filterName(xmlTag) << endl;
     file << imgSize.height << " " << imgSize.width << endl;
+    if (isBandLimited())
+      file << "Band " << bandSize.height << " " << bandSize.width << endl;
     file << "Numerator" << endl;
-    for(int i = 0; i < imgSize.height; i++) {
-      for(int j = 0; j < imgSize.width / 2 + 1; j++) {
-	int ij = i * (imgSize.width / 2 + 1) + j;
+    for(int i = 0; i < height; i++) {
+      for(int j = 0; j < width; j++) {
+	int row = (isBandLimited())? getBandRow(i) : i;
+	int ij = row * (imgSize.width / 2 + 1) + j;
 
 	file << mosseNum[ij][0];
 	file << " ";
@@ -402,9 +545,10 @@ void Filter::save() {
       }
     }
     file << "Denominator" << endl;
-    for(int i = 0; i < imgSize.height; i++) {
-      for(int j = 0; j < imgSize.width / 2 + 1; j++) {
-	int ij = i * (imgSize.width / 2 + 1) + j;
+    for(int i = 0; i < height; i++) {
+      for(int j = 0; j < width; j++) {
+	int row = (isBandLimited())? getBandRow(i) : i;
+	int ij = row * (imgSize.width / 2 + 1) + j;
 
 	file << mosseDen[ij][0];
 	file << " ";
@@ -416,6 +560,138 @@ void Filter::save() {
   }
 }
 
+
+// saveCheckpoint
+// Method used to save the terms accumulated so far into a checkpoint file.
+// The first lines have the filter name, the image size, and the gaussian
+// spread, window center, affine transform flag and number of samples. They
+// are followed by one line per frequency with the numerator and denominator
+// terms. Terms are written with full precision so that merging checkpoints
+// gives the terms of training on all their frames at once
+
+void Filter::saveCheckpoint(string filename) {
+  ofstream file;
+  file.open(filename.c_str());
+  if (!file.good()) {
+    string err = "Filter::saveCheckpoint. Unable to open file " + filename;
+    throw (err);
+  }
+
+  file.precision(17);
+  file << filterName(xmlTag) << endl;
+  file << imgSize.height << " " << imgSize.width << endl;
+  file << gaussianSpread << " " << windowCenter.x << " " << windowCenter.y << " " <<
+    ((doAffineTransforms)? 1 : 0) << " " << nSamples << endl;
+
+  int nElements = imgSize.height * ((imgSize.width / 2) + 1);
+  for (int i = 0; i < nElements; i++)
+    file << mosseNum[i][0] << " " << mosseNum[i][1] << " " <<
+      mosseDen[i][0] << " " << mosseDen[i][1] << endl;
+
+  if (!file.good()) {
+    string err = "Filter::saveCheckpoint. Error writing file " + filename;
+    throw (err);
+  }
+  file.close();
+}
+
+// loadCheckpoint
+// Method used to create a filter from a checkpoint. The filter has the
+// training parameters and the terms of the checkpoint, and can be merged
+// with filters from other checkpoints, created and saved
+
+Filter* Filter::loadCheckpoint(string output, string filename, roiFnT roiFunction) {
+  ifstream file;
+  file.open(filename.c_str());
+  if (!file.good()) {
+    string err = "Filter::loadCheckpoint. Unable to open file " + filename;
+    throw (err);
+  }
+
+  string name;
+  CvSize size;
+  double spread;
+  CvPoint center;
+  int affine;
+  long n;
+  file >> name >> size.height >> size.width >> spread >> center.x >> center.y >>
+    affine >> n;
+  if (file.fail() || size.height < 1 || size.width < 1) {
+    string err = "Filter::loadCheckpoint. Malformed checkpoint file " + filename;
+    throw (err);
+  }
+
+  Annotations::Tag tags[] = { Annotations::LeftEye, Annotations::RightEye,
+			      Annotations::Nose, Annotations::Face };
+  int t = 0;
+  while (t < 4 && filterName(tags[t]) != name)
+    t++;
+  if (t == 4) {
+    string err = "Filter::loadCheckpoint. Unknown filter " + name + " in " + filename;
+    throw (err);
+  }
+
+  Filter* result = new Filter(output, tags[t], size, spread, center, roiFunction);
+  if (affine)
+    result->setAffineTransforms();
+  result->nSamples = n;
+
+  int nElements = size.height * ((size.width / 2) + 1);
+  for (int i = 0; i < nElements; i++)
+    file >> result->mosseNum[i][0] >> result->mosseNum[i][1] >>
+      result->mosseDen[i][0] >> result->mosseDen[i][1];
+
+  if (file.fail()) {
+    delete result;
+    string err = "Filter::loadCheckpoint. Malformed checkpoint file " + filename;
+    throw (err);
+  }
+  file.close();
+
+  return result;
+}
+
+// merge
+// Method used to add the terms accumulated by another filter to the terms of
+// this filter. The filters must be for the same LOI and have been trained
+// with the same parameters
+
+void Filter::merge(Filter& other) {
+  addTerms(other, 1.0);
+}
+
+// subtract
+// Method used to remove the terms accumulated by another filter, trained on a
+// subset of the frames of this filter, from the terms of this filter
+
+void Filter::subtract(Filter& other) {
+  addTerms(other, -1.0);
+}
+
+// addTerms
+// Method used to add the terms of another filter, scaled by the given sign,
+// to the terms of this filter
+
+void Filter::addTerms(Filter& other, double sign) {
+  if (other.xmlTag != xmlTag || other.imgSize.width != imgSize.width ||
+      other.imgSize.height != imgSize.height ||
+      other.gaussianSpread != gaussianSpread ||
+      other.windowCenter.x != windowCenter.x || other.windowCenter.y != windowCenter.y ||
+      other.doAffineTransforms != doAffineTransforms) {
+    string err = "Filter::addTerms. Filters have different training parameters.";
+    throw (err);
+  }
+
+  int nElements = imgSize.height * ((imgSize.width / 2) + 1);
+  for (int i = 0; i < nElements; i++) {
+    mosseNum[i][0] += sign * other.mosseNum[i][0];
+    mosseNum[i][1] += sign * other.mosseNum[i][1];
+    mosseDen[i][0] += sign * other.mosseDen[i][0];
+    mosseDen[i][1] += sign * other.mosseDen[i][1];
+  }
+  nSamples += (sign > 0)? other.nSamples : -other.nSamples;
+}
+
 // boostFilter
 // Method used to apply a high-boost filter to the image during preprocessing
 
@@ -426,8 +702,19 @@ void Filter::boostFilter(IplImage* src, IplImage* dest) {
 // Method that preprocesses an image that has already been loaded for a
 // subsequent application of the filter. The method returns a preprocessed
 // image which can then be used on a subsequent call to apply or update.
+// The preprocessed image is in the FFT buffer, and is overwritten when the
+// filter is applied
 
 fftw_complex* Filter::preprocessImage(IplImage* inputImg) {
+  return preprocessImage(inputImg, fftBuffer);
+}
+
+// preprocessImage
+// Method that preprocesses an image and transforms it straight into a given
+// spectrum, which has to be allocated using fftw_malloc. The spectrum is not
+// overwritten when the filter is applied
+
+fftw_complex* Filter::preprocessImage(IplImage* inputImg, fftw_complex* spectrum) {
   // we take the complex image and preprocess it here
   if (!inputImg) {
     string err = "Filter::preprocessImage. Call setImage with a valid image.";
@@ -446,6 +733,31 @@ fftw_complex* Filter::preprocessImage(IplImage* inputImg) {
   } else
     image = inputImg;
 
+  normalizeImage(image, realImg, tempImg, imageBuffer);
+
+  //  showImage((const char*)(filterName(xmlTag) + "__").c_str(), realImg);
+  //  showRealImage((const char*)filterName(xmlTag).c_str(), imageBuffer);
+
+  // Now compute the fft of the image
+  if (spectrum == fftBuffer)
+    fftw_execute(planForward);
+  else
+    fftw_execute_dft_r2c(planForward, imageBuffer, spectrum);
+
+  if (releaseImage)
+    cvReleaseImage(&image);
+
+  return spectrum;
+}
+
+// normalizeImage
+// Method that does the spatial preprocessing of a grayscale image and writes
+// the windowed result into dest. The real and temp images are used as work
+// space and are expected to be double images of the filter size. The
+// grayscale image is histogram equalized in place
+
+void Filter::normalizeImage(IplImage* image, IplImage* realImg, IplImage* tempImg,
+			    double* dest) {
   // now do histogram equalization
   cvEqualizeHist(image, image);
 
@@ -515,18 +827,263 @@ fftw_complex* Filter::preprocessImage(IplImage* inputImg) {
   cvConvertScale(realImg, realImg, scale, 0);
 
   // Apply the window
-  applyWindow(realImg, window, imageBuffer);
+  applyWindow(realImg, window, dest);
+}
 
-  //  showImage((const char*)(filterName(xmlTag) + "__").c_str(), realImg);
-  //  showRealImage((const char*)filterName(xmlTag).c_str(), imageBuffer);
+// preprocessBatch
+// Method that preprocesses a batch of grayscale images of the filter size. The
+// spatial preprocessing is done in parallel and the forward transforms of all
+// images are computed with a single batched plan. The method returns the
+// spectra of the images one after the other in a buffer that the caller is
+// expected to free using fftw_free. The images are histogram equalized in place
+
+fftw_complex* Filter::preprocessBatch(vector<IplImage*>& images) {
+  int n = images.size();
+  for (int i = 0; i < n; i++) {
+    if (!images[i] || images[i]->nChannels != 1 ||
+	images[i]->width != imgSize.width || images[i]->height != imgSize.height) {
+      string err = "Filter::preprocessBatch. Expecting grayscale images of the filter size.";
+      throw (err);
+    }
+  }
 
-  // Now compute the fft of the image
-  fftw_complex* fft = computeFFT();
+  int nElements = imgSize.height * ((imgSize.width / 2) + 1);
+  fftw_complex* spectra = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * nElements * n);
+  if (!n)
+    return spectra;
 
-  if (releaseImage)
-    cvReleaseImage(&image);
+  prepareBatch(n);
 
-  return fft;
+  #pragma omp parallel num_threads(omp_get_max_threads())
+  {
+    IplImage* real = cvCreateImage(imgSize, IPL_DEPTH_64F, 1);
+    IplImage* temp = cvCreateImage(imgSize, IPL_DEPTH_64F, 1);
+
+    #pragma omp for schedule(dynamic)
+    for (int i = 0; i < n; i++)
+      normalizeImage(images[i], real, temp, batchImages + i * length);
+
+    cvReleaseImage(&real);
+    cvReleaseImage(&temp);
+  }
+
+  fftw_execute_dft_r2c(planBatchForward, batchImages, spectra);
+
+  return spectra;
+}
+
+// prepareBatch
+// Method used to allocate the batch buffers and create the batched plans for
+// a batch of n images. Buffers and plans are kept and re-used for batches of
+// the same size
+
+void Filter::prepareBatch(int n) {
+  if (n == batchSize)
+    return;
+
+  releaseBatch();
+
+  int nElements = imgSize.height * ((imgSize.width / 2) + 1);
+  batchImages = (double*)fftw_malloc(sizeof(double) * length * n);
+  batchSpectra = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * nElements * n);
+
+  int dims[2] = { imgSize.height, imgSize.width };
+
+  #pragma omp critical(fftw_planner)
+  {
+    planBatchForward = fftw_plan_many_dft_r2c(2, dims, n,
+					      batchImages, NULL, 1, length,
+					      batchSpectra, NULL, 1, nElements,
+					      FFTW_ESTIMATE);
+    planBatchBackward = fftw_plan_many_dft_c2r(2, dims, n,
+					       batchSpectra, NULL, 1, nElements,
+					       batchImages, NULL, 1, length,
+					       FFTW_ESTIMATE);
+  }
+  batchSize = n;
+
+  if (!planBatchForward || !planBatchBackward) {
+    releaseBatch();
+    string err = "Filter::prepareBatch. Error computing batch plans.";
+    throw (err);
+  }
+}
+
+// releaseBatch
+// Method used to free the batch buffers and plans
+
+void Filter::releaseBatch() {
+  if (planBatchForward)
+    fftw_destroy_plan(planBatchForward);
+  if (planBatchBackward)
+    fftw_destroy_plan(planBatchBackward);
+  if (batchImages)
+    fftw_free(batchImages);
+  if (batchSpectra)
+    fftw_free(batchSpectra);
+  planBatchForward = planBatchBackward = 0;
+  batchImages = 0;
+  batchSpectra = 0;
+  batchSize = 0;
+}
+
+// applyBatch
+// Method used to apply the filter to n spectra computed using preprocessBatch,
+// and to get the statistics of the response to each spectrum
+
+void Filter::applyBatch(fftw_complex* spectra, int n, vector<ResponseStats>& stats) {
+  if (!spectra) {
+    string err = "Filter::applyBatch. spectra object is NULL.";
+    throw (err);
+  }
+  if (!filter) {
+    string err = "Filter::applyBatch. Invalid filter (NULL).";
+    throw (err);
+  }
+
+  stats.resize(n);
+  if (!n)
+    return;
+
+  prepareBatch(n);
+
+  int nElements = imgSize.height * ((imgSize.width / 2) + 1);
+
+  #pragma omp parallel for num_threads(omp_get_max_threads())
+  for (int i = 0; i < n; i++)
+    convolve(spectra + i * nElements, filter, batchSpectra + i * nElements);
+
+  fftw_execute(planBatchBackward);
+
+  #pragma omp parallel for num_threads(omp_get_max_threads())
+  for (int i = 0; i < n; i++)
+    computeStats(batchImages + i * length, imgSize, imgSize.width, stats[i]);
+}
+
+// preparePair
+// Method used to create the buffer and plan used to transform the full complex
+// spectrum of a pair of responses. The buffer holds all columns of the
+// spectrum, not just the non-negative frequencies
+
+void Filter::preparePair() {
+  if (planPair)
+    return;
+
+  pairBuffer = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * length);
+
+  #pragma omp critical(fftw_planner)
+  {
+    planPair = fftw_plan_dft_2d(imgSize.height, imgSize.width,
+				pairBuffer, pairBuffer,
+				FFTW_BACKWARD, FFTW_ESTIMATE);
+  }
+
+  if (!planPair) {
+    releasePair();
+    string err = "Filter::preparePair. Error computing pair plan.";
+    throw (err);
+  }
+}
+
+// releasePair
+// Method used to free the pair buffer and plan
+
+void Filter::releasePair() {
+  if (planPair)
+    fftw_destroy_plan(planPair);
+  if (pairBuffer)
+    fftw_free(pairBuffer);
+  planPair = 0;
+  pairBuffer = 0;
+}
+
+// correlatePair
+// Method used to apply two filters to the same image spectrum. The responses
+// r1 and r2 of the filters are real, so the inverse transform of P1 + iP2,
+// where P1 and P2 are the products of the spectrum with the filters, is
+// r1 + ir2. The products are only known for the non-negative frequencies of
+// the columns, and the remaining columns follow from the Hermitian symmetry
+// P(u, v) = conj(P(-u, -v)). Columns that are their own mirror, the zero and
+// Nyquist columns, are symmetrized so that the responses are exactly real
+// We build the full spectrum in one pass over both filters, take a single
+// complex inverse transform, and split its real and imaginary planes into the
+// response buffers of the two filters
+
+void Filter::correlatePair(Filter* one, Filter* two, fftw_complex* fft) {
+  if (!fft) {
+    string err = "Filter::correlatePair. fft object is NULL.";
+    throw (err);
+  }
+  if (!one->filter || !two->filter) {
+    string err = "Filter::correlatePair. Invalid filter (NULL).";
+    throw (err);
+  }
+  if (one->imgSize.width != two->imgSize.width ||
+      one->imgSize.height != two->imgSize.height) {
+    string err = "Filter::correlatePair. Filters have different sizes.";
+    throw (err);
+  }
+
+  one->preparePair();
+
+  int height = one->imgSize.height;
+  int width = one->imgSize.width;
+  int halfWidth = width / 2 + 1;
+  fftw_complex* f1 = one->filter;
+  fftw_complex* f2 = two->filter;
+  fftw_complex* z = one->pairBuffer;
+
+  for (int i = 0; i < height; i++) {
+    int mi = (height - i) % height;
+    for (int j = 0; j < halfWidth; j++) {
+      int ij = i * halfWidth + j;
+
+      // the products of the spectrum with both filters
+      double p1r = fft[ij][0] * f1[ij][0] - fft[ij][1] * f1[ij][1];
+      double p1i = fft[ij][0] * f1[ij][1] + fft[ij][1] * f1[ij][0];
+      double p2r = fft[ij][0] * f2[ij][0] - fft[ij][1] * f2[ij][1];
+      double p2i = fft[ij][0] * f2[ij][1] + fft[ij][1] * f2[ij][0];
+
+      int mj = (width - j) % width;
+      if (mj == j) {
+	// the mirror of the term is in the same column. We average the term
+	// with the conjugate of its mirror
+	int mij = mi * halfWidth + j;
+	double m1r = fft[mij][0] * f1[mij][0] - fft[mij][1] * f1[mij][1];
+	double m1i = fft[mij][0] * f1[mij][1] + fft[mij][1] * f1[mij][0];
+	double m2r = fft[mij][0] * f2[mij][0] - fft[mij][1] * f2[mij][1];
+	double m2i = fft[mij][0] * f2[mij][1] + fft[mij][1] * f2[mij][0];
+	p1r = 0.5 * (p1r + m1r);
+	p1i = 0.5 * (p1i - m1i);
+	p2r = 0.5 * (p2r + m2r);
+	p2i = 0.5 * (p2i - m2i);
+      } else {
+	// the mirror term is conj(P1) + i * conj(P2)
+	fftw_complex& mirror = z[mi * width + mj];
+	mirror[0] = p1r + p2i;
+	mirror[1] = p2r - p1i;
+      }
+
+      fftw_complex& term = z[i * width + j];
+      term[0] = p1r - p2i;
+      term[1] = p1i + p2r;
+    }
+  }
+
+  fftw_execute(one->planPair);
+
+  // split the planes into the two responses
+  double* r1 = one->responseBuffer;
+  double* r2 = two->responseBuffer;
+  for (int i = 0; i < one->length; i++) {
+    r1[i] = z[i][0];
+    r2[i] = z[i][1];
+  }
+
+  computeStats(r1, one->imgSize, width, one->stats);
+  computeStats(r2, two->imgSize, width, two->stats);
+  one->responsePending = true;
+  two->responsePending = true;
 }
 
 // apply
@@ -539,6 +1096,16 @@ fftw_complex* Filter::preprocessImage(IplImage* inputImg) {
 // c. Compose an image object using the IFFT data and return it
 
 IplImage* Filter::apply(fftw_complex* fft) {
+  correlate(fft);
+  return getResponse();
+}
+
+// correlate
+// Method used to apply the filter to an image FFT and compute the statistics
+// of the response. The response is kept in the response buffer, and the post
+// filter image is only computed from it when asked for using getResponse
+
+const ResponseStats& Filter::correlate(fftw_complex* fft) {
   // first check if we have done the preprocessing step
   if (!fft) {
     string err = "Filter::apply. fft object is NULL.";
@@ -553,40 +1120,309 @@ IplImage* Filter::apply(fftw_complex* fft) {
   // now take product of the fft data and the filter data
   convolve(fft, filter, fftBuffer /* result will be stored here */);
 
-  // now get the inverse FFT and return
-  IplImage* postFilterImg = computeInvFFT();
-  
-  double min;
-  double max;
+  // now get the inverse FFT and its statistics
+  fftw_execute(planResponse);
+  computeStats(responseBuffer, imgSize, imgSize.width, stats);
+  responsePending = true;
+
+  return stats;
+}
+
+// getResponse
+// Method that returns the response of the last call to correlate, scaled by
+// its max value
+
+IplImage* Filter::getResponse() {
+  if (!responsePending)
+    return postFilterImg;
+
+  double scale = 1.0 / stats.max;
+  int step = postFilterImg->widthStep / sizeof(double);
+  double* imageData = (double*)postFilterImg->imageData;
+  for (int i = 0; i < imgSize.height; i++) {
+    double* row = responseBuffer + i * imgSize.width;
+    for (int j = 0; j < imgSize.width; j++)
+      imageData[j] = row[j] * scale;
+    imageData += step;
+  }
+  responsePending = false;
 
-  cvMinMaxLoc(postFilterImg, &min, &max, NULL, NULL);
-  double scale = 1.0 / max;
-  cvConvertScale(postFilterImg, postFilterImg, scale, 0.0);
-  
   return postFilterImg;
 }
 
+// computeStats
+// Method used to compute the statistics of a response. We find the extremal
+// values in one pass over the response, and the sidelobe mean and standard
+// deviation in a pass over the window around the peak. The PSR is as in
+// Bolme et al., the difference of the peak and the sidelobe mean in units of
+// the sidelobe standard deviation
+
+void Filter::computeStats(double* data, CvSize size, int step, ResponseStats& stats) {
+  double maxValue = -DBL_MAX;
+  double minValue = DBL_MAX;
+  int maxX = 0, maxY = 0;
+  int minX = 0, minY = 0;
+  for (int i = 0; i < size.height; i++) {
+    double* row = data + i * step;
+    for (int j = 0; j < size.width; j++) {
+      double value = row[j];
+      if (value > maxValue) {
+	maxValue = value;
+	maxX = j;
+	maxY = i;
+      }
+      if (value < minValue) {
+	minValue = value;
+	minX = j;
+	minY = i;
+      }
+    }
+  }
+  stats.max = maxValue;
+  stats.min = minValue;
+  stats.maxLoc = cvPoint(maxX, maxY);
+  stats.minLoc = cvPoint(minX, minY);
+
+  int left = (maxX + size.width - 1) % size.width;
+  int right = (maxX + 1) % size.width;
+  int up = (maxY + size.height - 1) % size.height;
+  int down = (maxY + 1) % size.height;
+  stats.neighbours[0] = data[maxY * step + left];
+  stats.neighbours[1] = data[maxY * step + right];
+  stats.neighbours[2] = data[up * step + maxX];
+  stats.neighbours[3] = data[down * step + maxX];
+
+  // the sidelobe. The window is clipped to the response
+  int halfWidth = min(Globals::psrWidth / 2, min(size.width, size.height) / 2);
+  int exclusion = Globals::psrExclusion;
+  double sum = 0;
+  double squares = 0;
+  int count = 0;
+  for (int dy = -halfWidth; dy < halfWidth; dy++) {
+    double* row = data + ((maxY + dy + size.height) % size.height) * step;
+    bool excluded = (dy >= -exclusion && dy <= exclusion);
+    for (int dx = -halfWidth; dx < halfWidth; dx++) {
+      if (excluded && dx >= -exclusion && dx <= exclusion)
+	continue;
+      double value = row[(maxX + dx + size.width) % size.width];
+      sum += value;
+      squares += value * value;
+      count++;
+    }
+  }
+
+  stats.sidelobeMean = (count)? sum / count : 0.0;
+  double variance = (count)? squares / count - stats.sidelobeMean * stats.sidelobeMean : 0.0;
+  stats.sidelobeSD = (variance > 0)? sqrt(variance) : 0.0;
+  stats.psr = (stats.sidelobeSD > 0)? (maxValue - stats.sidelobeMean) / stats.sidelobeSD : 0.0;
+}
+
+void Filter::computeStats(IplImage* response, ResponseStats& stats) {
+  computeStats((double*)response->imageData, cvGetSize(response),
+	       response->widthStep / sizeof(double), stats);
+}
+
+// createPatchFilter
+// Method used to derive a filter for image patches of a given size. The
+// filter does not depend on where the LOI is in the training images, and its
+// spatial form is concentrated around the origin. We crop the spatial filter
+// to the patch size around the origin and transform it at the patch size. The
+// response of the derived filter to a patch peaks at the LOI in the patch
+
+Filter* Filter::createPatchFilter(CvSize size) {
+  if (!filter) {
+    string err = "Filter::createPatchFilter. Invalid filter (NULL).";
+    throw (err);
+  }
+  if (size.width > imgSize.width || size.height > imgSize.height) {
+    string err = "Filter::createPatchFilter. The patch is larger than the filter.";
+    throw (err);
+  }
+
+  // get the spatial filter
+  int nElements = imgSize.height * ((imgSize.width / 2) + 1);
+  memcpy(fftBuffer, filter, sizeof(fftw_complex) * nElements);
+  fftw_execute(planBackward);
+
+  CvPoint center;
+  center.x = size.width / 2;
+  center.y = size.height / 2;
+  Filter* patch = new Filter(outputDirectory, xmlTag, size, gaussianSpread, center,
+			     roiFunction);
+
+  // crop it around the origin. The inverse transform is not normalized, so
+  // we divide by the number of pixels
+  for (int i = 0; i < size.height; i++) {
+    int y = (i < size.height / 2)? i : imgSize.height - (size.height - i);
+    for (int j = 0; j < size.width; j++) {
+      int x = (j < size.width / 2)? j : imgSize.width - (size.width - j);
+      patch->imageBuffer[i * size.width + j] = imageBuffer[y * imgSize.width + x] / length;
+    }
+  }
+
+  int nPatchElements = size.height * ((size.width / 2) + 1);
+  fftw_complex* fft = patch->computeFFT();
+  patch->filter = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * nPatchElements);
+  memcpy(patch->filter, fft, sizeof(fftw_complex) * nPatchElements);
+
+  return patch;
+}
+
+// createCoarseFilter
+// Method used to derive a filter for images downsampled by a given factor. The
+// spectrum of a downsampled image is the low frequency part of the spectrum of
+// the image, so we crop the filter to the lowest frequencies. Each row of the
+// filter holds the non negative horizontal frequencies, and rows go over the
+// non negative and then the negative vertical frequencies
+
+Filter* Filter::createCoarseFilter(int factor) {
+  if (!filter) {
+    string err = "Filter::createCoarseFilter. Invalid filter (NULL).";
+    throw (err);
+  }
+
+  CvSize size = cvSize(imgSize.width / factor, imgSize.height / factor);
+  if (size.width < 2 || size.height < 2) {
+    string err = "Filter::createCoarseFilter. The downsampling factor is too large.";
+    throw (err);
+  }
+
+  CvPoint center;
+  center.x = windowCenter.x / factor;
+  center.y = windowCenter.y / factor;
+  Filter* coarse = new Filter(outputDirectory, xmlTag, size, gaussianSpread / factor,
+			      center, roiFunction);
+
+  int width = imgSize.width / 2 + 1;
+  int coarseWidth = size.width / 2 + 1;
+  coarse->filter = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * size.height * coarseWidth);
+  for (int i = 0; i < size.height; i++) {
+    int row = (i <= size.height / 2)? i : imgSize.height - (size.height - i);
+    for (int j = 0; j < coarseWidth; j++) {
+      coarse->filter[i * coarseWidth + j][0] = filter[row * width + j][0];
+      coarse->filter[i * coarseWidth + j][1] = filter[row * width + j][1];
+    }
+  }
+
+  return coarse;
+}
+
+// limitBand
+// Method used to band limit the filter. The energy of the filter is mostly in
+// the low frequencies. We grow a block of low frequencies, with the aspect
+// ratio of the filter, until it holds the given fraction of the energy of the
+// filter, and zero the filter outside the block. The block is laid out like
+// the spectrum of an image of the band size, so that applyBand can get a
+// decimated response using an inverse transform of the band size
+
+void Filter::limitBand(double energy) {
+  if (!filter) {
+    string err = "Filter::limitBand. Invalid filter (NULL).";
+    throw (err);
+  }
+
+  // the energy in each row of the spectrum, up to each column. Columns other
+  // than the first and last stand for two conjugate frequencies
+  int width = imgSize.width / 2 + 1;
+  vector<double> rowEnergy(imgSize.height * width);
+  double total = 0;
+  for (int i = 0; i < imgSize.height; i++) {
+    double sum = 0;
+    for (int j = 0; j < width; j++) {
+      int ij = i * width + j;
+      double weight = (j && 2 * j != imgSize.width)? 2.0 : 1.0;
+      sum += weight * (filter[ij][0] * filter[ij][0] + filter[ij][1] * filter[ij][1]);
+      rowEnergy[ij] = sum;
+    }
+    total += sum;
+  }
+
+  CvSize size = imgSize;
+  for (int k = 1; 2 * k < imgSize.height; k++) {
+    int kx = (int)ceil((double)k * imgSize.width / imgSize.height);
+    if (2 * kx >= imgSize.width)
+      break;
+
+    bandSize = cvSize(2 * kx, 2 * k);
+    double sum = 0;
+    for (int i = 0; i < bandSize.height; i++)
+      sum += rowEnergy[getBandRow(i) * width + kx];
+    if (sum >= energy * total) {
+      size = bandSize;
+      break;
+    }
+  }
+
+  bandSize = cvSize(0, 0);
+  releaseBand();
+  if (size.width == imgSize.width && size.height == imgSize.height)
+    return;
+
+  // zero the terms outside the band
+  bandSize = size;
+  int bandWidth = bandSize.width / 2 + 1;
+  vector<bool> inBand(imgSize.height, false);
+  for (int i = 0; i < bandSize.height; i++)
+    inBand[getBandRow(i)] = true;
+  for (int i = 0; i < imgSize.height; i++) {
+    for (int j = 0; j < width; j++) {
+      if (inBand[i] && j < bandWidth)
+	continue;
+      int ij = i * width + j;
+      filter[ij][0] = filter[ij][1] = 0;
+      mosseNum[ij][0] = mosseNum[ij][1] = 0;
+      mosseDen[ij][0] = mosseDen[ij][1] = 0;
+    }
+  }
+
+  createBandPlan();
+}
+
+// applyBand
+// Method used to apply a band limited filter to the spectrum of an image. We
+// take the product in the band and transform it back at the band size, which
+// gives the response decimated by the ratio of the filter size to the band
+// size. The returned image is a view of the band buffer, and the response is
+// not scaled
+
+IplImage* Filter::applyBand(fftw_complex* fft) {
+  if (!fft) {
+    string err = "Filter::applyBand. fft object is NULL.";
+    throw (err);
+  }
+  if (!filter || !isBandLimited()) {
+    string err = "Filter::applyBand. The filter is not band limited.";
+    throw (err);
+  }
+
+  int width = imgSize.width / 2 + 1;
+  int bandWidth = bandSize.width / 2 + 1;
+  for (int i = 0; i < bandSize.height; i++) {
+    int row = getBandRow(i);
+    for (int j = 0; j < bandWidth; j++) {
+      int ij = row * width + j;
+      int k = i * bandWidth + j;
+      bandBuffer[k][0] = (fft[ij][0] * filter[ij][0]) - (fft[ij][1] * filter[ij][1]);
+      bandBuffer[k][1] = (fft[ij][0] * filter[ij][1]) + (fft[ij][1] * filter[ij][0]);
+    }
+  }
+  fftw_execute(planBand);
+
+  return bandImg;
+}
+
 // computeInvFFT
 // This method computes an inverse FFT. The input is always expected to
-// be in imageBuffer (for performance using openmp). The result will be
-// This method takes as input a complex array and performs an inverse FFT
-// on it. The result is then returned as an IplImage object
+// be in fftBuffer (for performance using openmp). The result is returned as
+// an IplImage view of imageBuffer, which is valid until imageBuffer is next
+// written
 
 IplImage* Filter::computeInvFFT() {
   // compute inverse FFT
   fftw_execute(planBackward);
-  
-  // create a new image and copy inverse data as image data
-  int step = postFilterImg->widthStep;
-  double* imageData = (double*)postFilterImg->imageData;
-  for (int i = 0; i < imgSize.height; i++) {
-    for (int j = 0; j < imgSize.width; j++) {
-      *(imageData++) = imageBuffer[i * imgSize.width + j];
-    }
-    imageData += step / sizeof(double) - imgSize.width;
-  }
-  
-  return postFilterImg;    
+
+  // the image is a view of the inverse
+  return imageView;
 }
 
 // The following section has implementations of the helper methods
@@ -648,67 +1484,74 @@ fftw_complex* Filter::computeFFT() {
 /* Private methods */
 
 // createGaussian
-// Method to create a gaussian field of a given size at a given location on an
-// image plane that is of the same size as the training images
+// Method to create the spectrum of a gaussian field of a given size at a given
+// location on an image plane that is of the same size as the training images.
+// The gaussian is the product of a profile along the rows and one along the
+// columns, so its spectrum is the product of the spectra of the profiles. We
+// compute the spectra of the profiles directly, which is exact and saves a
+// forward transform per training image
 
 fftw_complex* Filter::createGaussian(CvPoint& location, CvSize& size, double sd) {
-  // Linear space vector. Create a meshgrid with x and y axes values
-  // that stradle the location
+  int width = imgSize.width / 2 + 1;
 
-  double xspacer[imgSize.width];
-  double yspacer[imgSize.height];
+  double xre[width];
+  double xim[width];
+  double yre[imgSize.height];
+  double yim[imgSize.height];
+  getProfileSpectrum(location.x, imgSize.width, width, sd, xre, xim);
+  getProfileSpectrum(location.y, imgSize.height, imgSize.height, sd, yre, yim);
 
-  int lx = location.x;
-  double left = -lx;
-  for (int i = 0; i < imgSize.width; i++) {
-    xspacer[i] = left;
-    left += 1.0;
-  }
-  int ly = location.y;
-  double top = -ly;
+  fftw_complex* fft = getBuffer();
   for (int i = 0; i < imgSize.height; i++) {
-    yspacer[i] = top;
-    top += 1.0;
+    for (int j = 0; j < width; j++) {
+      int ij = i * width + j;
+      fft[ij][0] = yre[i] * xre[j] - yim[i] * xim[j];
+      fft[ij][1] = yre[i] * xim[j] + yim[i] * xre[j];
+    }
   }
+  return fft;
+}
 
-  // Mesh grid
-  double x[imgSize.height][imgSize.width];
-  double y[imgSize.height][imgSize.width];
-
-  for (int i = 0; i < imgSize.height; i++) {
-    for (int j = 0; j < imgSize.width; j++) {
-      x[i][j] = xspacer[j];
-      y[i][j] = yspacer[i];
+// getProfileSpectrum
+// Method to compute the first nFrequencies terms of the DFT of the profile
+// exp(-(k - center)^2 / sd), k in [0, n). Only the terms where the profile
+// does not vanish contribute
+
+void Filter::getProfileSpectrum(int center, int n, int nFrequencies, double sd,
+				double* re, double* im) {
+  double profile[n];
+  int first = n;
+  int last = -1;
+  for (int k = 0; k < n; k++) {
+    double d = k - center;
+    profile[k] = exp(-((d * d) / sd));
+    if (profile[k] > 0) {
+      first = min(first, k);
+      last = k;
     }
   }
 
-  // create a gaussian as big as the image
-  double gaussian[imgSize.height][imgSize.width];
-
-  double det = sd * sd;
-  for (int i = 0; i < imgSize.height; i++) {
-    for (int j = 0; j < imgSize.width; j++) {
-      // using just the gaussian kernel
-      double X = x[i][j] * x[i][j];
-      double Y = y[i][j] * y[i][j];
-      gaussian[i][j] = exp(-((X * sd + Y * sd) / det));
-    }
+  // twiddle factors, indexed by the product of frequency and position
+  // modulo n
+  double c[n];
+  double s[n];
+  for (int k = 0; k < n; k++) {
+    double angle = -2 * M_PI * k / n;
+    c[k] = cos(angle);
+    s[k] = sin(angle);
   }
 
-  // now initialize a real array as large as the image array with the values
-  // of the gaussian
-  for (int i = 0; i < length; i++)
-    imageBuffer[i] = 0;
-  for (int i = 0; i < imgSize.height; i++) {
-    for (int j = 0; j < imgSize.width; j++) {
-      imageBuffer[i * imgSize.width + j] = gaussian[i][j];
+  for (int f = 0; f < nFrequencies; f++) {
+    double sumRe = 0;
+    double sumIm = 0;
+    for (int k = first; k <= last; k++) {
+      int t = (f * k) % n;
+      sumRe += profile[k] * c[t];
+      sumIm += profile[k] * s[t];
     }
+    re[f] = sumRe;
+    im[f] = sumIm;
   }
-
-  //  showRealImage("__gaussian", imageBuffer);
-
-  fftw_complex* fft = computeFFT();
-  return fft;
 }
 
 // applyWindow
@@ -908,6 +1751,7 @@ void Filter::loadFilter(string filename) {
   bool isNumeratorTerm = true;
   
   length = 0;
+  bandSize = cvSize(0, 0);
 
   try {
     filterFile.open(filename.c_str());
@@ -962,6 +1806,13 @@ void Filter::loadFilter(string filename) {
 	for (int i = 0; i < nElements; i++) {
 	  mosseNum[i][0] = mosseNum[i][1] = mosseDen[i][0] = mosseDen[i][1] = 0;
 	}
+      } else if (line.find("Band") != string::npos) {
+	// band limited filters only hold the terms in the band
+	if (sscanf(line.c_str(), "Band %d %d", &bandSize.height, &bandSize.width) != 2 ||
+	    bandSize.height > height || bandSize.width > width) {
+	  string err = "Filter::loadFilter. Malformed band in " + filename;
+	  throw (err);
+	}
       } else if (line.find("Numerator") != string::npos) {
 	isNumeratorTerm = true;
 	index = 0;
@@ -973,15 +1824,21 @@ void Filter::loadFilter(string filename) {
 	const char* str = line.c_str();
 	const char* token = strtok((char*)str, "\t ");
 
+	int ij = index;
+	if (isBandLimited()) {
+	  int bandWidth = bandSize.width / 2 + 1;
+	  ij = getBandRow(index / bandWidth) * (width / 2 + 1) + index % bandWidth;
+	}
+
 	if (isNumeratorTerm) {
-	  mosseNum[index][0] = strtod(token, NULL);
+	  mosseNum[ij][0] = strtod(token, NULL);
 	  token = strtok(NULL, "\t ");
-	  mosseNum[index][1] = strtod(token, NULL);
+	  mosseNum[ij][1] = strtod(token, NULL);
 	} else {
-	  mosseDen[index][0] = strtod(token, NULL);
+	  mosseDen[ij][0] = strtod(token, NULL);
 	  token = strtok(NULL, "\t ");
-	  mosseDen[index][1] = strtod(token, NULL);
-	  if (mosseDen[index][1] != 0)
+	  mosseDen[ij][1] = strtod(token, NULL);
+	  if (mosseDen[ij][1] != 0)
 	    cout << "ERROR. Corrupt Filter. Non-zero imaginary part in the denominator." << endl;
 	}
 	index++;
@@ -1017,101 +1874,3 @@ string Filter::filterName(Annotations::Tag tag) {
     throw ("Filter::filterName. Unknown tag.");
   }
 }
-
-// getAffineTransforms
-// Method to generate a set of affine transformations of a given image. The
-// image is rotated and translated to perturb the LOI around the given location.
-// The method returns a vector of images that have been perturbed with small
-// affine transforms
-
-vector<ImgLocPairT>& Filter::getAffineTransforms(IplImage* image, CvPoint location) {
-  // first check if affine transformations are needed, if not then simply
-  // push the input images to the vector of transformed images and return
-  transformedImages.push_back(make_pair(image, location));
-  if (!doAffineTransforms)
-    return transformedImages;
-
-  // Setup unchanging data sets used for transformations
-  // for rotation
-  Mat imageMat(image);
-  Point2f center(imageMat.cols / 2.0F, imageMat.rows / 2.0F);
-
-  // for translation
-  Mat translationMat = getRotationMatrix2D(center, 0, 1.0);
-  translationMat.at<double>(0, 0) = 1;
-  translationMat.at<double>(0, 1) = 0;
-  translationMat.at<double>(1, 0) = 0;
-  translationMat.at<double>(1, 1) = 1;
-
-  // perform rotations. For each rotated image, do a set of translations
-  // and push images into the vector of transformed images
-  for (double angle = -2.0; angle < 2.0; angle += 0.25) {
-    // skip when no rotation is required. This image is already part of
-    // out training set
-    if (angle == 0) continue;
- 
-    Mat rotationMat = getRotationMatrix2D(center, angle, 1.0);
-    IplImage* transformedImage = cvCloneImage(image);
-    Mat dest(transformedImage);
-    warpAffine(imageMat, dest, rotationMat, imageMat.size());
-
-    CvPoint rotatedLocation;
-    rotatedLocation.x = rotationMat.at<double>(0, 0) * location.x +
-      rotationMat.at<double>(0, 1) * location.y +
-      rotationMat.at<double>(0, 2);
-    rotatedLocation.y = rotationMat.at<double>(1, 0) * location.x +
-      rotationMat.at<double>(1, 1) * location.y +
-      rotationMat.at<double>(1, 2);
-
-    // check if the rotated location is out of bounds with respect
-    // to the image window. Do not add those images to the set
-    if (rotatedLocation.x < 0 || rotatedLocation.x > imgSize.width ||
-	rotatedLocation.y < 0 || rotatedLocation.y > imgSize.height) {
-      cvReleaseImage(&transformedImage);
-      continue;
-    }
-
-    pair<IplImage*, CvPoint> p = make_pair(transformedImage, rotatedLocation);
-    transformedImages.push_back(p);
-
-    // perform a set of translations of each rotated image
-    Mat src(transformedImage);
-    for (double xdist = -20; xdist <= 20; xdist += 10) 
-      for (double ydist = -20; ydist <= 20; ydist += 10) {
-	// skip when no translation is needed
-	if (!xdist && !ydist) continue;
-      
-	translationMat.at<double>(0, 2) = xdist;
-	translationMat.at<double>(1, 2) = ydist;
-	IplImage* translatedImage = cvCloneImage(transformedImage);
-	Mat dest(translatedImage);
-	warpAffine(src, dest, translationMat, src.size());
-
-	CvPoint translatedLocation;
-	translatedLocation.x = rotatedLocation.x + xdist;
-	translatedLocation.y = rotatedLocation.y + ydist;
-
-	// check if the translated location is out of bounds with respect
-	// to the image window. Do not add those images to the set
-	if (translatedLocation.x < 0 || translatedLocation.x > imgSize.width ||
-	    translatedLocation.y < 0 || translatedLocation.y > imgSize.height) {
-	  cvReleaseImage(&translatedImage);
-	  continue;
-	}
-      
-	pair<IplImage*, CvPoint> p = make_pair(translatedImage, translatedLocation);
-	transformedImages.push_back(p);
-      }
-  }
-
-  return transformedImages;
-}
-
-// destroyAffineTransforms
-// Method to destroy the images generated using affine transforms
-
-void Filter::destroyAffineTransforms(vector<ImgLocPairT>& imgLocPairs) {
-  for (unsigned int i = 0; i < imgLocPairs.size(); i++)
-    cvReleaseImage(&(imgLocPairs[i].first));
-  imgLocPairs.clear();
-}
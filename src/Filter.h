@@ -19,13 +19,27 @@
 #include <stdlib.h>
 
 #include "Annotations.h"
+#include "AffineAugmenter.h"
 
 // the ROI extraction function pointer type
 typedef IplImage* (*roiFnT)(IplImage*, FrameAnnotation&, 
 			    CvPoint&, Annotations::Tag xmlTag);
 
-// an image and location pair type
-typedef pair<IplImage*, CvPoint> ImgLocPairT;
+// the statistics of a filter response. Values are those of the response
+// before it is scaled by its max. The sidelobe is the window of width
+// Globals::psrWidth around the peak, less the window of half width
+// Globals::psrExclusion around the peak. Windows and neighbours wrap around
+// the edges of the response, which is circular
+struct ResponseStats {
+  double max;                      // the max value
+  double min;                      // the min value
+  CvPoint maxLoc;                  // the location of the max value
+  CvPoint minLoc;                  // the location of the min value
+  double neighbours[4];            // the values left, right, up and down of the max
+  double sidelobeMean;             // the mean of the sidelobe
+  double sidelobeSD;               // the standard deviation of the sidelobe
+  double psr;                      // the peak to sidelobe ratio
+};
 
 class Filter : public FilterBase {
  protected:
@@ -46,8 +60,14 @@ class Filter : public FilterBase {
   Filter(string outputDirectory, Annotations::Tag xmlTag, 
 	 CvPoint& windowCenter);
 
+  // Copy constructor that creates an independent copy of a filter
+  Filter(const Filter& other);
+
   virtual ~Filter();
 
+  // method to create a copy of a filter that can be used concurrently
+  virtual Filter* clone() { return new Filter(*this); }
+
   // main methods
   virtual void addTrainingSet(string trainingDirectory);
   virtual void create();
@@ -56,12 +76,82 @@ class Filter : public FilterBase {
   }
   virtual void save();
 
-  // method to preprocess images
+  // methods for accumulator checkpoints. A checkpoint holds the numerator and
+  // denominator terms accumulated so far, the number of samples and the
+  // training parameters. Filters trained on disjoint sets of frames, in
+  // different processes or on different machines, are merged into the filter
+  // for the union of those frames by adding their terms. loadCheckpoint
+  // creates a filter from a checkpoint, which the caller owns
+  virtual void saveCheckpoint(string filename);
+  static Filter* loadCheckpoint(string outputDirectory, string filename,
+				roiFnT roiFunction = 0);
+  virtual void merge(Filter& other);
+
+  // method to remove the terms accumulated by another filter from the terms
+  // of this filter. Used to derive the filter that leaves out a set of
+  // frames from the filter for all frames
+  virtual void subtract(Filter& other);
+  long getNSamples() { return nSamples; }
+
+  // methods to preprocess images, into the FFT buffer or straight into a
+  // given spectrum
   virtual fftw_complex* preprocessImage(IplImage* image);
+  virtual fftw_complex* preprocessImage(IplImage* image, fftw_complex* spectrum);
 
   // method to apply a filter to an image array
   virtual IplImage* apply(fftw_complex* imageFFT);
 
+  // methods to apply a filter to an image array and get the statistics of
+  // the response, and to get the response scaled by its max. The response
+  // image is only computed when asked for, and is valid until the next call
+  // to apply or correlate
+  virtual const ResponseStats& correlate(fftw_complex* imageFFT);
+  IplImage* getResponse();
+
+  // methods to compute the statistics of a response in a single pass over
+  // the response and one over the sidelobe window. Step is the distance
+  // between rows in doubles
+  static void computeStats(double* data, CvSize size, int step, ResponseStats& stats);
+  static void computeStats(IplImage* response, ResponseStats& stats);
+
+  // method to derive a filter for image patches of a given size, which is
+  // smaller than the size of this filter. The caller owns the derived filter
+  virtual Filter* createPatchFilter(CvSize size);
+
+  // method to derive a filter for images downsampled by a given factor. The
+  // caller owns the derived filter
+  virtual Filter* createCoarseFilter(int factor);
+
+  // methods for band limited filters. limitBand keeps the smallest block of
+  // low frequencies that holds the given fraction of the filter energy, and
+  // applyBand applies the band to an image spectrum and returns a response
+  // decimated to the band size
+  virtual void limitBand(double energy);
+  virtual IplImage* applyBand(fftw_complex* imageFFT);
+  bool isBandLimited() { return bandSize.width > 0; }
+  CvSize getBandSize() { return bandSize; }
+
+  // method to tell the filter the zone classified for the last image it was
+  // applied to. Only online filters use it, to update on zone changes
+  virtual void setZone(int zone) { }
+
+  // methods to preprocess a batch of grayscale images and to apply a filter
+  // to n of the resulting spectra, getting the statistics of each response.
+  // Used for offline batch classification
+  virtual fftw_complex* preprocessBatch(vector<IplImage*>& images);
+  virtual void applyBatch(fftw_complex* spectra, int n, vector<ResponseStats>& stats);
+
+  // method to apply two filters of the same size to the same image spectrum
+  // using a single complex inverse transform. The response of the first
+  // filter is the real part of the transform and that of the second filter
+  // the imaginary part. The statistics of both responses are computed as in
+  // correlate. Online filters update on correlate and cannot be paired
+  static void correlatePair(Filter* one, Filter* two, fftw_complex* imageFFT);
+  virtual bool isOnline() { return false; }
+
+  // method to get the statistics of the last response
+  const ResponseStats& getStats() { return stats; }
+
   // public helper methods
   fftw_complex* convolve(fftw_complex* one, fftw_complex* two, 
 			 fftw_complex* result = 0);
@@ -69,10 +159,16 @@ class Filter : public FilterBase {
   fftw_complex* computeFFT(IplImage* image);
   fftw_complex* computeFFT();
 
+  // method to accumulate the numerator and denominator terms of an image
+  // spectrum computed using preprocessImage, and the location of interest in
+  // the image. The terms are scaled by the weight of the image
+  void addSpectrum(fftw_complex* imageFFT, CvPoint& location, int weight = 1);
+
   // method to set window center
   void setWindowCenter(CvPoint& center);
 
   CvSize getSize() { return imgSize; }
+  Annotations::Tag getTag() { return xmlTag; }
 
   // filter name from annotation tag
   static string filterName(Annotations::Tag tag);
@@ -101,14 +197,28 @@ class Filter : public FilterBase {
 
  protected:
   void update(string filename, FrameAnnotation* fa);
+  void addTerms(Filter& other, double sign);
+  void addSample(IplImage* image, CvPoint& location, int weight = 1);
   void loadFilter(string filename);
+  void createPlans();
+  void normalizeImage(IplImage* image, IplImage* realImg, IplImage* tempImg,
+		      double* dest);
+  void prepareBatch(int n);
+  void releaseBatch();
+  void preparePair();
+  void releasePair();
+  void createBandPlan();
+  void releaseBand();
+  int getBandRow(int i) {
+    return (i <= bandSize.height / 2)? i : imgSize.height - (bandSize.height - i);
+  }
   fftw_complex* createGaussian(CvPoint& location, CvSize& size, double sd);
+  static void getProfileSpectrum(int center, int n, int nFrequencies, double sd,
+				 double* re, double* im);
   double* createCosine(CvPoint& location);
   double* createWindow(CvPoint& location, double xSpread, double ySpread);
   void applyWindow(IplImage* src, double* window, double* dest);
   void applyWindow(IplImage* src, double* window, IplImage* dest);
-  vector<ImgLocPairT>& getAffineTransforms(IplImage* image, CvPoint location);
-  void destroyAffineTransforms(vector<ImgLocPairT>& imgLocPairs);
   void boostFilter(IplImage* src, IplImage* dest);
 
   // if the following is set then for each update operation during
@@ -117,18 +227,28 @@ class Filter : public FilterBase {
   // the affine transformations of the image
   bool doAffineTransforms;
 
-  // used to store a set of images after doing small perturbations of the
-  // images using affine transformations for filter update
-  vector<ImgLocPairT> transformedImages;
+  // the generator of the affine transformations of training images, created
+  // on the first update
+  AffineAugmenter* augmenter;
 
   // members used to accumulate numerator and denominator terms for 
   // each filter object
   fftw_complex* mosseNum;
   fftw_complex* mosseDen;
+  long nSamples;                   // the weight of the samples accumulated
 
   // post filter image
   IplImage* postFilterImg;
 
+  // the response of the last call to correlate, its statistics, and whether
+  // the post filter image has yet to be computed from it
+  double* responseBuffer;
+  ResponseStats stats;
+  bool responsePending;
+
+  // image header over the image buffer
+  IplImage* imageView;
+
   // buffer variables that are used to re-use image buffers for obviating
   // the need to allocate and free memory
   static int nComplexVectors;
@@ -149,9 +269,31 @@ class Filter : public FilterBase {
   // pre-created forward and backward FFT plans 
   fftw_plan planForward;
   fftw_plan planBackward;
+  fftw_plan planResponse;
 
   vector<fftw_complex*> complexVectors;
 
+  // buffers and plans used to transform a batch of images at once. They
+  // are created for the size of the last batch
+  int batchSize;
+  double* batchImages;
+  fftw_complex* batchSpectra;
+  fftw_plan planBatchForward;
+  fftw_plan planBatchBackward;
+
+  // the full complex spectrum of a pair of responses and the complex
+  // inverse plan on it, created on demand by preparePair
+  fftw_complex* pairBuffer;
+  fftw_plan planPair;
+
+  // the band of a band limited filter, and the buffers and plan used to
+  // compute decimated responses. The band size is zero for full filters
+  CvSize bandSize;
+  fftw_complex* bandBuffer;
+  double* bandReal;
+  IplImage* bandImg;
+  fftw_plan planBand;
+
   // helper methods to get a free buffer
   inline fftw_complex* getBuffer() {
     fftw_complex* __result = complexVectors[storageIndex];
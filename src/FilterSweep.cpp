@@ -0,0 +1,309 @@
+// FilterSweep.cpp
+// This file contains the implementation of class FilterSweep
+
+#include "FilterSweep.h"
+#include "GazeTracker.h"
+
+// Class construction
+
+FilterSweep::FilterSweep(string output, string cache, vector<string>& training,
+			 vector<string>& test) 
+  : outputDirectory(output), cacheDirectory(cache), trainingDirectories(training),
+    testDirectories(test) {
+}
+
+// run
+// Method used to run the sweep. The global parameters are set for each point
+// of the grid, as filters and the ROI function read them, and are restored
+// once the sweep is done
+
+void FilterSweep::run(ostream& table) {
+  int roiWidth = Globals::roiWidth;
+  int roiHeight = Globals::roiHeight;
+  double windowXScale = Globals::windowXScale;
+  double windowYScale = Globals::windowYScale;
+
+  vector<CvSize> sizes = roiSizes;
+  if (sizes.empty())
+    sizes.push_back(cvSize(roiWidth, roiHeight));
+  vector<pair<double, double> > scales = windowScales;
+  if (scales.empty())
+    scales.push_back(make_pair(windowXScale, windowYScale));
+  vector<int> widths = gaussianWidths;
+  if (widths.empty())
+    widths.push_back(Globals::gaussianWidth);
+
+  Annotations::Tag tags[] = { Annotations::LeftEye, Annotations::RightEye,
+			      Annotations::Nose };
+
+  table << "roiWidth roiHeight windowXScale windowYScale gaussianWidth filter " <<
+    "frames oneNorm twoNorm MSE" << endl;
+
+  ROICache* trainingCache = 0;
+  ROICache* testCache = 0;
+  vector<Filter*> filters;
+  try {
+    for (unsigned int r = 0; r < sizes.size(); r++) {
+      Globals::roiWidth = sizes[r].width;
+      Globals::roiHeight = sizes[r].height;
+      trainingCache = ROICache::open(cacheDirectory, trainingDirectories, sizes[r],
+				     GazeTracker::roiFunction);
+      testCache = ROICache::open(cacheDirectory, testDirectories, sizes[r],
+				 GazeTracker::roiFunction);
+
+      CvPoint windowCenter = cvPoint(sizes[r].width / 2, sizes[r].height / 2);
+      for (unsigned int w = 0; w < scales.size(); w++) {
+	Globals::windowXScale = scales[w].first;
+	Globals::windowYScale = scales[w].second;
+
+	// the filters for all gaussian widths and LOIs
+	for (unsigned int g = 0; g < widths.size(); g++)
+	  for (int t = 0; t < 3; t++)
+	    filters.push_back(new Filter(outputDirectory, tags[t], sizes[r],
+					 widths[g], windowCenter));
+
+	vector<EvaluationResult> results;
+	train(trainingCache, filters);
+	evaluate(testCache, filters, results);
+
+	for (unsigned int f = 0; f < filters.size(); f++) {
+	  Annotations::Tag tag = filters[f]->getTag();
+	  table << sizes[r].width << " " << sizes[r].height << " " <<
+	    scales[w].first << " " << scales[w].second << " " <<
+	    widths[f / 3] << " " << Filter::filterName(tag) << " " <<
+	    results[f].getNFilterFrames(tag) << " " <<
+	    results[f].getOneNormError(tag) << " " <<
+	    results[f].getTwoNormError(tag) << " " << results[f].getMSE(tag) << endl;
+	}
+
+	for (unsigned int f = 0; f < filters.size(); f++)
+	  delete filters[f];
+	filters.clear();
+      }
+
+      delete trainingCache;
+      delete testCache;
+      trainingCache = testCache = 0;
+    }
+  } catch (string err) {
+    for (unsigned int f = 0; f < filters.size(); f++)
+      delete filters[f];
+    if (trainingCache)
+      delete trainingCache;
+    if (testCache)
+      delete testCache;
+    Globals::roiWidth = roiWidth;
+    Globals::roiHeight = roiHeight;
+    Globals::windowXScale = windowXScale;
+    Globals::windowYScale = windowYScale;
+    throw (err);
+  }
+
+  Globals::roiWidth = roiWidth;
+  Globals::roiHeight = roiHeight;
+  Globals::windowXScale = windowXScale;
+  Globals::windowYScale = windowYScale;
+}
+
+// preprocess
+// Method used to preprocess n frames of a cache, starting at a given frame,
+// in parallel. Each thread uses its own filter to preprocess frames. The
+// cache is mapped read only, and preprocessing equalizes grayscale images in
+// place, so each ROI is first copied into an image of the thread
+
+void FilterSweep::preprocess(ROICache* cache, long start, int n,
+			     vector<Filter*>& preprocessors, vector<Spectrum*>& spectra) {
+  CvSize size = cache->getSize();
+
+  #pragma omp parallel num_threads(preprocessors.size())
+  {
+    Filter* preprocessor = preprocessors[omp_get_thread_num()];
+    IplImage* header = cvCreateImageHeader(size, IPL_DEPTH_8U, 1);
+    IplImage* image = cvCreateImage(size, IPL_DEPTH_8U, 1);
+
+    #pragma omp for schedule(dynamic)
+    for (int i = 0; i < n; i++) {
+      cache->getROI(start + i, header);
+      cvCopy(header, image);
+      preprocessor->preprocessImage(image, spectra[i]->getData());
+    }
+
+    cvReleaseImage(&image);
+    cvReleaseImageHeader(&header);
+  }
+}
+
+// getTrainingFrames
+// Method used to select the frames of the training cache that filters are
+// trained on. As in Filter::addTrainingSet, the annotations of each training
+// directory are binned, and only the binned frames are used. Frames are in
+// the order in which Classifier::getFrames lists them, as in the cache
+
+void FilterSweep::getTrainingFrames(vector<bool>& selected) {
+  selected.clear();
+  for (unsigned int i = 0; i < trainingDirectories.size(); i++) {
+    Annotations annotations;
+    string locationsFileName = trainingDirectories[i] + "/" + Globals::annotationsFileName;
+    annotations.readAnnotations(locationsFileName);
+
+    // the frames before binning, in cache order
+    vector<FrameAnnotation*> frames = annotations.getFrameAnnotations();
+    map<FrameAnnotation*, int> indexes;
+    for (unsigned int j = 0; j < frames.size(); j++)
+      indexes[frames[j]] = j;
+
+    long base = selected.size();
+    selected.resize(base + frames.size(), false);
+
+    annotations.createBins();
+    vector<FrameAnnotation*>& binned = annotations.getFrameAnnotations();
+    for (unsigned int j = 0; j < binned.size(); j++)
+      selected[base + indexes[binned[j]]] = true;
+  }
+}
+
+// train
+// Method used to train the filters on the selected frames of a cache, as
+// createFilters would train them. Without affine training, frames are
+// preprocessed in parallel a block at a time, and the filters are then
+// updated with the spectra of the block in parallel, one thread per filter.
+// With affine training, the variants of each frame are generated for each
+// LOI, and are used to update the filters for that LOI
+
+void FilterSweep::train(ROICache* cache, vector<Filter*>& filters) {
+  int nThreads = omp_get_max_threads();
+  int blockSize = max(2 * nThreads, Globals::augmentBlockSize);
+
+  vector<bool> selected;
+  getTrainingFrames(selected);
+  if ((long)selected.size() != cache->getNFrames()) {
+    string err = "FilterSweep::train. The ROI cache does not match the annotations.";
+    throw (err);
+  }
+
+  vector<Filter*> preprocessors;
+  vector<Spectrum*> spectra;
+  for (int i = 0; i < nThreads; i++)
+    preprocessors.push_back(filters[0]->clone());
+  for (int i = 0; i < blockSize; i++)
+    spectra.push_back(new Spectrum(cache->getSize()));
+
+  long nFrames = cache->getNFrames();
+  if (Globals::affineTraining) {
+    AffineAugmenter augmenter(cache->getSize(), Globals::spectralTranslations, blockSize);
+    for (long frame = 0; frame < nFrames; frame++)
+      if (selected[frame])
+	addVariants(cache, frame, augmenter, filters, preprocessors, spectra);
+  } else {
+    for (long start = 0; start < nFrames; start += blockSize) {
+      int n = min((long)blockSize, nFrames - start);
+      preprocess(cache, start, n, preprocessors, spectra);
+
+      #pragma omp parallel for schedule(dynamic) num_threads(nThreads)
+      for (int f = 0; f < (int)filters.size(); f++) {
+	Annotations::Tag tag = filters[f]->getTag();
+	for (int i = 0; i < n; i++) {
+	  if (!selected[start + i] || !cache->isAnnotated(start + i, tag))
+	    continue;
+	  CvPoint location = cache->getLocation(start + i, tag);
+	  filters[f]->addSpectrum(spectra[i]->getData(), location);
+	}
+      }
+    }
+  }
+
+  #pragma omp parallel for num_threads(nThreads)
+  for (int f = 0; f < (int)filters.size(); f++)
+    filters[f]->create();
+
+  for (int i = 0; i < nThreads; i++)
+    delete preprocessors[i];
+  for (int i = 0; i < blockSize; i++)
+    delete spectra[i];
+}
+
+// addVariants
+// Method used to update the filters with the affine variants of a frame of a
+// cache. The cache only holds the ROI, so variants are generated from the ROI,
+// and are rotated about its center rather than about the center of the frame
+
+void FilterSweep::addVariants(ROICache* cache, long frame, AffineAugmenter& augmenter,
+			      vector<Filter*>& filters, vector<Filter*>& preprocessors,
+			      vector<Spectrum*>& spectra) {
+  Annotations::Tag tags[] = { Annotations::LeftEye, Annotations::RightEye,
+			      Annotations::Nose };
+  IplImage* header = cvCreateImageHeader(cache->getSize(), IPL_DEPTH_8U, 1);
+  cache->getROI(frame, header);
+  CvPoint origin = cvPoint(0, 0);
+
+  for (int t = 0; t < 3; t++) {
+    if (!cache->isAnnotated(frame, tags[t]))
+      continue;
+    CvPoint location = cache->getLocation(frame, tags[t]);
+    augmenter.setFrame(header, origin, location, true);
+
+    for (int n = augmenter.next(); n; n = augmenter.next()) {
+      #pragma omp parallel for schedule(dynamic) num_threads(preprocessors.size())
+      for (int i = 0; i < n; i++)
+	preprocessors[omp_get_thread_num()]->preprocessImage(augmenter.getImage(i),
+							     spectra[i]->getData());
+
+      #pragma omp parallel for schedule(dynamic) num_threads(preprocessors.size())
+      for (int f = 0; f < (int)filters.size(); f++) {
+	if (filters[f]->getTag() != tags[t])
+	  continue;
+	for (int i = 0; i < n; i++)
+	  filters[f]->addSpectrum(spectra[i]->getData(), augmenter.getLocation(i),
+				  augmenter.getWeight(i));
+      }
+    }
+  }
+
+  cvReleaseImageHeader(&header);
+}
+
+// evaluate
+// Method used to measure the localization errors of the filters on the
+// frames of a cache. Frames are preprocessed in parallel a block at a time,
+// and the filters are then applied to the spectra of the block in parallel,
+// one thread per filter. Peaks are refined to sub-pixels as by the location
+// extractors
+
+void FilterSweep::evaluate(ROICache* cache, vector<Filter*>& filters,
+			   vector<EvaluationResult>& results) {
+  int nThreads = omp_get_max_threads();
+  int blockSize = 2 * nThreads;
+
+  results.assign(filters.size(), EvaluationResult(Globals::numZones));
+
+  vector<Filter*> preprocessors;
+  vector<Spectrum*> spectra;
+  for (int i = 0; i < nThreads; i++)
+    preprocessors.push_back(filters[0]->clone());
+  for (int i = 0; i < blockSize; i++)
+    spectra.push_back(new Spectrum(cache->getSize()));
+
+  long nFrames = cache->getNFrames();
+  for (long start = 0; start < nFrames; start += blockSize) {
+    int n = min((long)blockSize, nFrames - start);
+    preprocess(cache, start, n, preprocessors, spectra);
+
+    #pragma omp parallel for schedule(dynamic) num_threads(nThreads)
+    for (int f = 0; f < (int)filters.size(); f++) {
+      Annotations::Tag tag = filters[f]->getTag();
+      for (int i = 0; i < n; i++) {
+	if (!cache->isAnnotated(start + i, tag))
+	  continue;
+	CvPoint location = cache->getLocation(start + i, tag);
+	CvPoint2D64f peak;
+	Location::refinePeak(filters[f]->correlate(spectra[i]->getData()), peak);
+	results[f].addFilterError(tag, peak.x - location.x, peak.y - location.y);
+      }
+    }
+  }
+
+  for (int i = 0; i < nThreads; i++)
+    delete preprocessors[i];
+  for (int i = 0; i < blockSize; i++)
+    delete spectra[i];
+}
@@ -0,0 +1,69 @@
+#ifndef __FILTERSWEEP_H
+#define __FILTERSWEEP_H
+
+// FilterSweep.h
+// This file contains the definition of class FilterSweep. A sweep trains and
+// evaluates the filters for a grid of filter parameters, the ROI size, the
+// scales of the window function and the width of the gaussian. Frames are
+// read from ROI caches, so they are decoded once for all sweeps with a given
+// ROI size. For each ROI size and window, each frame is preprocessed once,
+// and its spectrum is used to train, or evaluate, the filters for all the
+// gaussian widths at once. Filters are trained on the annotated frames of a
+// set of training directories, binned as by createFilters, and with affine
+// variants when Globals::affineTraining is set. Their localization errors
+// are measured on all the annotated frames of a set of test directories
+
+#include <string>
+#include <vector>
+#include <map>
+#include <iostream>
+
+#include "Globals.h"
+#include "Filter.h"
+#include "Spectrum.h"
+#include "ROICache.h"
+#include "EvaluationResult.h"
+
+using namespace std;
+
+class FilterSweep {
+ private:
+  string outputDirectory;         // the directory required by filters
+  string cacheDirectory;          // the directory of the ROI caches
+  vector<string> trainingDirectories;
+  vector<string> testDirectories;
+
+  // the parameter grid
+  vector<CvSize> roiSizes;
+  vector<pair<double, double> > windowScales;
+  vector<int> gaussianWidths;
+
+ public:
+  FilterSweep(string outputDirectory, string cacheDirectory,
+	      vector<string>& trainingDirectories, vector<string>& testDirectories);
+  ~FilterSweep() { }
+
+  // methods to add values to the grid. The current global value of a
+  // parameter is used when no values are added for it
+  void addROISize(CvSize size) { roiSizes.push_back(size); }
+  void addWindowScale(double x, double y) { windowScales.push_back(make_pair(x, y)); }
+  void addGaussianWidth(int width) { gaussianWidths.push_back(width); }
+
+  // method to run the sweep. One line is written to the table for each
+  // point of the grid and each LOI, with the number of test frames and the
+  // one norm, two norm and squared errors
+  void run(ostream& table);
+
+ private:
+  void getTrainingFrames(vector<bool>& selected);
+  void train(ROICache* cache, vector<Filter*>& filters);
+  void addVariants(ROICache* cache, long frame, AffineAugmenter& augmenter,
+		   vector<Filter*>& filters, vector<Filter*>& preprocessors,
+		   vector<Spectrum*>& spectra);
+  void evaluate(ROICache* cache, vector<Filter*>& filters,
+		vector<EvaluationResult>& results);
+  void preprocess(ROICache* cache, long start, int n, vector<Filter*>& preprocessors,
+		  vector<Spectrum*>& spectra);
+};
+
+#endif // __FILTERSWEEP_H
@@ -39,12 +39,6 @@ GazeTracker::GazeTracker(string outputDir, bool online) {
   char fullPath[PATH_MAX + 1];
   outputDirectory = realpath((const char*)outputDir.c_str(), fullPath);
 
-  char* path = getenv("SVM_PATH");
-  if (!path) {
-    string err = "GazeTracker::GazeTracker. The SVM_PATH environment variable is not set";
-    throw (err);
-  }
-  svmPath = path;
   classifier = 0;
 
   roiSize.width = Globals::roiWidth;
@@ -189,9 +183,11 @@ void GazeTracker::createFilters() {
 				  Globals::gaussianWidth /* gaussian spread */, 
 				  windowCenter, roiFunction);
 
-  //leftEyeFilter->setAffineTransforms();
-  //rightEyeFilter->setAffineTransforms();
-  //noseFilter->setAffineTransforms();
+  if (Globals::affineTraining) {
+    leftEyeFilter->setAffineTransforms();
+    rightEyeFilter->setAffineTransforms();
+    noseFilter->setAffineTransforms();
+  }
 
   for (unsigned int i = 0; i < frameSetDirectories.size(); i++) {
     cout << "Adding left eye annotations..." << endl;
@@ -233,6 +229,210 @@ void GazeTracker::createFilters() {
   delete noseFilter;
 }
 
+// getSetName
+// Method that returns the name of the checkpoints of a frame set. The name is
+// the path of the frame set directory, without leading and trailing slashes,
+// and with the remaining slashes replaced by underscores, so that frame sets
+// in directories with the same name do not share checkpoints
+
+string GazeTracker::getSetName(string directory) {
+  size_t start = directory.find_first_not_of('/');
+  size_t end = directory.find_last_not_of('/');
+  if (start == string::npos) {
+    string err = "GazeTracker::getSetName. Invalid frame set directory " + directory;
+    throw (err);
+  }
+  string setName = directory.substr(start, end - start + 1);
+  replace(setName.begin(), setName.end(), '/', '_');
+  return setName;
+}
+
+// createCheckpoints
+// Method used to train the filters on each frame set into checkpoints. Frame
+// sets are trained in parallel. The checkpoints of a frame set are named
+// after its path, as given by getSetName, followed by the filter name
+
+void GazeTracker::createCheckpoints(string checkpointDirectory) {
+  Annotations::Tag tags[] = { Annotations::LeftEye, Annotations::RightEye,
+			      Annotations::Nose };
+  int nSets = frameSetDirectories.size();
+  vector<string> errors(nSets);
+
+  // checkpoints of different frame sets must not overwrite each other
+  map<string, string> setNames;
+  for (int i = 0; i < nSets; i++) {
+    string setName = getSetName(frameSetDirectories[i]);
+    if (setNames.find(setName) != setNames.end()) {
+      string err = "GazeTracker::createCheckpoints. Frame sets " + setNames[setName] +
+	" and " + frameSetDirectories[i] + " have the same checkpoint name " + setName;
+      throw (err);
+    }
+    setNames[setName] = frameSetDirectories[i];
+  }
+
+  #pragma omp parallel for schedule(dynamic) num_threads(omp_get_max_threads())
+  for (int i = 0; i < nSets; i++) {
+    string directory = frameSetDirectories[i];
+    string setName = getSetName(directory);
+
+    for (int j = 0; j < 3 && errors[i] == ""; j++) {
+      Filter* filter = 0;
+      try {
+	filter = createFilter(tags[j], directory);
+	filter->saveCheckpoint(checkpointDirectory + "/" + setName + "." +
+			       Filter::filterName(tags[j]) + ".checkpoint");
+      } catch (string err) {
+	errors[i] = err;
+      }
+      if (filter)
+	delete filter;
+    }
+  }
+
+  // report the first error in frame set order
+  for (int i = 0; i < nSets; i++)
+    if (errors[i] != "")
+      throw (errors[i]);
+}
+
+// mergeCheckpoints
+// Method used to merge checkpoints into filters. Checkpoints are read one at
+// a time and merged into the filter for their LOI, so only one filter per LOI
+// is kept in memory. The filters are then created and saved
+
+void GazeTracker::mergeCheckpoints(vector<string>& checkpoints) {
+  map<Annotations::Tag, Filter*> filters;
+
+  try {
+    for (unsigned int i = 0; i < checkpoints.size(); i++) {
+      Filter* filter = Filter::loadCheckpoint(outputDirectory, checkpoints[i],
+					      roiFunction);
+      Annotations::Tag tag = filter->getTag();
+      if (filters.find(tag) == filters.end()) {
+	filters[tag] = filter;
+	continue;
+      }
+      try {
+	filters[tag]->merge(*filter);
+      } catch (string err) {
+	delete filter;
+	throw (err + " Checkpoint " + checkpoints[i]);
+      }
+      delete filter;
+    }
+  } catch (string err) {
+    for (map<Annotations::Tag, Filter*>::iterator it = filters.begin();
+	 it != filters.end(); it++)
+      delete it->second;
+    throw (err);
+  }
+
+  vector<Filter*> merged;
+  for (map<Annotations::Tag, Filter*>::iterator it = filters.begin();
+       it != filters.end(); it++) {
+    cout << "Merged " << Filter::filterName(it->first) << " from " <<
+      it->second->getNSamples() << " samples" << endl;
+    merged.push_back(it->second);
+  }
+
+  #pragma omp parallel for num_threads(omp_get_max_threads())
+  for (int i = 0; i < (int)merged.size(); i++) {
+    merged[i]->create();
+    merged[i]->save();
+  }
+
+  for (unsigned int i = 0; i < merged.size(); i++)
+    delete merged[i];
+}
+
+// crossValidateFilters
+// Method used to cross validate the filters, leaving out one frame set at a
+// time. MOSSE terms are sums over frames, so the terms of a filter that
+// leaves out a frame set are the terms for all frame sets less those for the
+// frame set. Frame sets are trained in parallel, once. Each derived filter is
+// then evaluated on the frame set it leaves out, with frames evaluated in
+// parallel
+
+vector<EvaluationResult> GazeTracker::crossValidateFilters() {
+  Annotations::Tag tags[] = { Annotations::LeftEye, Annotations::RightEye,
+			      Annotations::Nose };
+  int nSets = frameSetDirectories.size();
+  if (nSets < 2) {
+    string err = "GazeTracker::crossValidateFilters. At least two frame sets are needed.";
+    throw (err);
+  }
+
+  // the filters for each frame set, three per set
+  vector<Filter*> filters(nSets * 3, (Filter*)0);
+  vector<string> errors(nSets * 3);
+
+  #pragma omp parallel for schedule(dynamic) num_threads(omp_get_max_threads())
+  for (int i = 0; i < nSets * 3; i++) {
+    try {
+      filters[i] = createFilter(tags[i % 3], frameSetDirectories[i / 3]);
+    } catch (string err) {
+      errors[i] = err;
+    }
+  }
+
+  vector<EvaluationResult> results(nSets, EvaluationResult(Globals::numZones));
+  string error;
+  for (int i = 0; i < nSets * 3 && error == ""; i++)
+    error = errors[i];
+
+  for (int j = 0; j < 3 && error == ""; j++) {
+    // the terms for all frame sets
+    Filter* total = new Filter(*filters[j]);
+    for (int i = 1; i < nSets; i++)
+      total->merge(*filters[i * 3 + j]);
+
+    for (int i = 0; i < nSets && error == ""; i++) {
+      Filter* heldOut = new Filter(*total);
+      try {
+	heldOut->subtract(*filters[i * 3 + j]);
+	heldOut->create();
+
+	vector<string> directories(1, frameSetDirectories[i]);
+	EvaluationResult result =
+	  Classifier::evaluateFilter(heldOut, 0, directories, roiFunction);
+	results[i].merge(result);
+      } catch (string err) {
+	error = err;
+      }
+      delete heldOut;
+    }
+    delete total;
+  }
+
+  for (int i = 0; i < nSets * 3; i++)
+    if (filters[i])
+      delete filters[i];
+  if (error != "")
+    throw (error);
+
+  return results;
+}
+
+// createFilter
+// Method used to create a filter for a LOI and train it on a frame set
+
+Filter* GazeTracker::createFilter(Annotations::Tag tag, string directory) {
+  CvPoint windowCenter = getWindowCenter();
+  Filter* filter = new Filter(outputDirectory, tag, roiSize,
+			      Globals::gaussianWidth /* gaussian spread */,
+			      windowCenter, roiFunction);
+  if (Globals::affineTraining)
+    filter->setAffineTransforms();
+
+  try {
+    filter->addTrainingSet(directory);
+  } catch (string err) {
+    delete filter;
+    throw (err);
+  }
+  return filter;
+}
+
 // addTrainingSet
 // Method used to add directories with training data for SVM models. Each directory is 
 // expected to contain an annotations file with annotated LOIs
@@ -249,7 +449,7 @@ void GazeTracker::addTrainingSet(string directory) {
 // Method used to train the SVM classifier. The trainer expects to find an
 // annotations file in the output directory that contains all the annotations that
 // were applied during filter training. All these annotations are used to create
-// models using the SVM Light trainer
+// one SVM model per zone
 
 void GazeTracker::train() {
   if (!leftEyeExtractor) {
@@ -265,7 +465,7 @@ void GazeTracker::train() {
   
   Trainer trainer(outputDirectory, kernelType, 
 		  leftEyeExtractor, rightEyeExtractor, noseExtractor,
-		  roiFunction, svmPath);
+		  roiFunction);
 
   // add training sets
   for (unsigned int i = 0; i < trainingSetDirectories.size(); i++)
@@ -290,6 +490,23 @@ int GazeTracker::getZone(IplImage* image, double& confidence, FrameAnnotation& f
   return classifier->getZone(image, confidence, fa);
 }
 
+// getZones
+// Method used to get the gaze zones for a batch of images. This is meant for
+// offline processing of recorded frames, where throughput matters more than
+// the latency of a single frame
+
+void GazeTracker::getZones(vector<IplImage*>& images, vector<int>& zones,
+			   vector<double>& confidences, vector<FrameAnnotation>& annotations,
+			   bool smooth) {
+  if (!classifier)
+    createClassifier();
+
+  annotations.resize(images.size());
+  for (unsigned int i = 0; i < annotations.size(); i++)
+    annotations[i].setFace(faceCenter);
+  classifier->getZones(images, annotations, zones, confidences, smooth);
+}
+
 // getFilterAccuracy
 // Method used to compute the error for a filter identified by xml tag for the 
 // annotations in a given directory
@@ -312,6 +529,68 @@ pair<double, string> GazeTracker::getClassifierAccuracy(string trainingDirectory
   return classifier->getError(trainingDirectory);
 }
 
+// evaluate
+// Method used to evaluate the classifier on a shard of the annotated frames
+// in a set of directories
+
+EvaluationResult GazeTracker::evaluate(vector<string>& directories, int shard, int nShards) {
+  if (!classifier)
+    createClassifier();
+
+  return classifier->evaluate(directories, shard, nShards);
+}
+
+// evaluateFilter
+// Method used to evaluate the filter identified by xml tag on a shard of the
+// annotated frames in a set of directories
+
+EvaluationResult GazeTracker::evaluateFilter(vector<string>& directories,
+					     Annotations::Tag xmlTag,
+					     int shard, int nShards) {
+  if (!classifier)
+    createClassifier();
+
+  return classifier->evaluateFilter(directories, xmlTag, shard, nShards);
+}
+
+// getFilterUpdateMessage
+// Method that returns the number of updates made and skipped by each online
+// filter. The message is empty when the filters are not online filters
+
+string GazeTracker::getFilterUpdateMessage() {
+  string msg;
+  if (!isOnline || !leftEyeExtractor)
+    return msg;
+
+  Location* extractors[] = { leftEyeExtractor, rightEyeExtractor, noseExtractor };
+  for (int i = 0; i < 3; i++) {
+    OnlineFilter* filter = (OnlineFilter*)extractors[i]->getFilter();
+    msg += ((i)? " " : "") + filter->getUpdateMessage();
+  }
+  return msg;
+}
+
+// getTrackingMessage
+// Method that returns the number of frames in which each LOI was tracked in a
+// patch, found coarse to fine, and searched for in full
+
+string GazeTracker::getTrackingMessage() {
+  string msg;
+  if (!leftEyeExtractor)
+    return msg;
+
+  Location* extractors[] = { leftEyeExtractor, rightEyeExtractor, noseExtractor };
+  Annotations::Tag tags[] = { Annotations::LeftEye, Annotations::RightEye, Annotations::Nose };
+  for (int i = 0; i < 3; i++) {
+    char buffer[Globals::midBufferSize];
+    sprintf(buffer, "%s%s: tracked %ld, coarse %ld, searched %ld.", (i)? " " : "",
+	    Filter::filterName(tags[i]).c_str(), extractors[i]->getNTracked(),
+	    extractors[i]->getNCoarse(), extractors[i]->getNSearched());
+    msg += buffer;
+  }
+  return msg;
+}
+
 // createClassifier
 // Method used to create a classifier object
 
@@ -350,6 +629,19 @@ void GazeTracker::createClassifier() {
       noseExtractor = new Location(outputDirectory, Annotations::Nose,
 				   windowCenter);
     }
+
+    // in tracking mode, LOIs are looked for in small patches around their
+    // last locations once they have been found
+    if (Globals::trackLOIs) {
+      leftEyeExtractor->setTracking(true);
+      rightEyeExtractor->setTracking(true);
+      noseExtractor->setTracking(true);
+    }
+
+    // in pyramid mode, LOIs are looked for coarse to fine
+    leftEyeExtractor->setPyramid(Globals::eyePyramidFactor);
+    rightEyeExtractor->setPyramid(Globals::eyePyramidFactor);
+    noseExtractor->setPyramid(Globals::nosePyramidFactor);
   }
 
   // now create the classifier
@@ -43,6 +43,19 @@ class GazeTracker {
   void addFrameSet(string directory);
   void createFilters();
 
+  // create filters in steps. Each frame set is trained into its own
+  // accumulator checkpoints, one per filter, in the checkpoint directory.
+  // Checkpoints, possibly created by other processes or machines, are then
+  // merged into filters, which are saved in the output directory
+  void createCheckpoints(string checkpointDirectory);
+  void mergeCheckpoints(vector<string>& checkpoints);
+
+  // leave one out cross validation of the filters over the frame sets. The
+  // filters are trained once on each frame set. The filters that leave out
+  // a frame set are derived from the filters for all frame sets and are
+  // evaluated on that frame set. The results are in frame set order
+  vector<EvaluationResult> crossValidateFilters();
+
   // train models for SVM
   void addTrainingSet(string directory);
   void train();
@@ -50,12 +63,31 @@ class GazeTracker {
   // get the gaze zone given an image
   int getZone(IplImage* image, double& confidence, FrameAnnotation& fa);
 
+  // get the gaze zones for a batch of images. LOIs are smoothed over past
+  // frames only when smooth is set
+  void getZones(vector<IplImage*>& images, vector<int>& zones,
+		vector<double>& confidences, vector<FrameAnnotation>& annotations,
+		bool smooth = false);
+
   // get error for a given filter used by the gaze tracker
   double getFilterAccuracy(string trainingDirectory, Annotations::Tag xmlTag,
 			   Classifier::ErrorType errorType);
   // get classification error
   pair<double, string> getClassifierAccuracy(string trainingDirectory);
 
+  // evaluate the classifier, or the filter for a LOI, on a shard of the
+  // annotated frames in a set of directories
+  EvaluationResult evaluate(vector<string>& directories, int shard = 0, int nShards = 1);
+  EvaluationResult evaluateFilter(vector<string>& directories, Annotations::Tag xmlTag,
+				  int shard = 0, int nShards = 1);
+
+  // get the number of updates made and skipped by each online filter
+  string getFilterUpdateMessage();
+
+  // get the number of frames in which each LOI was tracked, found coarse to
+  // fine and searched for in full
+  string getTrackingMessage();
+
   // show annotations
   void showAnnotations();
 
@@ -67,7 +99,6 @@ class GazeTracker {
 
  private:
   bool isOnline;                           // true when using online filters
-  string svmPath;
 
   // the center of the face for classification
   CvPoint faceCenter;
@@ -89,6 +120,12 @@ class GazeTracker {
   // create a classifier
   void createClassifier();
 
+  // create a filter for a LOI trained on a frame set
+  Filter* createFilter(Annotations::Tag tag, string directory);
+
+  // get the name of the checkpoints of a frame set
+  static string getSetName(string directory);
+
   // window center functions
   CvPoint getWindowCenter();
   CvPoint computeWindowCenter(string trainingDirectory = "");
@@ -13,8 +13,23 @@ int Globals::maxArea = 200;
 int Globals::binWidth = 10;
 int Globals::gaussianWidth = 21;
 int Globals::psrWidth = 30;
+int Globals::psrExclusion = 5;
+bool Globals::trackLOIs = false;
+int Globals::trackingPatchWidth = 64;
+int Globals::trackingPatchHeight = 64;
+double Globals::trackingMinPSR = 6.0;
+int Globals::eyePyramidFactor = 1;
+int Globals::nosePyramidFactor = 1;
+double Globals::filterBandEnergy = 1.0;
 int Globals::nPastLocations = 5;
+bool Globals::affineTraining = false;
+int Globals::augmentBlockSize = 16;
+bool Globals::spectralTranslations = false;
+bool Globals::pairedTransforms = true;
+bool Globals::subPixelPeaks = true;
 int Globals::noseDrop = 70;
+int Globals::maxPrimalTerms = 4096;
+int Globals::svmCacheSize = 40;
 
 int Globals::smallBufferSize = 32;
 int Globals::midBufferSize = 256;
@@ -23,11 +38,16 @@ int Globals::largeBufferSize = 1024;
 unsigned Globals::numZones = 5;
 
 double Globals::learningRate = 0.125;
+int Globals::onlineUpdateInterval = 1;
+double Globals::onlineMinPSR = 0;
+bool Globals::onlineUpdateOnZoneChange = false;
 double Globals::initialGaussianScale = 0.5;
+double Globals::svmEpsilon = 0.001;
 double Globals::windowXScale = 30;
 double Globals::windowYScale = 25;
 
 string Globals::annotationsFileName = "annotations.xml";
+bool Globals::annotationIndexes = true;
 string Globals::modelNamePrefix = "zone_";
 string Globals::faceFilter = "MOSSE_Face";
 string Globals::leftEyeFilter = "MOSSE_LeftEye";
@@ -35,4 +55,5 @@ string Globals::rightEyeFilter = "MOSSE_RightEye";
 string Globals::noseFilter = "MOSSE_Nose";
 
 string Globals::paramsFileName = "parameters.xml";
+string Globals::featuresFileName = "features.bin";
 string Globals::configFileName = "config.xml";
@@ -15,6 +15,12 @@
 // The OMP stuff
 #include <omp.h>
 
+// debug builds are compiled without openmp
+#ifdef SINGLETHREADED
+#define omp_get_max_threads() 1
+#define omp_get_thread_num() 0
+#endif
+
 // fftw3 stuff
 #include <fftw3.h>
 
@@ -35,8 +41,44 @@ class Globals {
   static int binWidth;                    // the bin width for binning annotations
   static int gaussianWidth;               // width of the gaussian
   static int psrWidth;                    // width of window to compute PSR
+  static int psrExclusion;                // half width of the peak left out of the PSR
+
+  // tracking mode. Once a LOI has been found, it is looked for in a patch of
+  // the given size around its last location, as long as the PSR of the patch
+  // response is at least trackingMinPSR
+  static bool trackLOIs;                  // set to use tracking mode
+  static int trackingPatchWidth;          // the width of the tracking patch
+  static int trackingPatchHeight;         // the height of the tracking patch
+  static double trackingMinPSR;           // the smallest PSR to keep tracking
+
+  // pyramid mode. LOIs are first looked for in images downsampled by the
+  // given factor, and the location is refined using a patch of the image of
+  // the tracking patch size. A factor of 1 turns pyramid mode off
+  static int eyePyramidFactor;            // the downsampling factor for the eyes
+  static int nosePyramidFactor;           // the downsampling factor for the nose
+
+  // band limited filters. Filters are saved band limited to the low
+  // frequencies that hold the given fraction of their energy. A fraction of 1
+  // saves full filters. Location extractors with band limited filters look for
+  // LOIs in decimated responses first, and refine them as in pyramid mode
+  static double filterBandEnergy;         // the fraction of the energy to keep
   static int nPastLocations;              // number of past locations for smoothing
+
+  // training with affine transforms. Filters are trained on small rotations
+  // and translations of each frame, generated a block at a time. Spectral
+  // translations replace the translations by weights on the rotations, which
+  // approximates them (see AffineAugmenter.h)
+  static bool affineTraining;             // set to train on affine transforms
+  static int augmentBlockSize;            // the number of variants per block
+  static bool spectralTranslations;       // set to weight rotations by their shifts
+
+  // set to apply the two eye filters using a single complex inverse transform
+  // of the face ROI spectrum, instead of one real inverse transform each
+  static bool pairedTransforms;
+  static bool subPixelPeaks;              // set to locate LOIs to sub-pixels
   static int noseDrop;                    // approx. drop below the eyes for the nose
+  static int maxPrimalTerms;              // max monomials when expanding SVM models
+  static int svmCacheSize;                // kernel cache size in MB per SVM trainer
 
   static int smallBufferSize;             // small stack buffer size
   static int midBufferSize;               // mid stack buffer size
@@ -45,7 +87,16 @@ class Globals {
   static unsigned numZones;               // number of zones
 
   static double learningRate;             // the learning rate for online filters
+
+  // the update policy for online filters. An online filter is updated once
+  // every onlineUpdateInterval frames, only when the PSR of its response is
+  // at least onlineMinPSR, and, if onlineUpdateOnZoneChange is set, only when
+  // the zone has changed since the last update
+  static int onlineUpdateInterval;
+  static double onlineMinPSR;
+  static bool onlineUpdateOnZoneChange;
   static double initialGaussianScale;     // the gaussian scale for the face filter
+  static double svmEpsilon;               // the KKT tolerance for SVM training
 
   // the window function is computed as image width times the x scale and
   // the image height times the y scale
@@ -53,12 +104,14 @@ class Globals {
   static double windowYScale;             // the Y scale factor for the window function
 
   static string annotationsFileName;      // the name of the annotations file
+  static bool annotationIndexes;          // set to cache annotations in indexes
   static string modelNamePrefix;          // prefix for SVM model names
   static string faceFilter;               // name of the face filter
   static string leftEyeFilter;            // name of left eye filter
   static string rightEyeFilter;           // name of right eye filter
   static string noseFilter;               // name of nose filter
   static string paramsFileName;           // name of parameters file
+  static string featuresFileName;         // name of the training features file
   static string configFileName;           // name of the config file
 };
 
@@ -15,7 +15,7 @@
 Location::Location(string outputDirName, Annotations::Tag tag,
 		   CvPoint& windowCenter) : xmlTag(tag) {
   inputImg = 0;
-  postFilterImg = 0;
+  hasResponse = false;
   imageFFT = 0;
 
   filter = new Filter(outputDirName, tag, windowCenter);
@@ -26,27 +26,68 @@ Location::Location(string outputDirName, Annotations::Tag tag,
 
   // initialize past locations
   for (int i = 0; i < Globals::nPastLocations; i++) {
-    CvPoint* point = new CvPoint;
+    CvPoint2D64f* point = new CvPoint2D64f;
     point->x = point->y = -1;
     pastLocations.push_back(point);
   }
   pastLocationIndex = 0;
+
+  tracking = locked = false;
+  pyramidFactor = 1;
+  patchFilter = coarseFilter = 0;
+  patchImg = coarseImg = 0;
+  nTracked = nCoarse = nSearched = 0;
 }
 
 Location::Location(Filter* f) {
   inputImg = 0;
-  postFilterImg = 0;
+  hasResponse = false;
   imageFFT = 0;
   xmlTag = Annotations::Ignore;
 
   filter = f;
 
   for (int i = 0; i < Globals::nPastLocations; i++) {
-    CvPoint* point = new CvPoint;
+    CvPoint2D64f* point = new CvPoint2D64f;
     point->x = point->y = -1;
     pastLocations.push_back(point);
   }
   pastLocationIndex = 0;
+
+  tracking = locked = false;
+  pyramidFactor = 1;
+  patchFilter = coarseFilter = 0;
+  patchImg = coarseImg = 0;
+  nTracked = nCoarse = nSearched = 0;
+}
+
+// The copy has its own copy of the filter, so that the two can be applied
+// concurrently, and starts out with the same past locations
+
+Location::Location(const Location& other) 
+  : LocationBase(), xmlTag(other.xmlTag), imgSize(other.imgSize) {
+  inputImg = 0;
+  hasResponse = false;
+  imageFFT = 0;
+
+  filter = (other.filter)? other.filter->clone() : 0;
+
+  for (int i = 0; i < Globals::nPastLocations; i++) {
+    CvPoint2D64f* point = new CvPoint2D64f;
+    point->x = other.pastLocations[i]->x;
+    point->y = other.pastLocations[i]->y;
+    pastLocations.push_back(point);
+  }
+  pastLocationIndex = other.pastLocationIndex;
+
+  tracking = other.tracking;
+  locked = other.locked;
+  trackedLocation = other.trackedLocation;
+  pyramidFactor = other.pyramidFactor;
+  patchFilter = (other.patchFilter)? other.patchFilter->clone() : 0;
+  coarseFilter = (other.coarseFilter)? other.coarseFilter->clone() : 0;
+  patchImg = coarseImg = 0;
+  nTracked = nCoarse = nSearched = 0;
 }
 
 Location::~Location() {
@@ -54,6 +95,204 @@ Location::~Location() {
     delete filter;
   for (int i = 0; i < Globals::nPastLocations; i++)
     delete pastLocations[i];
+  if (patchFilter)
+    delete patchFilter;
+  if (coarseFilter)
+    delete coarseFilter;
+  if (patchImg)
+    cvReleaseImage(&patchImg);
+  if (coarseImg)
+    cvReleaseImage(&coarseImg);
+}
+
+// setTracking
+// Method used to turn tracking mode on or off
+
+void Location::setTracking(bool on) {
+  tracking = on;
+  locked = false;
+  createPatchFilters();
+}
+
+// setPyramid
+// Method used to set the factor by which images are downsampled for the coarse
+// search. A factor of 1 turns the coarse search off
+
+void Location::setPyramid(int factor) {
+  pyramidFactor = (factor > 1)? factor : 1;
+  createPatchFilters();
+}
+
+// createPatchFilters
+// Method used to derive the patch filter used for tracking and for refining
+// coarse locations, and the coarse filter, from the filter
+
+void Location::createPatchFilters() {
+  if (patchFilter) {
+    delete patchFilter;
+    patchFilter = 0;
+  }
+  if (coarseFilter) {
+    delete coarseFilter;
+    coarseFilter = 0;
+  }
+  if (!filter)
+    return;
+
+  CvSize filterSize = filter->getSize();
+  if (tracking || pyramidFactor > 1 || filter->isBandLimited()) {
+    CvSize size = cvSize(Globals::trackingPatchWidth, Globals::trackingPatchHeight);
+    if (size.width < filterSize.width && size.height < filterSize.height)
+      patchFilter = filter->createPatchFilter(size);
+  }
+  if (pyramidFactor > 1 && patchFilter)
+    coarseFilter = filter->createCoarseFilter(pyramidFactor);
+}
+
+// findInPatch
+// Method used to find the LOI in a patch of the image centered at a given
+// point. The peak and the point are in image coordinates. Returns the PSR of
+// the patch response, or -1 if the image is smaller than a patch
+
+double Location::findInPatch(IplImage* image, CvPoint& center, CvPoint2D64f& peak) {
+  CvSize patchSize = patchFilter->getSize();
+  CvSize size = cvGetSize(image);
+  if (patchSize.width > size.width || patchSize.height > size.height)
+    return -1;
+
+  // center the patch on the point and keep it inside the image
+  CvPoint origin;
+  origin.x = center.x - patchSize.width / 2;
+  origin.y = center.y - patchSize.height / 2;
+  origin.x = min(max(origin.x, 0), size.width - patchSize.width);
+  origin.y = min(max(origin.y, 0), size.height - patchSize.height);
+
+  if (patchImg && patchImg->nChannels != image->nChannels)
+    cvReleaseImage(&patchImg);
+  if (!patchImg)
+    patchImg = cvCreateImage(patchSize, image->depth, image->nChannels);
+  cvSetImageROI(image, cvRect(origin.x, origin.y, patchSize.width, patchSize.height));
+  cvCopy(image, patchImg);
+  cvResetImageROI(image);
+
+  // apply the patch filter
+  fftw_complex* fft = patchFilter->preprocessImage(patchImg);
+  stats = patchFilter->correlate(fft);
+  hasResponse = true;
+
+  refinePeak(peak);
+  double psr = stats.psr;
+
+  peak.x += origin.x;
+  peak.y += origin.y;
+  return psr;
+}
+
+// track
+// Method used to look for the LOI in a patch of the image centered at the
+// last location of the LOI. The location is smoothed over past locations as
+// in getMaxLocation. When the PSR of the patch response falls below the
+// tracking threshold, we unlock and let the caller search the whole image
+
+bool Location::track(IplImage* image, CvPoint& offset, CvPoint2D64f& location,
+		     double& psr) {
+  if (!tracking || !locked || !patchFilter)
+    return false;
+
+  CvPoint center;
+  center.x = cvRound(trackedLocation.x) - offset.x;
+  center.y = cvRound(trackedLocation.y) - offset.y;
+
+  CvPoint2D64f peak;
+  psr = findInPatch(image, center, peak);
+  if (psr < Globals::trackingMinPSR) {
+    locked = false;
+    return false;
+  }
+
+  smoothLocation(peak, location);
+  location.x += offset.x;
+  location.y += offset.y;
+
+  trackedLocation = location;
+  nTracked++;
+  return true;
+}
+
+// search
+// Method used to search for the LOI coarse to fine. We find the peak of the
+// coarse filter response to the downsampled image, or of the decimated
+// response of a band limited filter to the image, and refine it using the
+// patch filter on a full resolution patch around the peak. When the PSR of
+// the patch response is below the tracking threshold, we let the caller
+// search the whole image at full resolution
+
+bool Location::search(IplImage* image, CvPoint& offset, CvPoint2D64f& location,
+		      double& psr, bool smooth, fftw_complex* spectrum) {
+  if (!patchFilter || (!coarseFilter && !filter->isBandLimited()))
+    return false;
+
+  // the coarse peak, and its center at full resolution
+  CvPoint2D64f peak;
+  CvPoint center;
+  if (coarseFilter) {
+    CvSize coarseSize = coarseFilter->getSize();
+    if (coarseImg && coarseImg->nChannels != image->nChannels)
+      cvReleaseImage(&coarseImg);
+    if (!coarseImg)
+      coarseImg = cvCreateImage(coarseSize, image->depth, image->nChannels);
+    cvResize(image, coarseImg, CV_INTER_AREA);
+
+    // coarse detection
+    fftw_complex* fft = coarseFilter->preprocessImage(coarseImg);
+    stats = coarseFilter->correlate(fft);
+    hasResponse = true;
+
+    getPeakLocation(peak);
+    center.x = cvRound(peak.x * pyramidFactor + (pyramidFactor - 1) / 2.0);
+    center.y = cvRound(peak.y * pyramidFactor + (pyramidFactor - 1) / 2.0);
+  } else {
+    // detection in the decimated response
+    fftw_complex* fft = (spectrum)? spectrum : filter->preprocessImage(image);
+    Filter::computeStats(filter->applyBand(fft), stats);
+    hasResponse = true;
+
+    CvSize size = filter->getSize();
+    CvSize bandSize = filter->getBandSize();
+    getPeakLocation(peak);
+    center.x = cvRound((peak.x + 0.5) * size.width / bandSize.width - 0.5);
+    center.y = cvRound((peak.y + 0.5) * size.height / bandSize.height - 0.5);
+  }
+
+  // refinement at full resolution
+  psr = findInPatch(image, center, peak);
+  if (psr < Globals::trackingMinPSR)
+    return false;
+
+  if (smooth)
+    smoothLocation(peak, location);
+  else
+    location = peak;
+  location.x += offset.x;
+  location.y += offset.y;
+
+  if (tracking) {
+    trackedLocation = location;
+    locked = true;
+  }
+  nCoarse++;
+  return true;
+}
+
+// lock
+// Method used to lock on to a location found by searching a whole image
+
+void Location::lock(CvPoint2D64f& location) {
+  nSearched++;
+  if (!tracking)
+    return;
+  trackedLocation = location;
+  locked = true;
 }
 
 // setImage
@@ -67,7 +306,7 @@ void Location::setImage(IplImage* image) {
   }
 
   inputImg = image;
-  postFilterImg = 0;
+  hasResponse = false;
 
   // check sizes
   imgSize = cvGetSize(image);
@@ -93,8 +332,8 @@ void Location::setImage(fftw_complex* image) {
 
 // apply
 // Method that applies a pre-loaded filter to an image. The method stores the
-// result in the postFilterImg field. Subsequent to a call to apply, the various
-// get methods can be used to extract LOIs
+// statistics of the response. Subsequent to a call to apply, the various get
+// methods can be used to extract LOIs
 
 bool Location::apply() {
   if (!filter) {
@@ -120,38 +359,84 @@ bool Location::apply() {
     }
 
     imageFFT = filter->preprocessImage(image);
-    postFilterImg = filter->apply(imageFFT);
+    stats = filter->correlate(imageFFT);
+    hasResponse = true;
     imageFFT = 0;
     /*
     string str = "__postfilter_";
     str += Filter::filterName(xmlTag);
-    Filter::showImage((const char*)str.c_str(), postFilterImg);
+    Filter::showImage((const char*)str.c_str(), filter->getResponse());
     */
     if (releaseImage)
       cvReleaseImage(&image);
-
-    if (postFilterImg)
-      return true;
   } else {
-    postFilterImg = filter->apply(imageFFT);
+    stats = filter->correlate(imageFFT);
+    hasResponse = true;
     imageFFT = 0;
     /*
     string str = "__postfilter_";
     str += Filter::filterName(xmlTag);
-    Filter::showImage((const char*)str.c_str(), postFilterImg);
+    Filter::showImage((const char*)str.c_str(), filter->getResponse());
     */
-    if (postFilterImg)
-      return true;
   }
-  return false;
+  return true;
+}
+
+// applyPair
+// Method used to apply the filters of two extractors to the same preprocessed
+// image. Both filters are applied using a single complex inverse transform,
+// whose real and imaginary parts are the two responses
+
+bool Location::applyPair(Location* one, Location* two, fftw_complex* image) {
+  if (!image) {
+    string err = "Location::applyPair. image parameter is NULL.";
+    throw (err);
+  }
+
+  Filter* first = one->filter;
+  Filter* second = two->filter;
+  if (!Globals::pairedTransforms || !first || !second ||
+      first->isOnline() || second->isOnline())
+    return false;
+  CvSize size = first->getSize();
+  if (size.width != second->getSize().width || size.height != second->getSize().height)
+    return false;
+
+  Filter::correlatePair(first, second, image);
+  one->stats = first->getStats();
+  two->stats = second->getStats();
+  one->hasResponse = two->hasResponse = true;
+  one->imageFFT = two->imageFFT = 0;
+  return true;
 }
 
 // getPreprocessedImage
 // Method used to get a preprocessed image, given an IplImage. This method is
 // used to do one time preprocessing and multiple time applications of a given
-// image frame
+// image frame. The image is transformed straight into a new buffer, which the
+// caller is expected to free using fftw_free
 
 fftw_complex* Location::getPreprocessedImage(IplImage* inputImg) {
+  CvSize size = cvGetSize(inputImg);
+  int nElements = size.height * ((size.width / 2) + 1);
+  fftw_complex* buffer = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * nElements);
+
+  return preprocess(inputImg, buffer);
+}
+
+// getPreprocessedImage
+// Method used to preprocess an image into a spectrum, which is re-used from
+// frame to frame. The preprocessed image is valid as long as the spectrum
+
+fftw_complex* Location::getPreprocessedImage(IplImage* inputImg, Spectrum& spectrum) {
+  spectrum.resize(cvGetSize(inputImg));
+  return preprocess(inputImg, spectrum.getData());
+}
+
+// preprocess
+// Method used to preprocess an image and transform it into a given buffer
+
+fftw_complex* Location::preprocess(IplImage* inputImg, fftw_complex* buffer) {
   IplImage* image = inputImg;
 
   // get input image size. This function may get called without calling
@@ -167,12 +452,7 @@ fftw_complex* Location::getPreprocessedImage(IplImage* inputImg) {
   }
 
   // preprocess the input image
-  imageFFT = filter->preprocessImage(image);
-
-  // copy it into a buffer
-  int nElements = imgSize.height * ((imgSize.width / 2) + 1);
-  fftw_complex* buffer = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * nElements);
-  memcpy(buffer, imageFFT, (sizeof(fftw_complex) * nElements));
+  filter->preprocessImage(image, buffer);
 
   if (releaseImage)
     cvReleaseImage(&image);
@@ -181,51 +461,36 @@ fftw_complex* Location::getPreprocessedImage(IplImage* inputImg) {
 }
 
 // getMinValue
-// Method used to get the minimum element in a real image array
+// Method used to get the minimum element of the response scaled by its max
 
 double Location::getMinValue() {
-  if (!postFilterImg) {
+  if (!hasResponse) {
     string err = "Location::getMinValue. Invalid image";
     throw (err);
   }
-  double min;
-  double max;
-
-  cvMinMaxLoc(postFilterImg, &min, &max, NULL, NULL);
-  return min;
+  return stats.min / stats.max;
 }
 
 // getMaxValue
-// Method used to get the maximum element in a real image array
+// Method used to get the maximum element of the response scaled by its max
 
 double Location::getMaxValue() {
-  if (!postFilterImg) {
+  if (!hasResponse) {
     string err = "Location::getMaxValue. Invalid image";
     throw (err);
   }
-  double min;
-  double max;
-
-  cvMinMaxLoc(postFilterImg, &min, &max, NULL, NULL);
-  return max;
+  return 1.0;
 }
 
 // getMinLocation
 // Method used to get the location of the min element as a point in the 2d space
 
 void Location::getMinLocation(CvPoint& location, double& psr) {
-  if (!postFilterImg) {
+  if (!hasResponse) {
     string err = "Location::getMinLocation. Invalid image";
     throw (err);
   }
-  double min;
-  double max;
-  CvPoint minLoc;
-  CvPoint maxLoc;
-  
-  cvMinMaxLoc(postFilterImg, &min, &max, &minLoc, &maxLoc);
-  location.x = minLoc.x;
-  location.y = minLoc.y;
+  location = stats.minLoc;
 
   // no PSR for min locations
   psr = 0.0;
@@ -235,21 +500,90 @@ void Location::getMinLocation(CvPoint& location, double& psr) {
 // Method used to get the location of the max element as a point in the 2d space
 
 void Location::getMaxLocation(CvPoint& location, double& psr) {
-  if (!postFilterImg) {
-    string err = "Location::getMaxLocation. Invalid image";
-    throw (err);
-  }
-  double min;
-  double max;
-  CvPoint minLoc;
-  CvPoint maxLoc;
-  
-  cvMinMaxLoc(postFilterImg, &min, &max, &minLoc, &maxLoc);
+  CvPoint2D64f maxLoc;
+  getMaxLocation(maxLoc, psr);
+  location.x = cvRound(maxLoc.x);
+  location.y = cvRound(maxLoc.y);
+}
+
+// getMaxLocation
+// Method used to get the sub-pixel location of the max element
+
+void Location::getMaxLocation(CvPoint2D64f& location, double& psr) {
+  CvPoint2D64f peak;
+  getPeakLocation(peak);
 
   // apply smoothing by averaging the currently computed location and 
   // several past locations
-  int xSum = maxLoc.x;
-  int ySum = maxLoc.y;
+  smoothLocation(peak, location);
+
+  psr = stats.psr;
+}
+
+// getPeakLocation
+// Method used to get the location of the max element without smoothing. The
+// method returns the max value of the response scaled by its max
+
+double Location::getPeakLocation(CvPoint& location) {
+  if (!hasResponse) {
+    string err = "Location::getPeakLocation. Invalid image";
+    throw (err);
+  }
+  location = stats.maxLoc;
+  return 1.0;
+}
+
+double Location::getPeakLocation(CvPoint2D64f& location) {
+  if (!hasResponse) {
+    string err = "Location::getPeakLocation. Invalid image";
+    throw (err);
+  }
+  refinePeak(location);
+  return 1.0;
+}
+
+// refinePeak
+// Method used to refine the location of the max element of the filter response
+// to a sub-pixel location
+
+void Location::refinePeak(CvPoint2D64f& location) {
+  refinePeak(stats, location);
+}
+
+// refinePeak
+// Method used to refine the location of the max element of a filter response
+// to a sub-pixel location, given the statistics of the response. We fit a
+// parabola to the max element and its two neighbours along each axis, and
+// take the vertex of the parabola
+
+void Location::refinePeak(const ResponseStats& stats, CvPoint2D64f& location) {
+  location.x = stats.maxLoc.x;
+  location.y = stats.maxLoc.y;
+  if (!Globals::subPixelPeaks)
+    return;
+
+  double center = stats.max;
+  double left = stats.neighbours[0];
+  double right = stats.neighbours[1];
+  double curvature = left - 2 * center + right;
+  if (curvature < 0)
+    location.x += 0.5 * (left - right) / curvature;
+
+  double up = stats.neighbours[2];
+  double down = stats.neighbours[3];
+  curvature = up - 2 * center + down;
+  if (curvature < 0)
+    location.y += 0.5 * (up - down) / curvature;
+}
+
+// smoothLocation
+// Method used to smooth a location by averaging it with the past locations. The
+// location is then pushed into the array of past locations. Locations have to
+// be smoothed in frame order
+
+void Location::smoothLocation(CvPoint2D64f& location, CvPoint2D64f& smoothed) {
+  double xSum = location.x;
+  double ySum = location.y;
   int nTerms = 1;
 
   for (int i = 0; i < Globals::nPastLocations; i++)
@@ -259,75 +593,40 @@ void Location::getMaxLocation(CvPoint& location, double& psr) {
       nTerms++;
     }
 
-  location.x = xSum / nTerms;
-  location.y = ySum / nTerms;
+  smoothed.x = xSum / nTerms;
+  smoothed.y = ySum / nTerms;
 
   // now push the latest location into the array of past locations
-  pastLocations[pastLocationIndex]->x = maxLoc.x;
-  pastLocations[pastLocationIndex]->y = maxLoc.y;
+  pastLocations[pastLocationIndex]->x = location.x;
+  pastLocations[pastLocationIndex]->y = location.y;
   pastLocationIndex = (pastLocationIndex + 1) % Globals::nPastLocations;
-
-  psr = computePSR(max, maxLoc);
 }
 
-// computePSR
-// Method that computes the PSR given a location
-
-double Location::computePSR(double max, CvPoint& location) {
-  if (!postFilterImg)
-    return 0;
-
-  int halfWidth = Globals::psrWidth / 2;
-  if (location.x - halfWidth < 0)
-    halfWidth += location.x - halfWidth;
-  if (location.y - halfWidth < 0)
-    halfWidth += location.y - halfWidth;
-  if (halfWidth < 0)
-    return 0;
-
-  int psrWidth = halfWidth * 2;
-
-  int x = location.x - halfWidth;
-  int y = location.y - halfWidth;
-
-  CvRect rect;
-  rect.x = x; rect.y = y;
-  rect.height = rect.width = psrWidth;
-  cvSetImageROI(postFilterImg, rect);
-
-  // now compute the average of the pixels inside the ROI
-  CvScalar mean = cvAvg(postFilterImg, NULL);
-  cvResetImageROI(postFilterImg);
-
-  // if the mean is negative, then simply return 0
-  if (mean.val[0] < 0)
-    return 0;
-
-  // compute sd by first computing the average boundary pixel value
-  // along two edges of the PSR frame and then compute sd using the
-  // average value
-  int count = 0;
-  double boundary = 0;
-  for (int i = y; i < y + psrWidth; i++) {
-    if (i < imgSize.height) {
-      CvScalar vec = cvGet2D(postFilterImg, i, x);
-      boundary += vec.val[0];
-      count++;
-    }
+// getMaxLocations
+// Method used to get the max locations for a batch of preprocessed images
+
+void Location::getMaxLocations(fftw_complex* spectra, int n,
+			       vector<CvPoint2D64f>& locations, vector<double>& psrs,
+			       bool smooth) {
+  if (!filter) {
+    string err = "Location::getMaxLocations. filter object is NULL.";
+    throw (err);
   }
-  for (int i = x; i < x + psrWidth; i++) {
-    if (i < imgSize.width) {
-      CvScalar vec = cvGet2D(postFilterImg, y, i);
-      boundary += vec.val[0];
-      count++;
-    }
+
+  filter->applyBatch(spectra, n, batchStats);
+
+  locations.resize(n);
+  psrs.resize(n);
+  for (int i = 0; i < n; i++) {
+    stats = batchStats[i];
+    hasResponse = true;
+
+    CvPoint2D64f peak;
+    refinePeak(peak);
+    if (smooth)
+      smoothLocation(peak, locations[i]);
+    else
+      locations[i] = peak;
+    psrs[i] = stats.psr;
   }
-  boundary /= count;
-    
-  double sd = max - boundary;
-
-  //  cout << "max = " << max << ", mean = " << mean.val[0] << ", boundary = " << boundary <<
-  //    ", sd = " << sd << endl;
-  
-  return (max - mean.val[0]) / sd;
 }
@@ -19,6 +19,7 @@
 #include "LocationBase.h"
 #include "Annotations.h"
 #include "Filter.h"
+#include "Spectrum.h"
 
 class Location : public LocationBase {
  protected:
@@ -28,16 +29,40 @@ class Location : public LocationBase {
   Filter* filter;           // an instance of a filter object
   fftw_complex* imageFFT;   // the preprocessed image data
 
-  // image data after applying the filter. This is the image data that we
-  // compute after a call to the method apply
-  IplImage* postFilterImg;
+  // the statistics of the response to the last image a filter was applied
+  // to, which hold the peak and PSR. Set when there is such a response
+  ResponseStats stats;
+  bool hasResponse;
+
+  // the statistics of the responses to the images of the last batch
+  vector<ResponseStats> batchStats;
 
   // past n locations for smoothing
   int pastLocationIndex;
-  vector<CvPoint*> pastLocations;
+  vector<CvPoint2D64f*> pastLocations;
+
+  // tracking mode. Once locked on to a LOI, we apply a small patch filter to
+  // a patch of the image around the last location of the LOI
+  bool tracking;            // set when tracking mode is on
+  bool locked;              // set when locked on to a LOI
+  CvPoint2D64f trackedLocation; // the last location of the LOI in the frame
+  Filter* patchFilter;      // the filter for patches, derived from filter
+  IplImage* patchImg;       // the patch buffer
+
+  // pyramid mode. We first search for the LOI in the image downsampled by
+  // pyramidFactor, and refine the location with the patch filter
+  int pyramidFactor;        // the downsampling factor. 1 when not in use
+  Filter* coarseFilter;     // the filter for downsampled images
+  IplImage* coarseImg;      // the downsampled image buffer
+
+  long nTracked;            // the number of images in which the LOI was tracked
+  long nCoarse;             // the number of images searched coarse to fine
+  long nSearched;           // the number of images searched in full
 
-  // compute PSR
-  double computePSR(double max, CvPoint& location);
+  void createPatchFilters();
+  double findInPatch(IplImage* image, CvPoint& center, CvPoint2D64f& peak);
+  void refinePeak(CvPoint2D64f& location);
+  fftw_complex* preprocess(IplImage* image, fftw_complex* buffer);
 
  public:
   // constructor that loads a filter from file
@@ -46,19 +71,33 @@ class Location : public LocationBase {
   // constructor used to create location extractor with a pre-created filter
   Location(Filter* f);
 
+  // copy constructor that copies the filter and the past locations
+  Location(const Location& other);
+
   virtual ~Location();
 
+  // method to create a copy that can be applied concurrently with this one
+  virtual Location* clone() { return new Location(*this); }
+
   // main methods
   virtual void setImage(IplImage* image);
   virtual void setImage(fftw_complex* image);
   virtual fftw_complex* getPreprocessedImage(IplImage* image);
+  virtual fftw_complex* getPreprocessedImage(IplImage* image, Spectrum& spectrum);
   virtual bool apply();
+
+  // method to apply the filters of two extractors to the same preprocessed
+  // image using a single inverse transform. Returns false without applying
+  // either filter when pairing is disabled or the filters cannot be paired
+  static bool applyPair(Location* one, Location* two, fftw_complex* image);
+
   virtual Filter* getFilter() {
     return filter;
   }
   virtual void setFilter(Filter* f) { 
     if (filter) delete filter;
     filter = f;
+    createPatchFilters();
   }
   virtual void setWindowCenter(CvPoint& center) {
     if (filter)
@@ -69,6 +108,55 @@ class Location : public LocationBase {
   virtual double getMaxValue();
   virtual void getMinLocation(CvPoint& location, double& psr);
   virtual void getMaxLocation(CvPoint& location, double& psr);
+  virtual void getMaxLocation(CvPoint2D64f& location, double& psr);
+
+  // the two steps of getMaxLocation. getPeakLocation returns the max value
+  // and its location without smoothing, as the max pixel or as a sub-pixel
+  // location when Globals::subPixelPeaks is set. smoothLocation averages a
+  // location with the past locations and then adds it to the past locations
+  virtual double getPeakLocation(CvPoint& location);
+  virtual double getPeakLocation(CvPoint2D64f& location);
+  virtual void smoothLocation(CvPoint2D64f& location, CvPoint2D64f& smoothed);
+
+  // method to get the location of the max value of a filter response, as a
+  // sub-pixel location when Globals::subPixelPeaks is set, from its statistics
+  static void refinePeak(const ResponseStats& stats, CvPoint2D64f& location);
+
+  // methods for tracking mode. track looks for the LOI in a patch of image
+  // around its last location, and returns false when it is not locked on to
+  // the LOI or loses it. In that case the caller searches the whole image and
+  // locks on to the location found using lock. offset is the position of the
+  // image in the frame, and locations are in frame coordinates
+  virtual void setTracking(bool on);
+  virtual bool track(IplImage* image, CvPoint& offset, CvPoint2D64f& location,
+		     double& psr);
+  virtual void lock(CvPoint2D64f& location);
+  long getNTracked() { return nTracked; }
+  long getNCoarse() { return nCoarse; }
+  long getNSearched() { return nSearched; }
+
+  // methods for pyramid mode. search looks for the LOI coarse to fine, and
+  // returns false when pyramid mode is off and the filter is not band
+  // limited, or when the refined location is not reliable, in which case the
+  // caller searches the whole image. Locations are as in track. Band limited
+  // filters are applied to the spectrum of the image, which callers that
+  // have already preprocessed the image can pass in. searchesSpectrum is set
+  // when search uses the spectrum
+  virtual void setPyramid(int factor);
+  int getPyramid() { return pyramidFactor; }
+  virtual bool search(IplImage* image, CvPoint& offset, CvPoint2D64f& location,
+		      double& psr, bool smooth = true, fftw_complex* spectrum = 0);
+  bool searchesSpectrum() {
+    return patchFilter && !coarseFilter && filter->isBandLimited();
+  }
+
+  // method to apply the filter to a batch of n spectra computed using
+  // Filter::preprocessBatch and get the max location and PSR for each. The
+  // locations are smoothed over past locations, in batch order, only when
+  // smooth is set
+  virtual void getMaxLocations(fftw_complex* spectra, int n,
+			       vector<CvPoint2D64f>& locations, vector<double>& psrs,
+			       bool smooth = false);
 
   // test methods
   void printImageFFT(string filename) {
@@ -12,9 +12,90 @@ OnlineFilter::OnlineFilter(string output, Annotations::Tag tag, CvSize size,
 			   double spread, double rate, CvPoint& windowCenter)
   : Filter(output, tag, windowCenter), learningRate(rate) {
   gaussianSpread = spread;
+  createGaussianSpectrum();
+  initUpdatePolicy();
+}
+
+OnlineFilter::OnlineFilter(const OnlineFilter& other)
+  : Filter(other), learningRate(other.learningRate), fa(other.fa) {
+  int nElements = imgSize.height * ((imgSize.width / 2) + 1);
+  gaussianSpectrum = (double*)malloc(sizeof(double) * nElements);
+  memcpy(gaussianSpectrum, other.gaussianSpectrum, sizeof(double) * nElements);
+  initUpdatePolicy();
+  setUpdatePolicy(other.updateInterval, other.minPSR, other.updateOnZoneChange);
 }
 
 OnlineFilter::~OnlineFilter() {
+  free(gaussianSpectrum);
+}
+
+// initUpdatePolicy
+// Method used to set the update policy from the globals and reset the counters
+
+void OnlineFilter::initUpdatePolicy() {
+  setUpdatePolicy(Globals::onlineUpdateInterval, Globals::onlineMinPSR,
+		  Globals::onlineUpdateOnZoneChange);
+  lastZone = 0;
+  zoneChanged = false;
+  nApplied = nUpdated = 0;
+  nSkippedInterval = nSkippedPSR = nSkippedZone = 0;
+}
+
+// setUpdatePolicy
+// Method used to set the update policy. The filter is updated once every
+// interval images, when the PSR of the response is at least psr, and when
+// onZoneChange is set, only after a zone change
+
+void OnlineFilter::setUpdatePolicy(int interval, double psr, bool onZoneChange) {
+  updateInterval = (interval > 0)? interval : 1;
+  minPSR = psr;
+  updateOnZoneChange = onZoneChange;
+}
+
+// setZone
+// Method used to record the zone classified for the last image. A change of
+// zone allows one update under the zone change policy
+
+void OnlineFilter::setZone(int zone) {
+  if (zone != lastZone)
+    zoneChanged = true;
+  lastZone = zone;
+}
+
+// getUpdateMessage
+// Method that returns the number of updates made and skipped by the filter
+
+string OnlineFilter::getUpdateMessage() {
+  char buffer[Globals::largeBufferSize];
+  sprintf(buffer, "%s: applied %ld, updated %ld, skipped %ld (interval %ld, PSR %ld, zone %ld).",
+	  filterName(xmlTag).c_str(), nApplied, nUpdated, getNSkipped(),
+	  nSkippedInterval, nSkippedPSR, nSkippedZone);
+  return buffer;
+}
+
+// createGaussianSpectrum
+// Method used to compute the spectrum of a gaussian centered at the origin.
+// The gaussian wraps around the image borders, which makes its spectrum real,
+// and a shift of the gaussian a phase shift of its spectrum. For LOIs that are
+// not within a few deviations of the image borders, the shifted gaussian is
+// the gaussian created by createGaussian
+
+void OnlineFilter::createGaussianSpectrum() {
+  double sd = gaussianSpread / 2.0;     // sd as per the MATLAB code
+
+  for (int i = 0; i < imgSize.height; i++) {
+    double y = min(i, imgSize.height - i);
+    for (int j = 0; j < imgSize.width; j++) {
+      double x = min(j, imgSize.width - j);
+      imageBuffer[i * imgSize.width + j] = exp(-((x * x + y * y) / sd));
+    }
+  }
+  fftw_complex* fft = computeFFT();
+
+  int nElements = imgSize.height * ((imgSize.width / 2) + 1);
+  gaussianSpectrum = (double*)malloc(sizeof(double) * nElements);
+  for (int i = 0; i < nElements; i++)
+    gaussianSpectrum[i] = fft[i][0];
 }
 
 // onlineUpdate
@@ -23,101 +104,151 @@ OnlineFilter::~OnlineFilter() {
 // Filter class in that here we use the LOIs as identified by the filter we
 // have built using past images to find LOIs in a fresh image. These LOIs are
 // then used to update the filter for the next fresh image.
+// For each frequency, we shift the gaussian to the location, compute the
+// numerator and denominator terms for the image, blend them into the filter
+// terms and create the filter from the blended terms, all in one pass
 
 void OnlineFilter::onlineUpdate(fftw_complex* fftImage, CvPoint& location) {
-  // create a gaussian around the location centered at the location
-  CvSize sizeOfGaussian = {gaussianSpread, gaussianSpread}; // size and sd as per the MATLAB code
-  double sd = gaussianSpread / 2.0;
-  fftw_complex* gaussian = createGaussian(location, sizeOfGaussian, sd);
-
-  // find the complex conjugate of fftImage
-  int nElements = imgSize.height * ((imgSize.width / 2) + 1);
-  fftw_complex* fftImageC = getBuffer();
-  for (int i = 0; i < nElements; i++) {
-    fftImageC[i][0] = fftImage[i][0];
-    fftImageC[i][1] = -fftImage[i][1];
+  int width = imgSize.width / 2 + 1;
+
+  // the phase terms that shift the gaussian from the origin to the location,
+  // one per column and one per row of the spectrum
+  double xre[width];
+  double xim[width];
+  double yre[imgSize.height];
+  double yim[imgSize.height];
+  for (int j = 0; j < width; j++) {
+    double angle = -2 * M_PI * j * location.x / imgSize.width;
+    xre[j] = cos(angle);
+    xim[j] = sin(angle);
+  }
+  for (int i = 0; i < imgSize.height; i++) {
+    double angle = -2 * M_PI * i * location.y / imgSize.height;
+    yre[i] = cos(angle);
+    yim[i] = sin(angle);
   }
 
-  // Compute numerator and denominator terms for the filter update
-  fftw_complex* num = convolve(gaussian, fftImageC);
-  fftw_complex* den = convolve(fftImage, fftImageC);
-
-  // accumulate into filter wide numerator and denominator terms
-  // this is where we differ from the offline case. Here we take a
-  // convex combination of the filter terms we have learned from
-  // past images with the terms we have computed for this image
-
-  for(int i = 0; i < imgSize.height; i++) {
-    for(int j = 0; j < imgSize.width / 2 + 1; j++) {
-      int ij = i * (imgSize.width / 2 + 1) + j;
-      mosseNum[ij][0] = 
-	learningRate * num[ij][0] + (1 - learningRate) * mosseNum[ij][0];
-      mosseNum[ij][1] = 
-	learningRate * num[ij][1] + (1 - learningRate) * mosseNum[ij][1];
-
-      mosseDen[ij][0] = 
-	learningRate * den[ij][0] + (1 - learningRate) * mosseDen[ij][0];
-      mosseDen[ij][1] = 
-	learningRate * den[ij][1] + (1 - learningRate) * mosseDen[ij][1];
+  // this is where we differ from the offline case. Here we take a convex
+  // combination of the filter terms we have learned from past images with
+  // the terms we have computed for this image
+  double rate = learningRate;
+  double keep = 1 - learningRate;
+
+  for (int i = 0; i < imgSize.height; i++) {
+    for (int j = 0; j < width; j++) {
+      int ij = i * width + j;
+
+      // the gaussian at the location
+      double gr = gaussianSpectrum[ij] * (yre[i] * xre[j] - yim[i] * xim[j]);
+      double gi = gaussianSpectrum[ij] * (yre[i] * xim[j] + yim[i] * xre[j]);
+
+      // numerator and denominator terms for the image, which are the
+      // products of the gaussian and the image with the complex conjugate
+      // of the image
+      double fr = fftImage[ij][0];
+      double fi = fftImage[ij][1];
+      double numRe = gr * fr + gi * fi;
+      double numIm = gi * fr - gr * fi;
+      double den = fr * fr + fi * fi;
+
+      // blend into the filter terms
+      double a = rate * numRe + keep * mosseNum[ij][0];
+      double b = rate * numIm + keep * mosseNum[ij][1];
+      double c = rate * den + keep * mosseDen[ij][0];
+      double d = keep * mosseDen[ij][1];
+      mosseNum[ij][0] = a;
+      mosseNum[ij][1] = b;
+      mosseDen[ij][0] = c;
+      mosseDen[ij][1] = d;
+
+      // create the filter as in Filter::create
+      double denom = (c * c) + (d * d);
+      filter[ij][0] = (a * c + b * d) / denom;
+      filter[ij][1] = (b * c - a * d) / denom;
     }
   }
 }
 
-// apply
+// correlate
 // This method is used to apply a filter passed as input to an image
 // The filter is a complex array. The image FFT is also a complex array. The
 // method takes the filter and the image FFT as inputs and takes their element-wise
 // product. The steps taken are,
 // a. Take element-wise complex product of the fft and filter
 // b. Compute inverse FFT to transform data from complex to real domain
-// c. Compose an image object using the IFFT data and return it
+// c. Compute the statistics of the response, including its peak and PSR
+// d. Update the filter using the peak as the LOI, if the update policy allows
+// The filter is created from its terms when it is loaded and after each
+// update, so it is ready for use here
 
-IplImage* OnlineFilter::apply(fftw_complex* fft) {
+const ResponseStats& OnlineFilter::correlate(fftw_complex* fft) {
   // first check if we have done the preprocessing step
   if (!fft) {
     string err = "OnlineFilter::apply. fft object is NULL.";
     throw (err);
   }
-
-  // In the online case, the filter should first be created before use. The terms
-  // required to compute the filter evolve as new images are processed. But the
-  // filter as a function of these terms should be created before each application.
-  // Defer to the base class..
-
-  create();
   if (!filter) {
     string err = "OnlineFilter::apply. Invalid filter (NULL).";
     throw (err);
   }
 
-  // copy the preprocessed image fft for use in the subsequent online update
-  fftw_complex* fftCopy = getBuffer();
+  // check the parts of the update policy that do not depend on the response
+  nApplied++;
+  bool update = true;
+  if ((nApplied - 1) % updateInterval) {
+    nSkippedInterval++;
+    update = false;
+  } else if (updateOnZoneChange && !zoneChanged) {
+    nSkippedZone++;
+    update = false;
+  }
+
+  // the product of the fft data and the filter data is written into the FFT
+  // buffer, which is overwritten by the inverse transform. When the image fft
+  // is in the FFT buffer, we keep a copy for the update
   int nElements = imgSize.height * ((imgSize.width / 2) + 1);
-  memcpy(fftCopy, fft, (sizeof(fftw_complex) * nElements));
+  if (update && fft == fftBuffer) {
+    fftw_complex* fftCopy = getBuffer();
+    memcpy(fftCopy, fft, (sizeof(fftw_complex) * nElements));
+    fft = fftCopy;
+  }
 
   // now take product of the fft data and the filter data
   convolve(fft, filter, fftBuffer /* output store */);
 
-  // now get the inverse FFT and perform an online update
-  IplImage* postFilterImg = computeInvFFT();
+  // now get the inverse FFT and its statistics
+  fftw_execute(planResponse);
+  computeStats(responseBuffer, imgSize, imgSize.width, stats);
+  responsePending = true;
+
+  // set the location of the nose if this is the nose filter
+  fa.setFace(stats.maxLoc);
+
+  // the update is skipped when the response is not peaked enough, as when
+  // the LOI is occluded
+  if (update && minPSR > 0 && stats.psr < minPSR) {
+    nSkippedPSR++;
+    update = false;
+  }
 
   // finally do an online update of the filter using the LOI and the
   // input image
-  double min;
-  double max;
-  CvPoint minLoc;
-  CvPoint maxLoc;
-  
-  // get max location
-  cvMinMaxLoc(postFilterImg, &min, &max, &minLoc, &maxLoc);
-  double scale = 1.0 / max;
-  cvConvertScale(postFilterImg, postFilterImg, scale, 0.0);
+  if (update) {
+    onlineUpdate(fft, stats.maxLoc);
+    zoneChanged = false;
+    nUpdated++;
+  }
 
-  // set the location of the nose if this is the nose filter
-  fa.setFace(maxLoc);
+  return stats;
+}
 
-  // update
-  onlineUpdate(fftCopy, maxLoc);
+// applyBatch
+// Method used to apply the filter to a batch of spectra. Since each application
+// updates the filter, we apply the filter to one spectrum at a time
 
-  return postFilterImg;
+void OnlineFilter::applyBatch(fftw_complex* spectra, int n, vector<ResponseStats>& stats) {
+  int nElements = imgSize.height * ((imgSize.width / 2) + 1);
+  stats.resize(n);
+  for (int i = 0; i < n; i++)
+    stats[i] = correlate(spectra + i * nElements);
 }
@@ -8,6 +8,13 @@
 // and then update it as we track the LOIs. For each new image, the update is a 
 // convex combination of the filter computed for previous images and the one
 // computed for the new image. The implementation is based on Bolme 2010.
+// The update of the filter terms and the creation of the filter from those
+// terms are done in a single pass over the spectrum, so the filter is always
+// ready for the next image.
+// Updates are made according to an update policy. An update can be limited to
+// every Nth image, to responses with a PSR above a threshold, which leaves the
+// filter as it is when the LOI is occluded, and to images that follow a zone
+// change. The filter counts the updates it makes and skips.
 
 #include "Filter.h"
 
@@ -16,19 +23,65 @@ class OnlineFilter : public Filter {
   double learningRate;              // the learning rate for the online update
   FrameAnnotation fa;               // a frame annotation object
 
+  // the spectrum of a gaussian centered at the origin that wraps around the
+  // image borders. The spectrum is real. The gaussian at a LOI is obtained
+  // by shifting this gaussian in the frequency domain
+  double* gaussianSpectrum;
+
+  // the update policy
+  int updateInterval;               // update once every updateInterval images
+  double minPSR;                    // the smallest PSR for an update
+  bool updateOnZoneChange;          // update only after zone changes
+
+  int lastZone;                     // the last zone set for the filter
+  bool zoneChanged;                 // set when the zone changed since an update
+
+  // update counters
+  long nApplied;                    // the number of images the filter was applied to
+  long nUpdated;                    // the number of updates
+  long nSkippedInterval;            // the number of updates skipped for the interval
+  long nSkippedPSR;                 // the number of updates skipped for low PSRs
+  long nSkippedZone;                // the number of updates skipped for no zone change
+
  public:
   // Constructor used to construct a filter
   OnlineFilter(string outputDirectory, Annotations::Tag xmlTag, CvSize size, 
 	       double gaussianSpread, double learningRate, 
 	       CvPoint& windowCenter);
 
+  // Copy constructor that creates an independent copy of a filter
+  OnlineFilter(const OnlineFilter& other);
+
   virtual ~OnlineFilter();
 
-  // method to apply a filter to an image array
-  virtual IplImage* apply(fftw_complex* imageFFT);
+  // method to create a copy of a filter that can be used concurrently
+  virtual Filter* clone() { return new OnlineFilter(*this); }
+
+  // method to apply a filter to an image array and get the statistics of
+  // the response. Apply uses it, so it also updates applied filters
+  virtual const ResponseStats& correlate(fftw_complex* imageFFT);
+
+  // method used to track zone changes for the update policy
+  virtual void setZone(int zone);
+
+  // methods to set the update policy and get the update counters
+  void setUpdatePolicy(int interval, double psr, bool onZoneChange);
+  long getNApplied() { return nApplied; }
+  long getNUpdated() { return nUpdated; }
+  long getNSkipped() { return nSkippedInterval + nSkippedPSR + nSkippedZone; }
+  string getUpdateMessage();
+
+  // the filter is updated after each image, so a batch is applied one
+  // image at a time in batch order
+  virtual void applyBatch(fftw_complex* spectra, int n, vector<ResponseStats>& stats);
+
+  // the filter is updated on correlate, so it is never applied in pairs
+  virtual bool isOnline() { return true; }
 
  protected:
   void onlineUpdate(fftw_complex* imageFFT, CvPoint& location);
+  void createGaussianSpectrum();
+  void initUpdatePolicy();
 };
 
 #endif // __ONLINEFILTER_H
@@ -0,0 +1,164 @@
+// PrimalModel.cpp
+// This file contains the implementation of class PrimalModel. For a polynomial kernel
+// k(x, z) = (s <x, z> + c)^d, the multinomial theorem gives
+//   k(x, z) = sum over exponent vectors e with |e| <= d of
+//             d! / ((d - |e|)! prod e_i!) s^|e| c^(d - |e|) prod (x_i z_i)^e_i
+// The SVM decision function sum_j alpha_j y_j k(x, z_j) - b is therefore a dot
+// product between the monomials of x and a weight vector that only depends on the
+// support vectors. The linear kernel is the special case d = 1, s = 1, c = 0.
+// If the features are normalized as x' = A x + o, with A diagonal, then
+//   s <x', z> + c = s <x, A z> + (c + s <o, z>)
+// so folding the normalization amounts to scaling each support vector by A and
+// using a constant term that is specific to each support vector
+
+#include "PrimalModel.h"
+
+// Class construction
+
+// The constructor enumerates the monomials of degree at most d over n features in
+// graded order. The constant monomial comes first
+
+PrimalModel::PrimalModel(int n, int d) : nFeatures(n), degree(d), bias(0) {
+  parents.push_back(-1);
+  variables.push_back(-1);
+
+  // [start, end) is the range of monomials of the previous degree
+  int start = 0;
+  int end = 1;
+  for (int g = 1; g <= degree; g++) {
+    for (int m = start; m < end; m++) {
+      int first = (variables[m] < 0)? 0 : variables[m];
+      for (int v = first; v < nFeatures; v++) {
+	parents.push_back(m);
+	variables.push_back(v);
+      }
+    }
+    start = end;
+    end = parents.size();
+  }
+
+  weights.assign(parents.size(), 0.0);
+}
+
+// countTerms
+// Method that returns the number of monomials of degree at most d over n
+// features, which is the binomial coefficient C(n + d, d)
+
+long PrimalModel::countTerms(int nFeatures, int degree) {
+  long result = 1;
+  for (int i = 1; i <= degree; i++) {
+    result = result * (nFeatures + i) / i;
+    if (result > INT_MAX)
+      return LONG_MAX;
+  }
+  return result;
+}
+
+// create
+// Method used to expand an SVM-Light model into primal weights. Only linear and
+// polynomial kernels have a finite expansion. For everything else, or when the
+// expansion has more than maxTerms monomials, we return 0 and the caller is
+// expected to fall back to classify_example
+
+PrimalModel* PrimalModel::create(MODEL* model, int nFeatures, int maxTerms,
+				 const double* scale, const double* offset) {
+  if (!model)
+    return 0;
+
+  int d;
+  double s;
+  double c;
+  switch (model->kernel_parm.kernel_type) {
+  case 0: /* linear kernel */
+    d = 1;
+    s = 1.0;
+    c = 0.0;
+    break;
+  case 1: /* polynomial kernel */
+    d = model->kernel_parm.poly_degree;
+    s = model->kernel_parm.coef_lin;
+    c = model->kernel_parm.coef_const;
+    break;
+  default:
+    return 0;
+  }
+
+  if (d < 1 || countTerms(nFeatures, d) > maxTerms)
+    return 0;
+
+  PrimalModel* primal = new PrimalModel(nFeatures, d);
+  primal->bias = model->b;
+  int nTerms = primal->getNTerms();
+
+  // compute the multinomial coefficient times s^g for each monomial of degree g
+  // from that of its parent. Going from the parent to the child, the degree
+  // goes from g - 1 to g and the exponent of the new variable goes up by one.
+  // Since variables are non-decreasing along a chain of parents, that exponent
+  // is one more than the exponent of the parent's variable if it is the same
+  // variable, and one otherwise
+  vector<double> coefficients(nTerms);
+  vector<int> degrees(nTerms);
+  vector<int> exponents(nTerms);
+
+  coefficients[0] = 1.0;
+  degrees[0] = 0;
+  exponents[0] = 0;
+  for (int m = 1; m < nTerms; m++) {
+    int p = primal->parents[m];
+    exponents[m] = (primal->variables[p] == primal->variables[m])?
+      exponents[p] + 1 : 1;
+    degrees[m] = degrees[p] + 1;
+    coefficients[m] = coefficients[p] * s * (d - degrees[p]) / exponents[m];
+  }
+
+  // accumulate the expanded support vectors weighted by alpha * y and the
+  // power of the constant term that goes with the degree of each monomial.
+  // Support vectors are stored from index 1 in SVM-Light models
+  double z[nFeatures];
+  double terms[nTerms];
+  double cPowers[d + 1];
+  for (long j = 1; j < model->sv_num; j++) {
+    SVECTOR* sv = model->supvec[j]->fvec;
+
+    for (int i = 0; i < nFeatures; i++)
+      z[i] = 0;
+    for (WORD* word = sv->words; word->wnum; word++) {
+      if (word->wnum > nFeatures) {
+	delete primal;
+	return 0;
+      }
+      z[word->wnum - 1] = word->weight;
+    }
+
+    // fold the normalization into the support vector and its constant term
+    double constant = c;
+    if (scale && offset) {
+      for (int i = 0; i < nFeatures; i++) {
+	constant += s * offset[i] * z[i];
+	z[i] *= scale[i];
+      }
+    }
+    for (int g = 0; g <= d; g++)
+      cPowers[g] = pow(constant, d - g);
+
+    primal->expand(z, terms);
+    double alpha = model->alpha[j] * sv->factor;
+    for (int m = 0; m < nTerms; m++)
+      primal->weights[m] += alpha * cPowers[degrees[m]] * terms[m];
+  }
+
+  for (int m = 0; m < nTerms; m++)
+    primal->weights[m] *= coefficients[m];
+
+  return primal;
+}
+
+// expand
+// Method used to compute the monomials of a feature vector. Each monomial is its
+// parent times a single feature, so this is one multiplication per monomial
+
+void PrimalModel::expand(const double* data, double* terms) {
+  terms[0] = 1.0;
+  for (unsigned int m = 1; m < parents.size(); m++)
+    terms[m] = terms[parents[m]] * data[variables[m]];
+}
@@ -0,0 +1,77 @@
+#ifndef __PRIMALMODEL_H
+#define __PRIMALMODEL_H
+
+// PrimalModel.h
+// This file contains the definition of class PrimalModel. An SVM-Light model with a
+// linear or polynomial kernel over a handful of features is exactly a linear model
+// over the monomials of those features up to the degree of the kernel. We expand
+// such models once at load time into a vector of primal weights, one per monomial,
+// so that classifying a feature vector costs one short dot product regardless of
+// the number of support vectors in the model. An affine normalization of the
+// features can be folded into the weights, in which case the model is applied to
+// raw feature values
+
+#include <math.h>
+#include <limits.h>
+#include <vector>
+
+#include "Globals.h"
+
+// SVM Light stuff
+#ifdef __cplusplus
+extern "C" {
+#include "svm_common.h"
+}
+#endif
+
+using namespace std;
+
+class PrimalModel {
+ private:
+  int nFeatures;                // the number of input features
+  int degree;                   // the degree of the polynomial expansion
+  double bias;                  // the threshold b of the SVM-Light model
+
+  // monomials are enumerated in graded order. Each monomial other than the
+  // constant term is its parent monomial times one of the input features. The
+  // variable of a monomial is never smaller than the variable of its parent,
+  // which makes every monomial unique
+  vector<int> parents;          // index of the parent monomial
+  vector<int> variables;        // feature index that extends the parent
+
+  vector<double> weights;       // one primal weight per monomial
+
+  PrimalModel(int nFeatures, int degree);
+
+ public:
+  ~PrimalModel() { }
+
+  // factory method that expands a model if its kernel allows it and the
+  // number of monomials does not exceed maxTerms. Returns 0 otherwise. When
+  // scale and offset are given, the model is expected to have been trained
+  // on features normalized as scale * x + offset and the returned expansion
+  // takes the raw features x
+  static PrimalModel* create(MODEL* model, int nFeatures, int maxTerms,
+			     const double* scale = 0, const double* offset = 0);
+
+  // number of monomials of degree at most d over n features
+  static long countTerms(int nFeatures, int degree);
+
+  int getNTerms() { return (int)weights.size(); }
+  int getDegree() { return degree; }
+
+  // method to compute all monomials of a feature vector. The terms array
+  // is expected to hold getNTerms() values
+  void expand(const double* data, double* terms);
+
+  // method to score an expanded feature vector. Equivalent to the value
+  // returned by classify_example for the original model
+  double score(const double* terms) {
+    double result = 0;
+    for (unsigned int i = 0; i < weights.size(); i++)
+      result += weights[i] * terms[i];
+    return result - bias;
+  }
+};
+
+#endif // __PRIMALMODEL_H
@@ -0,0 +1,286 @@
+// ROICache.cpp
+// This file contains the implementation of class ROICache
+
+#include "ROICache.h"
+#include "Classifier.h"
+
+// static member initialization
+const unsigned int ROICache::version = 1;
+
+// magic string at the start of a ROI cache file
+static const char s_magic[8] = "MOSSERC";
+
+// the number of frames decoded at a time when building a cache
+static const int s_blockSize = 256;
+
+// Class construction and destruction
+
+// The file is mapped read only and all views point into the mapping. We check
+// that the file has the size given by its header before we set up the views
+
+ROICache::ROICache(string filename) {
+  mapping = 0;
+  mappingSize = 0;
+
+  int fd = ::open((const char*)filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    string err = "ROICache::ROICache. Unable to open file " + filename;
+    throw (err);
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) || info.st_size < (off_t)sizeof(ROICacheHeader)) {
+    close(fd);
+    string err = "ROICache::ROICache. Malformed cache file " + filename;
+    throw (err);
+  }
+
+  mappingSize = info.st_size;
+  mapping = mmap(0, mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    mapping = 0;
+    string err = "ROICache::ROICache. Unable to map file " + filename;
+    throw (err);
+  }
+
+  const ROICacheHeader* header = (const ROICacheHeader*)mapping;
+  if (memcmp(header->magic, s_magic, sizeof(s_magic)) || header->version != version) {
+    munmap(mapping, mappingSize);
+    string err = "ROICache::ROICache. Unknown cache file format in " + filename;
+    throw (err);
+  }
+
+  size.width = header->width;
+  size.height = header->height;
+  nFrames = header->nFrames;
+
+  size_t expected = sizeof(ROICacheHeader) +
+    (size_t)nFrames * (9 * sizeof(int) + (size_t)size.width * size.height);
+  if (expected != mappingSize) {
+    munmap(mapping, mappingSize);
+    string err = "ROICache::ROICache. Truncated cache file " + filename;
+    throw (err);
+  }
+
+  annotated = (const int*)((const char*)mapping + sizeof(ROICacheHeader));
+  locations = annotated + nFrames * 3;
+  pixels = (const unsigned char*)(locations + nFrames * 6);
+}
+
+ROICache::~ROICache() {
+  if (mapping)
+    munmap(mapping, mappingSize);
+}
+
+// build
+// Method used to build a cache in the layout described in ROICache.h. Frames
+// are decoded, converted to grayscale and cropped in parallel, a block at a
+// time, and each block is written before the next one is decoded. The LOI
+// locations are written once all frames have been decoded. The cache is
+// written to a temporary file that is renamed once it is complete, so that
+// other runs never map a partial cache
+
+void ROICache::build(string filename, vector<string>& directories, CvSize roiSize,
+		     roiFnT roiFunction) {
+  vector<string> fileNames;
+  vector<FrameAnnotation> frames;
+  Classifier::getFrames(directories, 0, 1, fileNames, frames);
+
+  long n = frames.size();
+  vector<int> annotatedStorage(n * 3, 0);
+  vector<int> locationStorage(n * 6, 0);
+
+  char buffer[Globals::smallBufferSize];
+  sprintf(buffer, ".%d.%d", (int)getpid(), omp_get_thread_num());
+  string tempFileName = filename + buffer;
+
+  ofstream file;
+  file.open((const char*)tempFileName.c_str(), ios::out | ios::binary);
+  if (!file.good()) {
+    string err = "ROICache::build. Unable to open file " + tempFileName;
+    throw (err);
+  }
+
+  ROICacheHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, s_magic, sizeof(s_magic));
+  header.version = version;
+  header.width = roiSize.width;
+  header.height = roiSize.height;
+  header.nFrames = n;
+  header.key = getKey(directories, roiSize);
+
+  // the locations are written once they are known
+  file.write((const char*)&header, sizeof(header));
+  if (n) {
+    file.write((const char*)&annotatedStorage[0], n * 3 * sizeof(int));
+    file.write((const char*)&locationStorage[0], n * 6 * sizeof(int));
+  }
+
+  Annotations::Tag tags[] = { Annotations::LeftEye, Annotations::RightEye,
+			      Annotations::Nose };
+  size_t roiBytes = (size_t)roiSize.width * roiSize.height;
+  vector<unsigned char> block(s_blockSize * roiBytes);
+  vector<string> errors(s_blockSize);
+
+  for (long start = 0; start < n; start += s_blockSize) {
+    int m = min((long)s_blockSize, n - start);
+
+    #pragma omp parallel for schedule(dynamic) num_threads(omp_get_max_threads())
+    for (int i = 0; i < m; i++) {
+      long frame = start + i;
+      IplImage* inputImg = cvLoadImage((const char*)fileNames[frame].c_str());
+      if (!inputImg) {
+	errors[i] = "ROICache::build. Cannot load file " + fileNames[frame] + ".";
+	continue;
+      }
+      IplImage* image = cvCreateImage(cvGetSize(inputImg), IPL_DEPTH_8U, 1);
+      cvCvtColor(inputImg, image, CV_BGR2GRAY);
+      cvReleaseImage(&inputImg);
+
+      CvPoint offset;
+      offset.x = offset.y = 0;
+      IplImage* roi = (roiFunction)? 
+	roiFunction(image, frames[frame], offset, Annotations::Face) : image;
+      if (roi->width != roiSize.width || roi->height != roiSize.height) 
+	errors[i] = "ROICache::build. Inconsistent ROI size for file " +
+	  fileNames[frame] + ".";
+      else {
+	unsigned char* dest = &block[i * roiBytes];
+	for (int y = 0; y < roiSize.height; y++)
+	  memcpy(dest + y * roiSize.width, roi->imageData + y * roi->widthStep,
+		 roiSize.width);
+
+	for (int j = 0; j < 3; j++) {
+	  CvPoint& location = frames[frame].getLOI(tags[j]);
+	  if (!location.x && !location.y)
+	    continue;
+	  annotatedStorage[frame * 3 + j] = 1;
+	  locationStorage[(frame * 3 + j) * 2] = location.x - offset.x;
+	  locationStorage[(frame * 3 + j) * 2 + 1] = location.y - offset.y;
+	}
+      }
+
+      if (roi != image)
+	cvReleaseImage(&roi);
+      cvReleaseImage(&image);
+    }
+
+    for (int i = 0; i < m; i++) {
+      if (errors[i] != "") {
+	file.close();
+	unlink((const char*)tempFileName.c_str());
+	throw (errors[i]);
+      }
+    }
+    file.write((const char*)&block[0], m * roiBytes);
+  }
+
+  if (n) {
+    file.seekp(sizeof(header));
+    file.write((const char*)&annotatedStorage[0], n * 3 * sizeof(int));
+    file.write((const char*)&locationStorage[0], n * 6 * sizeof(int));
+  }
+
+  file.close();
+  if (file.fail()) {
+    unlink((const char*)tempFileName.c_str());
+    string err = "ROICache::build. Error writing file " + tempFileName;
+    throw (err);
+  }
+  if (rename((const char*)tempFileName.c_str(), (const char*)filename.c_str())) {
+    unlink((const char*)tempFileName.c_str());
+    string err = "ROICache::build. Unable to rename " + tempFileName + " to " + filename;
+    throw (err);
+  }
+}
+
+// getFileName
+// Method that returns the name of the cache for a set of directories and a
+// ROI size
+
+string ROICache::getFileName(string cacheDirectory, vector<string>& directories,
+			     CvSize roiSize) {
+  char buffer[Globals::midBufferSize];
+  sprintf(buffer, "rois_%dx%d_%016llx.cache", roiSize.width, roiSize.height,
+	  getKey(directories, roiSize));
+  return cacheDirectory + "/" + buffer;
+}
+
+// open
+// Method used to map the cache for a set of directories and a ROI size. The
+// cache is built if it does not exist, and rebuilt if it cannot be mapped, as
+// when it was left truncated or was written by another version
+
+ROICache* ROICache::open(string cacheDirectory, vector<string>& directories,
+			 CvSize roiSize, roiFnT roiFunction) {
+  string filename = getFileName(cacheDirectory, directories, roiSize);
+
+  struct stat info;
+  if (!stat((const char*)filename.c_str(), &info)) {
+    try {
+      return new ROICache(filename);
+    } catch (string err) {
+      cout << err << ". Rebuilding ROI cache " << filename << "..." << endl;
+    }
+  } else
+    cout << "Building ROI cache " << filename << "..." << endl;
+
+  build(filename, directories, roiSize, roiFunction);
+  return new ROICache(filename);
+}
+
+// getROI
+// Method used to point an image header at the ROI of a frame in the mapping
+
+void ROICache::getROI(long frame, IplImage* header) {
+  if (frame < 0 || frame >= nFrames) {
+    string err = "ROICache::getROI. Invalid frame.";
+    throw (err);
+  }
+  size_t roiBytes = (size_t)size.width * size.height;
+  cvSetData(header, (void*)(pixels + frame * roiBytes), size.width);
+}
+
+// getKey
+// Method used to compute the key of a set of directories and a ROI size. The
+// key is a 64 bit FNV-1a hash of the ROI size, the directory names, and the
+// sizes and modification times of their annotation files
+
+unsigned long long ROICache::getKey(vector<string>& directories, CvSize roiSize) {
+  char buffer[Globals::largeBufferSize];
+  string str;
+  sprintf(buffer, "%dx%d", roiSize.width, roiSize.height);
+  str += buffer;
+  for (unsigned int i = 0; i < directories.size(); i++) {
+    str += "|" + directories[i];
+    string annotationsFile = directories[i] + "/" + Globals::annotationsFileName;
+    struct stat info;
+    if (!stat((const char*)annotationsFile.c_str(), &info)) {
+      sprintf(buffer, ":%lld:%lld", (long long)info.st_size, (long long)info.st_mtime);
+      str += buffer;
+    }
+  }
+
+  unsigned long long hash = 14695981039346656037ULL;
+  for (unsigned int i = 0; i < str.size(); i++) {
+    hash ^= (unsigned char)str[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+// getIndex
+// Method that returns the index of a LOI in the cache
+
+int ROICache::getIndex(Annotations::Tag tag) {
+  switch (tag) {
+  case Annotations::LeftEye: return 0;
+  case Annotations::RightEye: return 1;
+  case Annotations::Nose: return 2;
+  default:
+    string err = "ROICache::getIndex. Unknown tag";
+    throw (err);
+  }
+}
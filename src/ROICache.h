@@ -0,0 +1,113 @@
+#ifndef __ROICACHE_H
+#define __ROICACHE_H
+
+// ROICache.h
+// This file contains the definition of class ROICache. A ROI cache holds the
+// grayscale face ROIs of the annotated frames in a set of directories, and
+// the locations of the LOIs in the ROIs. Frames are decoded, converted and
+// cropped once, when the cache is built, and the cache is then memory mapped
+// by any number of runs that use the same ROI size. Caches are named after
+// the ROI size and a key computed from the directories and their annotation
+// files, so a cache is rebuilt when the annotations change.
+//
+// The file layout is as follows,
+//   header        (64 bytes, see ROICacheHeader)
+//   annotated     int[nFrames][3], set when the LOI is annotated
+//   locations     int[nFrames][3][2], the LOI locations in the ROIs
+//   pixels        unsigned char[nFrames][height][width]
+// LOIs are the left eye, the right eye and the nose, in that order
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "Globals.h"
+#include "Filter.h"
+
+using namespace std;
+
+// the on-disk header of a ROI cache
+typedef struct {
+  char magic[8];                // "MOSSERC" and a null
+  unsigned int version;         // the format version
+  unsigned int width;           // the ROI width
+  unsigned int height;          // the ROI height
+  unsigned int reserved0;
+  unsigned long long nFrames;   // the number of frames
+  unsigned long long key;       // the key of the directories
+  char reserved[24];
+} ROICacheHeader;
+
+class ROICache {
+ private:
+  CvSize size;                  // the ROI size
+  long nFrames;                 // the number of frames
+
+  // views of the mapped file
+  const int* annotated;
+  const int* locations;
+  const unsigned char* pixels;
+
+  // the mapped file
+  void* mapping;
+  size_t mappingSize;
+
+  static const unsigned int version;
+
+  // caches are not copied
+  ROICache(const ROICache& other);
+  ROICache& operator=(const ROICache& other);
+
+ public:
+  // Constructor that memory maps a cache saved using build
+  ROICache(string filename);
+  ~ROICache();
+
+  // method to build the cache for the annotated frames in a set of
+  // directories. Frames are decoded in parallel, a block at a time
+  static void build(string filename, vector<string>& directories, CvSize roiSize,
+		    roiFnT roiFunction);
+
+  // method to get the name of the cache for a set of directories and a ROI
+  // size, in a cache directory
+  static string getFileName(string cacheDirectory, vector<string>& directories,
+			    CvSize roiSize);
+
+  // method to map the cache for a set of directories and a ROI size, which
+  // is built first if it does not exist or cannot be mapped. The caller owns
+  // the cache
+  static ROICache* open(string cacheDirectory, vector<string>& directories,
+			CvSize roiSize, roiFnT roiFunction);
+
+  CvSize getSize() { return size; }
+  long getNFrames() { return nFrames; }
+
+  // method to point an image header at the ROI of a frame. The header must
+  // have the ROI size, a depth of 8 bits and one channel. The ROI is mapped
+  // read only, so it must be copied before it is modified
+  void getROI(long frame, IplImage* header);
+
+  // methods to get whether a LOI is annotated in a frame and its location
+  // in the ROI
+  bool isAnnotated(long frame, Annotations::Tag tag) {
+    return annotated[frame * 3 + getIndex(tag)] != 0;
+  }
+  CvPoint getLocation(long frame, Annotations::Tag tag) {
+    const int* location = locations + (frame * 3 + getIndex(tag)) * 2;
+    return cvPoint(location[0], location[1]);
+  }
+
+ private:
+  static unsigned long long getKey(vector<string>& directories, CvSize roiSize);
+  static int getIndex(Annotations::Tag tag);
+};
+
+#endif // __ROICACHE_H
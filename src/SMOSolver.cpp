@@ -0,0 +1,431 @@
+// SMOSolver.cpp
+// This file contains the implementation of class SMOSolver. We solve the SVM dual
+//   min 1/2 a'Qa - e'a  subject to  0 <= a_i <= C, y'a = 0
+// with Q_ij = y_i y_j K(x_i, x_j), by repeatedly optimizing over a pair of dual
+// variables. The pair is picked using the maximal violating variable and second
+// order information, and the iterations stop once the KKT conditions are met up
+// to Globals::svmEpsilon. The structure follows the solver in LIBSVM
+
+#include "SMOSolver.h"
+
+// the smallest curvature we allow along a working pair
+static const double s_tau = 1e-12;
+
+// Class construction and destruction
+
+SMOSolver::SMOSolver(long kernelType, double c) : C(c) {
+  // the SVM-Light defaults for the kernel parameters
+  kernelParm.kernel_type = kernelType;
+  kernelParm.poly_degree = 3;
+  kernelParm.rbf_gamma = 1.0;
+  kernelParm.coef_lin = 1.0;
+  kernelParm.coef_const = 1.0;
+  strcpy(kernelParm.custom, "empty");
+
+  rows = 0;
+  labels = 0;
+  nRows = nFeatures = 0;
+  b = 0;
+  clock = 0;
+  nCacheColumns = 0;
+}
+
+SMOSolver::~SMOSolver() {
+  clearCache();
+}
+
+// clearCache
+// Method used to release all cached kernel columns
+
+void SMOSolver::clearCache() {
+  for (unsigned int i = 0; i < columns.size(); i++)
+    delete [] columns[i];
+  columns.clear();
+  columnOwner.clear();
+  columnAge.clear();
+  columnSlot.clear();
+}
+
+// kernel
+// Method that evaluates the kernel for two training samples
+
+double SMOSolver::kernel(int i, int j) {
+  return kernel(rows + (long)i * nFeatures, rows + (long)j * nFeatures);
+}
+
+// kernel
+// Method that evaluates the kernel for two feature vectors
+
+double SMOSolver::kernel(const double* a, const double* x) {
+  switch (kernelParm.kernel_type) {
+  case 0: { /* linear */
+    double dot = 0;
+    for (int k = 0; k < nFeatures; k++)
+      dot += a[k] * x[k];
+    return dot;
+  }
+  case 1: { /* polynomial */
+    double dot = 0;
+    for (int k = 0; k < nFeatures; k++)
+      dot += a[k] * x[k];
+    return pow(kernelParm.coef_lin * dot + kernelParm.coef_const,
+	       (double)kernelParm.poly_degree);
+  }
+  case 2: { /* radial basis function */
+    double distance = 0;
+    for (int k = 0; k < nFeatures; k++)
+      distance += (a[k] - x[k]) * (a[k] - x[k]);
+    return exp(-kernelParm.rbf_gamma * distance);
+  }
+  case 3: { /* sigmoid */
+    double dot = 0;
+    for (int k = 0; k < nFeatures; k++)
+      dot += a[k] * x[k];
+    return tanh(kernelParm.coef_lin * dot + kernelParm.coef_const);
+  }
+  default: {
+    string err = "SMOSolver::kernel. Unsupported kernel type.";
+    throw (err);
+  }
+  }
+}
+
+// getColumn
+// Method that returns column i of Q. Columns are cached, and when the cache is
+// full we replace the column that has not been used for the longest time. The
+// cache always has room for at least two columns, so the column returned by
+// the previous call stays valid
+
+const float* SMOSolver::getColumn(int i) {
+  int slot = columnSlot[i];
+  if (slot < 0) {
+    if ((long)columns.size() < nCacheColumns) {
+      slot = columns.size();
+      columns.push_back(new float[nRows]);
+      columnOwner.push_back(i);
+      columnAge.push_back(0);
+    } else {
+      slot = 0;
+      for (unsigned int k = 1; k < columns.size(); k++)
+	if (columnAge[k] < columnAge[slot])
+	  slot = k;
+      columnSlot[columnOwner[slot]] = -1;
+      columnOwner[slot] = i;
+    }
+    columnSlot[i] = slot;
+
+    float* column = columns[slot];
+    for (int k = 0; k < nRows; k++)
+      column[k] = (float)(labels[i] * labels[k] * kernel(i, k));
+  }
+  columnAge[slot] = ++clock;
+  return columns[slot];
+}
+
+// selectWorkingSet
+// Method used to select the next pair of variables to optimize. The first is
+// the maximal violating variable, and the second is the one that gives the
+// largest decrease of the objective given the first. Returns true when no
+// pair violates the optimality conditions by more than Globals::svmEpsilon
+
+bool SMOSolver::selectWorkingSet(vector<double>& gradient, int& outI, int& outJ) {
+  double gMax = -DBL_MAX;
+  double gMax2 = -DBL_MAX;
+  int i = -1;
+  int j = -1;
+  double minObjective = DBL_MAX;
+
+  for (int t = 0; t < nRows; t++) {
+    if (labels[t] > 0) {
+      if (alpha[t] < C && -gradient[t] >= gMax) {
+	gMax = -gradient[t];
+	i = t;
+      }
+    } else {
+      if (alpha[t] > 0 && gradient[t] >= gMax) {
+	gMax = gradient[t];
+	i = t;
+      }
+    }
+  }
+  if (i < 0)
+    return true;
+
+  const float* Qi = getColumn(i);
+  for (int t = 0; t < nRows; t++) {
+    double gradientDiff;
+    double quad;
+    if (labels[t] > 0) {
+      if (alpha[t] <= 0)
+	continue;
+      if (gradient[t] >= gMax2)
+	gMax2 = gradient[t];
+      gradientDiff = gMax + gradient[t];
+      quad = diagonal[i] + diagonal[t] - 2.0 * labels[i] * Qi[t];
+    } else {
+      if (alpha[t] >= C)
+	continue;
+      if (-gradient[t] >= gMax2)
+	gMax2 = -gradient[t];
+      gradientDiff = gMax - gradient[t];
+      quad = diagonal[i] + diagonal[t] + 2.0 * labels[i] * Qi[t];
+    }
+    if (gradientDiff > 0) {
+      double objective = -(gradientDiff * gradientDiff) / ((quad > 0)? quad : s_tau);
+      if (objective <= minObjective) {
+	minObjective = objective;
+	j = t;
+      }
+    }
+  }
+
+  if (gMax + gMax2 < Globals::svmEpsilon || j < 0)
+    return true;
+
+  outI = i;
+  outJ = j;
+  return false;
+}
+
+// train
+// Method used to train a model. Throws if the data cannot be used to train a
+// binary classifier
+
+void SMOSolver::train(const double* data, int n, int nf, const double* y) {
+  if (!data || !y || n < 2 || nf < 1) {
+    string err = "SMOSolver::train. Not enough training data.";
+    throw (err);
+  }
+
+  rows = data;
+  labels = y;
+  nRows = n;
+  nFeatures = nf;
+
+  int nPositive = 0;
+  for (int i = 0; i < nRows; i++) {
+    if (labels[i] != 1 && labels[i] != -1) {
+      string err = "SMOSolver::train. Labels are expected to be +1 or -1.";
+      throw (err);
+    }
+    if (labels[i] > 0)
+      nPositive++;
+  }
+  if (!nPositive || nPositive == nRows) {
+    string err = "SMOSolver::train. Training data has samples of only one class.";
+    throw (err);
+  }
+
+  // the diagonal of the kernel matrix. When C has not been given we use the
+  // SVM-Light default, which is the inverse of the squared average distance
+  // of the training samples from the origin in the kernel space
+  diagonal.resize(nRows);
+  vector<double> origin(nFeatures, 0.0);
+  double originKernel = kernel(&origin[0], &origin[0]);
+  double averageDistance = 0;
+  for (int i = 0; i < nRows; i++) {
+    const double* x = rows + (long)i * nFeatures;
+    diagonal[i] = kernel(i, i);
+    averageDistance += sqrt(fabs(diagonal[i] - 2 * kernel(x, &origin[0]) + originKernel));
+  }
+  averageDistance /= nRows;
+  if (C <= 0)
+    C = (averageDistance > 0)? 1.0 / (averageDistance * averageDistance) : 1.0;
+
+  // size the column cache using Globals::svmCacheSize megabytes
+  clearCache();
+  nCacheColumns = ((long)Globals::svmCacheSize * 1024 * 1024) / (sizeof(float) * nRows);
+  if (nCacheColumns < 2)
+    nCacheColumns = 2;
+  if (nCacheColumns > nRows)
+    nCacheColumns = nRows;
+  columnOwner.reserve(nCacheColumns);
+  columnSlot.assign(nRows, -1);
+
+  // at alpha = 0 the gradient of the objective is -1 everywhere
+  alpha.assign(nRows, 0.0);
+  vector<double> gradient(nRows, -1.0);
+
+  long maxIterations = (nRows > INT_MAX / 100)? INT_MAX : 100L * nRows;
+  if (maxIterations < 10000000)
+    maxIterations = 10000000;
+
+  long iteration = 0;
+  int i;
+  int j;
+  while (!selectWorkingSet(gradient, i, j)) {
+    if (++iteration > maxIterations) {
+      cout << "SMOSolver::train. Reached the maximum number of iterations." << endl;
+      break;
+    }
+
+    const float* Qi = getColumn(i);
+    const float* Qj = getColumn(j);
+
+    double oldAlphaI = alpha[i];
+    double oldAlphaJ = alpha[j];
+
+    // solve the two variable sub-problem analytically and clip the result
+    // to the box constraints
+    if (labels[i] != labels[j]) {
+      double quad = diagonal[i] + diagonal[j] + 2 * Qi[j];
+      if (quad <= 0)
+	quad = s_tau;
+      double delta = (-gradient[i] - gradient[j]) / quad;
+      double diff = alpha[i] - alpha[j];
+      alpha[i] += delta;
+      alpha[j] += delta;
+
+      if (diff > 0) {
+	if (alpha[j] < 0) {
+	  alpha[j] = 0;
+	  alpha[i] = diff;
+	}
+      } else {
+	if (alpha[i] < 0) {
+	  alpha[i] = 0;
+	  alpha[j] = -diff;
+	}
+      }
+      if (diff > 0) {
+	if (alpha[i] > C) {
+	  alpha[i] = C;
+	  alpha[j] = C - diff;
+	}
+      } else {
+	if (alpha[j] > C) {
+	  alpha[j] = C;
+	  alpha[i] = C + diff;
+	}
+      }
+    } else {
+      double quad = diagonal[i] + diagonal[j] - 2 * Qi[j];
+      if (quad <= 0)
+	quad = s_tau;
+      double delta = (gradient[i] - gradient[j]) / quad;
+      double sum = alpha[i] + alpha[j];
+      alpha[i] -= delta;
+      alpha[j] += delta;
+
+      if (sum > C) {
+	if (alpha[i] > C) {
+	  alpha[i] = C;
+	  alpha[j] = sum - C;
+	}
+	if (alpha[j] > C) {
+	  alpha[j] = C;
+	  alpha[i] = sum - C;
+	}
+      } else {
+	if (alpha[j] < 0) {
+	  alpha[j] = 0;
+	  alpha[i] = sum;
+	}
+	if (alpha[i] < 0) {
+	  alpha[i] = 0;
+	  alpha[j] = sum;
+	}
+      }
+    }
+
+    // update the gradient
+    double deltaI = alpha[i] - oldAlphaI;
+    double deltaJ = alpha[j] - oldAlphaJ;
+    for (int k = 0; k < nRows; k++)
+      gradient[k] += Qi[k] * deltaI + Qj[k] * deltaJ;
+  }
+
+  computeThreshold(gradient);
+  clearCache();
+}
+
+// computeThreshold
+// Method used to compute the threshold b from the gradient at the solution.
+// We average over the free support vectors, and if there are none we take
+// the midpoint of the feasible interval
+
+void SMOSolver::computeThreshold(vector<double>& gradient) {
+  double upper = DBL_MAX;
+  double lower = -DBL_MAX;
+  double sum = 0;
+  int nFree = 0;
+
+  for (int i = 0; i < nRows; i++) {
+    double yG = labels[i] * gradient[i];
+    if (alpha[i] >= C) {
+      if (labels[i] < 0)
+	upper = min(upper, yG);
+      else
+	lower = max(lower, yG);
+    } else if (alpha[i] <= 0) {
+      if (labels[i] > 0)
+	upper = min(upper, yG);
+      else
+	lower = max(lower, yG);
+    } else {
+      nFree++;
+      sum += yG;
+    }
+  }
+
+  // decision values are sum_i alpha_i y_i K(x_i, x) - b
+  b = (nFree > 0)? sum / nFree : (upper + lower) / 2;
+}
+
+// getNSupportVectors
+// Method that returns the number of samples with non-zero dual variables
+
+int SMOSolver::getNSupportVectors() {
+  int count = 0;
+  for (unsigned int i = 0; i < alpha.size(); i++)
+    if (alpha[i] > 0)
+      count++;
+  return count;
+}
+
+// save
+// Method used to write the trained model in the SVM-Light format. Support
+// vectors are written with their alpha * y followed by their features
+
+void SMOSolver::save(string filename) {
+  if (alpha.size() != (unsigned int)nRows || !nRows) {
+    string err = "SMOSolver::save. No model has been trained.";
+    throw (err);
+  }
+
+  ofstream file;
+  file.open((const char*)filename.c_str());
+  if (!file.good()) {
+    string err = "SMOSolver::save. Unable to open file " + filename;
+    throw (err);
+  }
+
+  file.precision(17);
+  file << "SVM-light Version " << VERSION << endl;
+  file << kernelParm.kernel_type << " # kernel type" << endl;
+  file << kernelParm.poly_degree << " # kernel parameter -d " << endl;
+  file << kernelParm.rbf_gamma << " # kernel parameter -g " << endl;
+  file << kernelParm.coef_lin << " # kernel parameter -s " << endl;
+  file << kernelParm.coef_const << " # kernel parameter -r " << endl;
+  file << kernelParm.custom << "# kernel parameter -u " << endl;
+  file << nFeatures << " # highest feature index " << endl;
+  file << nRows << " # number of training documents " << endl;
+  file << getNSupportVectors() + 1 << " # number of support vectors plus 1 " << endl;
+  file << b << " # threshold b, each following line is a SV (starting with alpha*y)" << endl;
+
+  for (int i = 0; i < nRows; i++) {
+    if (alpha[i] <= 0)
+      continue;
+    file << alpha[i] * labels[i] << " ";
+    const double* x = rows + (long)i * nFeatures;
+    for (int k = 0; k < nFeatures; k++)
+      file << k + 1 << ":" << x[k] << " ";
+    file << "#" << endl;
+  }
+
+  if (!file.good()) {
+    string err = "SMOSolver::save. Error writing file " + filename;
+    throw (err);
+  }
+  file.close();
+}
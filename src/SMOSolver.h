@@ -0,0 +1,85 @@
+#ifndef __SMOSOLVER_H
+#define __SMOSOLVER_H
+
+// SMOSolver.h
+// This file contains the definition of class SMOSolver. The solver trains a binary
+// SVM on dense, in-memory feature vectors using sequential minimal optimization
+// with second order working set selection (Fan, Chen and Lin, JMLR 2005). The
+// kernels and their default parameters are the ones used by SVM-Light, and the
+// trained model is written in the SVM-Light model format so that it can be loaded
+// with read_model for classification.
+// Unlike the SVM-Light learner, the solver keeps no global state, so several
+// instances can train concurrently
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <math.h>
+#include <float.h>
+#include <limits.h>
+#include <string.h>
+
+#include "Globals.h"
+
+// SVM Light stuff
+#ifdef __cplusplus
+extern "C" {
+#include "svm_common.h"
+}
+#endif
+
+using namespace std;
+
+class SMOSolver {
+ private:
+  KERNEL_PARM kernelParm;       // kernel type and parameters as in SVM-Light
+  double C;                     // the trade-off between margin and errors
+
+  // training data
+  const double* rows;           // row major feature vectors
+  const double* labels;         // +1 or -1 per row
+  int nRows;                    // the number of training samples
+  int nFeatures;                // the number of features per sample
+
+  // solution
+  vector<double> alpha;         // the dual variables
+  double b;                     // the threshold, as in SVM-Light
+
+  // kernel column cache. Column i holds y_i y_k K(x_i, x_k) for all k
+  vector<double> diagonal;      // K(x_i, x_i)
+  vector<float*> columns;       // the cached columns
+  vector<int> columnOwner;      // the sample index a cached column belongs to
+  vector<long> columnAge;       // the last time a cached column was used
+  vector<int> columnSlot;       // the cache slot for a sample, or -1
+  long clock;                   // a counter used to age cached columns
+  long nCacheColumns;           // the number of columns the cache may hold
+
+ public:
+  // Constructor that takes an SVM-Light kernel type. Kernel parameters are set
+  // to the SVM-Light defaults. A non-positive C is replaced by the SVM-Light
+  // default, which is computed from the training data
+  SMOSolver(long kernelType, double C = 0);
+  ~SMOSolver();
+
+  // method to train using nRows feature vectors of nFeatures values each,
+  // stored one after the other, and their +1/-1 labels. The data is expected
+  // to stay alive until the solver is destroyed
+  void train(const double* rows, int nRows, int nFeatures, const double* labels);
+
+  // method to write the model in the SVM-Light format
+  void save(string filename);
+
+  int getNSupportVectors();
+
+ private:
+  double kernel(int i, int j);
+  double kernel(const double* a, const double* x);
+  const float* getColumn(int i);
+  bool selectWorkingSet(vector<double>& gradient, int& i, int& j);
+  void computeThreshold(vector<double>& gradient);
+  void clearCache();
+};
+
+#endif // __SMOSOLVER_H
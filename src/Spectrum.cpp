@@ -0,0 +1,38 @@
+// Spectrum.cpp
+// This file contains the implementation of class Spectrum
+
+#include "Spectrum.h"
+
+// Class construction and destruction
+
+Spectrum::Spectrum() : nElements(0), data(0) {
+  size.width = size.height = 0;
+}
+
+Spectrum::Spectrum(CvSize s) : nElements(0), data(0) {
+  size.width = size.height = 0;
+  resize(s);
+}
+
+Spectrum::~Spectrum() {
+  if (data)
+    fftw_free(data);
+}
+
+// resize
+// Method used to set the size of the image whose transform the spectrum holds
+
+void Spectrum::resize(CvSize s) {
+  if (data && s.width == size.width && s.height == size.height)
+    return;
+
+  if (data)
+    fftw_free(data);
+  size = s;
+  nElements = size.height * ((size.width / 2) + 1);
+  data = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * nElements);
+  if (!data) {
+    string err = "Spectrum::resize. Unable to allocate the spectrum.";
+    throw (err);
+  }
+}
@@ -0,0 +1,45 @@
+#ifndef __SPECTRUM_H
+#define __SPECTRUM_H
+
+// Spectrum.h
+// This file contains the definition of class Spectrum. A spectrum owns the
+// buffer for the FFT of a preprocessed image of a given size. Filters transform
+// images straight into a spectrum, which can then be applied by any number of
+// filters of that size, so the transform is neither copied nor re-allocated
+// for each frame. The spectrum is valid until it is resized or destroyed
+
+#include <string>
+
+// The standard OpenCV headers
+#include <cv.h>
+
+// The fftw headers
+#include <fftw3.h>
+
+using namespace std;
+
+class Spectrum {
+ private:
+  CvSize size;                  // the size of the image
+  int nElements;                // the number of complex terms
+  fftw_complex* data;           // the terms
+
+  // spectra are not copied
+  Spectrum(const Spectrum& other);
+  Spectrum& operator=(const Spectrum& other);
+
+ public:
+  Spectrum();
+  Spectrum(CvSize size);
+  ~Spectrum();
+
+  // method to set the size of the image. The buffer is only re-allocated
+  // when the size changes
+  void resize(CvSize size);
+
+  CvSize getSize() { return size; }
+  int getNElements() { return nElements; }
+  fftw_complex* getData() { return data; }
+};
+
+#endif // __SPECTRUM_H
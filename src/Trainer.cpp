@@ -4,17 +4,17 @@
 // 1. Create a set of feature extraction objects
 // 2. Create an annotations object and read annotations
 // 3. Iterate over annotations and extract features
-// 4. Write features into files
-// 5. Invoke SVM-Light to generate models
+// 4. Write features into a feature store file
+// 5. Train one model per zone, all zones concurrently, from the mapped file
 // 
-// At this point we use SVM-Light as an external process. Eventually, 
-// we see creating an SVM-Light library that we can then use directly
-// without resorting to using it as an extraneous process
+// The SVM-Light learner keeps its state in globals and can only train one
+// model at a time per process. We therefore train with our own solver, which
+// writes models in the SVM-Light format
 
 #include "Trainer.h"
 
 // static member initialization
-int Trainer::nSamplesBeforeFlush = Globals::largeBufferSize;
+int Trainer::nFramesPerBatch = 64;
 
 // Class construction and destruction
 
@@ -25,7 +25,7 @@ int Trainer::nSamplesBeforeFlush = Globals::largeBufferSize;
 
 Trainer::Trainer(string output, KernelType type,
 		 Location* le, Location* re, Location* n,
-		 roiFnT roiFn, string svm) {
+		 roiFnT roiFn) {
   // check if the output directory exists, or else bail
   DIR* dir;
   struct dirent *ent;
@@ -47,7 +47,6 @@ Trainer::Trainer(string output, KernelType type,
   
   kernelType = type;
   outputDirectory = output;
-  svmPath = (svm != "")? svm + "/" : svm;
   roiFunction = roiFn;
   leftEye = le;
   rightEye = re;
@@ -55,127 +54,195 @@ Trainer::Trainer(string output, KernelType type,
 
   // Build a set of feature extraction objects and stuff them into the
   // extractor vector
-  Feature* f = (Feature*) new FeatureLX();
-  featureExtractors.push_back(f);
-  f = (Feature*) new FeatureRX();
-  featureExtractors.push_back(f);
-  f = (Feature*) new FeatureNX();
-  featureExtractors.push_back(f);
-  f = (Feature*) new FeatureLRDist();
-  featureExtractors.push_back(f);
-  f = (Feature*) new FeatureLNDist();
-  featureExtractors.push_back(f);
-  f = (Feature*) new FeatureRNDist();
-  featureExtractors.push_back(f);
-  f = (Feature*) new FeatureLNAngle();
-  featureExtractors.push_back(f);
-  f = (Feature*) new FeatureRNAngle();
-  featureExtractors.push_back(f);
-  f = (Feature*) new FeatureLRNArea();
-  featureExtractors.push_back(f);
-
-  nFeatures = (int)Feature::End - 1;
+  createFeatureExtractors(featureExtractors);
+
+  nFeatures = FeaturePipeline<FeatureSet>::size;
+  features = new FeatureStore(nFeatures);
+
+  // per thread location extractors
+  int nThreads = omp_get_max_threads();
+  for (int i = 0; i < nThreads; i++) {
+    if (leftEye && rightEye && nose) {
+      leftEyes.push_back(leftEye->clone());
+      rightEyes.push_back(rightEye->clone());
+      noses.push_back(nose->clone());
+    }
+  }
 }
 
 Trainer::~Trainer() {
   for (int i = 0; i < nFeatures; i++)
     delete featureExtractors[i];
-  for (unsigned int i = 0; i < data.size(); i++)
-    delete data[i];
-}
-
-// getLocations
-// Method used to get the LOIs for a given frame using the filters for the
-// left eye, right eye and nose
-
-bool Trainer::getLocations(IplImage* frame, FrameAnnotation& fa) {
-  if (!nose || !leftEye || !rightEye) {
-    string err = "Classifier::getZone. Location extractors malformed.";
-    throw (err);
+  for (unsigned int i = 0; i < leftEyes.size(); i++) {
+    delete leftEyes[i];
+    delete rightEyes[i];
+    delete noses[i];
   }
+  delete features;
+}
 
-  bool isValid = true;
-
-  // the roi offset
-  CvPoint offset;
+// createFeatureExtractors
+// Method used to create one feature extraction object per feature of the
+// feature set, in the order of the set
 
-  // LOIs
-  CvPoint leftEyeLocation;
-  CvPoint rightEyeLocation;
-  CvPoint noseLocation;
+void Trainer::createFeatureExtractors(vector<Feature*>& extractors) {
+  FeaturePipeline<FeatureSet>::create(extractors);
+}
 
-  // computing the confidence of the location identification
-  double leftPSR;
-  double rightPSR;
-  double nosePSR;
+// getEyePeaks
+// Method used to get the unsmoothed locations of the eyes in a frame using the
+// eye extractors of the given thread. The locations are relative to the face
+// ROI, whose offset is returned in offset
 
+void Trainer::getEyePeaks(IplImage* frame, FrameAnnotation& fa, int thread,
+			  CvPoint& offset, CvPoint2D64f& left, CvPoint2D64f& right) {
   offset.x = offset.y = 0;
   IplImage* roi = (roiFunction)? roiFunction(frame, fa, offset, Annotations::Face) : 0;
 
   // all location extractors do identical preprocessing. Therefore, preprocess
-  // once using say the left eye extractor and re-use it for all three extractors
+  // once using the left eye extractor and re-use it for the right eye. Both
+  // eye filters are applied at once when they can be paired
+  Location* leftEye = leftEyes[thread];
+  Location* rightEye = rightEyes[thread];
   fftw_complex* preprocessedImage = leftEye->getPreprocessedImage((roi)? roi : frame);
 
-  #pragma omp parallel sections num_threads(2)
-  {
-    #pragma omp section
-    {
-      leftEye->setImage(preprocessedImage);
-      leftEye->apply();
-      leftEye->getMaxLocation(leftEyeLocation, leftPSR);
-      leftEyeLocation.x += offset.x;
-      leftEyeLocation.y += offset.y;
-    }
-
-    #pragma omp section
-    {
-      // get the location of the right eye
-      rightEye->setImage(preprocessedImage);
-      rightEye->apply();
-      rightEye->getMaxLocation(rightEyeLocation, rightPSR);
-      rightEyeLocation.x += offset.x;
-      rightEyeLocation.y += offset.y;
-    }
+  if (!Location::applyPair(leftEye, rightEye, preprocessedImage)) {
+    leftEye->setImage(preprocessedImage);
+    leftEye->apply();
+    rightEye->setImage(preprocessedImage);
+    rightEye->apply();
   }
+  leftEye->getPeakLocation(left);
+  rightEye->getPeakLocation(right);
 
+  fftw_free(preprocessedImage);
   if (roi)
     cvReleaseImage(&roi);
+}
 
-  CvPoint center;
-  center.x = (leftEyeLocation.x + rightEyeLocation.x) / 2;
-  center.y = leftEyeLocation.y + Globals::noseDrop;
-
-  fa.setNose(center);
+// getNosePeak
+// Method used to get the unsmoothed location of the nose in a frame using the
+// nose extractor of the given thread. The nose location in the frame annotation
+// is expected to be the approximate location derived from the eyes
 
+void Trainer::getNosePeak(IplImage* frame, FrameAnnotation& fa, int thread,
+			  CvPoint& offset, CvPoint2D64f& location) {
   offset.x = offset.y = 0;
-  roi = (roiFunction)? roiFunction(frame, fa, offset, Annotations::Nose) : 0;
+  IplImage* roi = (roiFunction)? roiFunction(frame, fa, offset, Annotations::Nose) : 0;
 
-  // free the preprocessed image
-  fftw_free(preprocessedImage);
-
-  // all location extractors do identical preprocessing. Therefore, preprocess
-  // once using say the left eye extractor and re-use it for all three extractors
-  preprocessedImage = nose->getPreprocessedImage((roi)? roi : frame);
+  Location* nose = noses[thread];
+  fftw_complex* preprocessedImage = nose->getPreprocessedImage((roi)? roi : frame);
 
-  // get the location of the nose
   nose->setImage(preprocessedImage);
   nose->apply();
-  nose->getMaxLocation(noseLocation, nosePSR);
-  noseLocation.x += offset.x;
-  noseLocation.y += offset.y;
+  nose->getPeakLocation(location);
 
-  // free the preprocessed image
   fftw_free(preprocessedImage);
-
-  fa.setLeftIris(leftEyeLocation);
-  fa.setRightIris(rightEyeLocation);
-  fa.setNose(noseLocation);
-
-  // we are done with the images at this point. Free roi if not zero
   if (roi)
     cvReleaseImage(&roi);
+}
+
+// getLocations
+// Method used to get the LOIs for a batch of frames using the filters for the
+// left eye, right eye and nose. The filters are applied to the frames in
+// parallel, but the locations they find are smoothed over past frames, so the
+// work is done in phases,
+// 1. Load frames and find the raw eye locations, in parallel
+// 2. Smooth the eye locations in frame order and derive the nose ROI
+// 3. Find the raw nose locations, in parallel
+// 4. Smooth the nose locations in frame order
+// This gives the same locations as processing one frame at a time
+
+void Trainer::getLocations(string directory, vector<FrameAnnotation*>& frames) {
+  // each thread uses its own copies of the extractors
+  int nThreads = leftEyes.size();
+  if (!nose || !leftEye || !rightEye || nThreads < 1 ||
+      (int)rightEyes.size() != nThreads || (int)noses.size() != nThreads) {
+    string err = "Trainer::getLocations. Location extractors malformed.";
+    throw (err);
+  }
 
-  return isValid;
+  int nFrames = frames.size();
+
+  vector<IplImage*> images(nFrames, (IplImage*)0);
+  vector<CvPoint> offsets(nFrames);
+  vector<CvPoint2D64f> leftEyeLocations(nFrames);
+  vector<CvPoint2D64f> rightEyeLocations(nFrames);
+  vector<CvPoint2D64f> noseLocations(nFrames);
+  vector<string> errors(nFrames);
+
+  #pragma omp parallel for schedule(dynamic) num_threads(nThreads)
+  for (int i = 0; i < nFrames; i++) {
+    char buffer[Globals::midBufferSize];
+    sprintf(buffer, "frame_%d.png", frames[i]->getFrameNumber());
+    string fileName = buffer;
+    fileName = directory + "/" + fileName;
+    images[i] = cvLoadImage((const char*)fileName.c_str());
+    if (!images[i]) {
+      errors[i] = "Trainer::addTrainingSet. Fatal. Cannot load image " + fileName;
+      continue;
+    }
+    try {
+      getEyePeaks(images[i], *frames[i], omp_get_thread_num(), offsets[i],
+		  leftEyeLocations[i], rightEyeLocations[i]);
+    } catch (string err) {
+      errors[i] = err;
+    }
+  }
+
+  // report the first error in frame order
+  for (int i = 0; i < nFrames; i++) {
+    if (errors[i] != "") {
+      for (int j = 0; j < nFrames; j++)
+	if (images[j])
+	  cvReleaseImage(&images[j]);
+      throw (errors[i]);
+    }
+  }
+
+  for (int i = 0; i < nFrames; i++) {
+    CvPoint2D64f location;
+    leftEye->smoothLocation(leftEyeLocations[i], location);
+    leftEyeLocations[i].x = location.x + offsets[i].x;
+    leftEyeLocations[i].y = location.y + offsets[i].y;
+
+    rightEye->smoothLocation(rightEyeLocations[i], location);
+    rightEyeLocations[i].x = location.x + offsets[i].x;
+    rightEyeLocations[i].y = location.y + offsets[i].y;
+
+    CvPoint center;
+    center.x = cvRound((leftEyeLocations[i].x + rightEyeLocations[i].x) / 2);
+    center.y = cvRound(leftEyeLocations[i].y) + Globals::noseDrop;
+
+    frames[i]->setNose(center);
+  }
+
+  #pragma omp parallel for schedule(dynamic) num_threads(nThreads)
+  for (int i = 0; i < nFrames; i++) {
+    try {
+      getNosePeak(images[i], *frames[i], omp_get_thread_num(), offsets[i],
+		  noseLocations[i]);
+    } catch (string err) {
+      errors[i] = err;
+    }
+  }
+
+  for (int i = 0; i < nFrames; i++)
+    cvReleaseImage(&images[i]);
+  for (int i = 0; i < nFrames; i++)
+    if (errors[i] != "")
+      throw (errors[i]);
+
+  for (int i = 0; i < nFrames; i++) {
+    CvPoint2D64f location;
+    nose->smoothLocation(noseLocations[i], location);
+    noseLocations[i].x = location.x + offsets[i].x;
+    noseLocations[i].y = location.y + offsets[i].y;
+
+    frames[i]->setLeftIris(leftEyeLocations[i]);
+    frames[i]->setRightIris(rightEyeLocations[i]);
+    frames[i]->setNose(noseLocations[i]);
+  }
 }
 
 // addTrainingSet
@@ -183,7 +250,9 @@ bool Trainer::getLocations(IplImage* frame, FrameAnnotation& fa) {
 // is expected to contain a file called <annotations.xml> which contains the 
 // locations of interest for each frame and a zone of interest for that frame.
 // For every annotation we extract a set of features using the extractors and 
-// store them as strings in the format expected by SVM-Light
+// add them to the feature store along with the zone and frame number. Frames
+// and features are processed in parallel, and samples are added to the store
+// in the order of the annotations
 
 void Trainer::addTrainingSet(string trainingDataDirName) {
   Annotations annotations;
@@ -198,143 +267,70 @@ void Trainer::addTrainingSet(string trainingDataDirName) {
   cout << "Center in " << trainingDataDirName << " is (" << center.x << ", " << 
     center.y << ")" << endl;
 
+  int source = features->addSource(trainingDataDirName);
+
   // now get the set of all annotations
   vector<FrameAnnotation*> frameAnnotations = annotations.getFrameAnnotations();
-  for (unsigned int i = 0; i < frameAnnotations.size(); i++) {
-    FrameAnnotation* fa = frameAnnotations[i];
+  int nFrames = frameAnnotations.size();
 
-    // check if the annotations exist. If they don't, we extract them using
-    // the filters and then train based on the identified locations
+  // check if the annotations exist. If they don't, we extract them using
+  // the filters and then train based on the identified locations
+  vector<FrameAnnotation*> unannotated;
+  for (int i = 0; i < nFrames; i++) {
+    FrameAnnotation* fa = frameAnnotations[i];
     CvPoint& leftEye = fa->getLOI(Annotations::LeftEye);
     if (!leftEye.x && !leftEye.y) {
       fa->setFace(center);
-
-      char buffer[Globals::midBufferSize];
-      sprintf(buffer, "frame_%d.png", fa->getFrameNumber());
-      string fileName = buffer;
-      fileName = trainingDataDirName + "/" + fileName;
-      IplImage* frame = cvLoadImage((const char*)fileName.c_str());
-      if (!frame) {
-        string str = "Trainer::addTrainingSet. Fatal. Cannot load image " + fileName;
-        throw(str);
-      }
-      bool isValid = getLocations(frame, *fa);
-      cvReleaseImage(&frame);
-      if (!isValid)
-	continue;
+      unannotated.push_back(fa);
     }
+  }
+  for (unsigned int i = 0; i < unannotated.size(); i += nFramesPerBatch) {
+    unsigned int end = min(i + nFramesPerBatch, (unsigned int)unannotated.size());
+    vector<FrameAnnotation*> batch(unannotated.begin() + i, unannotated.begin() + end);
+    getLocations(trainingDataDirName, batch);
+  }
 
-    // allocate a DataClass for feature values and their class
-    DataClass* dc = new DataClass(fa->getZone());
-
-    // for each annotation, extract all features and create a line with
-    // training data in the SVM Light format
-    for (unsigned int j = 0; j < featureExtractors.size(); j++) {
-      double value = featureExtractors[j]->extract(fa);
-      dc->add(value);
-    }
-
-    // now stuff the DataClass object into the data vector
-    data.push_back(dc);
-  }  
-}
-
-// normalize
-// Method to normalize all training data to be in the range [-1, 1]. We accumulate
-// the min and max feature values when we extract features in the feature extractors.
-// Notice that the min and max values may change as we process different training
-// data sets. Once all training sets have been added, we have the global min and max
-// values for all features across all training samples. We therefore expect this
-// method to be called from within generate after all calls to addTrainingSet have
-// been made
-
-void Trainer::normalize() {
-  // first compute averages and ranges
-  vector<double> average;
-  vector<double> spread;
-
-  // we normalize all data points to lie in the interval [-1, 1] using the
-  // average of the extremal values and their spread
-  for (unsigned int i = 0; i < featureExtractors.size(); i++) {
-    // feature specific normalization
-    double min = featureExtractors[i]->getMinVal();
-    double max = featureExtractors[i]->getMaxVal();
-
-    average.push_back((max + min) / 2.0);
-    spread.push_back(max - min);
+  // extract all features of all annotations at once, and widen the feature
+  // ranges to cover them
+  FeatureBatch batch;
+  batch.set(frameAnnotations);
+  vector<double> columns(nFrames * nFeatures);
+  if (nFrames)
+    batch.extract(&columns[0]);
+
+  vector<double> mins(nFeatures);
+  vector<double> maxs(nFeatures);
+  for (int j = 0; j < nFeatures; j++) {
+    mins[j] = featureExtractors[j]->getMinVal();
+    maxs[j] = featureExtractors[j]->getMaxVal();
+  }
+  if (nFrames)
+    FeatureBatch::reduce(&columns[0], nFrames, &mins[0], &maxs[0]);
+  for (int j = 0; j < nFeatures; j++) {
+    featureExtractors[j]->setMinVal(mins[j]);
+    featureExtractors[j]->setMaxVal(maxs[j]);
   }
 
-  // iterate over all data vectors and normalize each of them using the vector
-  // of averages.
-  DataClass* dc;
-  vector<double>* values;
-  unsigned int j;
-
-  #pragma omp parallel for num_threads(omp_get_max_threads()) private(dc, values, j)
-  for (unsigned int i = 0; i < data.size(); i++) {
-    dc = data[i];
-    values = &(dc->getData());
-
-    // normalize each value
-    // note that the size of values will be the same as the number of feature 
-    // extractors
-    for (j = 0; j < values->size(); j++) {
-      (*values)[j] = ((*values)[j] - average[j]) / spread[j]; 
-    }
+  vector<double> values(nFeatures);
+  for (int i = 0; i < nFrames; i++) {
+    FrameAnnotation* fa = frameAnnotations[i];
+    for (int j = 0; j < nFeatures; j++)
+      values[j] = columns[j * nFrames + i];
+    features->add(fa->getZone(), source, fa->getFrameNumber(), values);
   }
 }
 
 // write
-// Method used to write all training samples into their respective zone specific
-// files
+// Method used to write the feature store and the feature ranges that are used
+// for normalization by the classifier
 
 void Trainer::write() {
-  // we open as many files as the number of zones. We compose a line in the SVM
-  // Light format for each DataClass object in the data vector, prepend whether
-  // or not it is a positive or negative sample for a given zone and write it 
-  // into the zone specific output file
-
-  // training and model data filename prefix
-  string prefix = "zone_";
-
-  // output files
-  vector<ofstream*> files;
-
-  for (unsigned int i = 0; i < Globals::numZones; i++) {
-    char buffer[Globals::smallBufferSize];
-    sprintf(buffer, "%d.data", i + 1);
-    string str = buffer;
-    string filename = outputDirectory + "/" + prefix + str;
-    ofstream* file = new ofstream();
-    file->open((const char*)filename.c_str());
-    if (!file->good()) {
-      string err = "Trainer::write. Unable to open file " + filename;
-      throw (err);
-    }
-    files.push_back(file);
-  }
+  // the feature ranges are only known once all training sets have been added
+  for (unsigned int i = 0; i < featureExtractors.size(); i++)
+    features->setRange(i, featureExtractors[i]->getMinVal(),
+		       featureExtractors[i]->getMaxVal());
 
-  // now iterate over all data vectors and write them to each file
-  for (unsigned int i = 0; i < data.size(); i++) {
-    DataClass* dc = data[i];
-    
-    string line = dc->getDataSVMLight();
-    for (unsigned int i = 0; i < Globals::numZones; i++) {
-      int zone = i + 1;
-      string str = "";
-      if (dc->getZone() == zone)
-	str = "1" + line;
-      else
-	str = "-1" + line;
-      (*files[i]) << str << endl;
-    }
-  }
-
-  // close all files and free up memory
-  for (unsigned int i = 0; i < files.size(); i++) {
-    files[i]->close();
-    delete files[i];
-  }
+  features->save(outputDirectory + "/" + Globals::featuresFileName);
 
   // Now write out a parameter values file that will be used for
   // classification
@@ -348,7 +344,7 @@ void Trainer::write() {
     paramsFile << "<?xml version=\"1.0\"?>" << endl;
     paramsFile << "<parameters>" << endl;
     for (unsigned int i = 0; i < featureExtractors.size(); i++) {
-      paramsFile << "  <feature id=\"" << Feature::featureNames[i] << "\">" << endl;
+      paramsFile << "  <feature id=\"" << featureExtractors[i]->getName() << "\">" << endl;
       paramsFile << "    <min>" << featureExtractors[i]->getMinVal() << "</min>" << endl;
       paramsFile << "    <max>" << featureExtractors[i]->getMaxVal() << "</max>" << endl;
       paramsFile << "  </feature>" << endl;
@@ -358,37 +354,74 @@ void Trainer::write() {
   }
 }
 
-// generate
-// Method to generate models from training data files. This method is expected
-// to be called once the training data has been used to extract features. At this 
-// point we call SVM-Light as a separate executable for training after generating
-// data files int the format required by SVM-Light
+// train
+// Method used to train one model per zone. The training samples are normalized
+// to lie in [-1, 1], using the average of the extremal values of each feature
+// and their spread, and copied once into a row major matrix that all zones
+// share. Each zone labels the samples annotated with it as positive and the
+// rest as negative, and zones are trained concurrently. Errors are collected
+// per zone and reported once all zones are done
+
+void Trainer::train(FeatureStore& store) {
+  int nRows = store.getNRows();
+  if (!nRows) {
+    string err = "Trainer::train. No training samples.";
+    throw (err);
+  }
 
-void Trainer::generate() {
-  // first normalize all data points
-  normalize();
+  vector<double> rows(nRows * nFeatures);
+  for (int j = 0; j < nFeatures; j++) {
+    const float* column = store.getColumn(j);
+    double average = (store.getMaxVal(j) + store.getMinVal(j)) / 2.0;
+    double spread = store.getMaxVal(j) - store.getMinVal(j);
+    for (int i = 0; i < nRows; i++)
+      rows[i * nFeatures + j] = (column[i] - average) / spread;
+  }
 
-  // generate data in the format expected by SVM-Light
-  write();
+  int nZones = (int)Globals::numZones;
+  vector<string> errors(nZones);
 
-  // generate models using svm_learn
-  for (unsigned int i = 0; i < Globals::numZones; i++) {
+  #pragma omp parallel for schedule(dynamic) num_threads(nZones)
+  for (int zone = 0; zone < nZones; zone++) {
     char buffer[Globals::smallBufferSize];
-    sprintf(buffer, "%d.model", i + 1);
+    sprintf(buffer, "%d.model", zone + 1);
     string str = buffer;
     string modelName = outputDirectory + "/" + Globals::modelNamePrefix + str;
-    
-    sprintf(buffer, "zone_%d.data", i + 1);
-    str = buffer;
-    string dataFileName = outputDirectory + "/" + str;
-
-    // compose command
-    sprintf(buffer, "-t %d", kernelType);
-    string kernelTypeStr = buffer;
-    string cmd = svmPath + "svm_learn " + kernelTypeStr + " " + dataFileName + " " + modelName;
-    int result = system((const char*)cmd.c_str());
-    if (result != 0) {
-      ; // ignore for now
+
+    vector<double> labels(nRows);
+    for (int i = 0; i < nRows; i++)
+      labels[i] = (store.getZone(i) == zone + 1)? 1 : -1;
+
+    try {
+      SMOSolver solver(kernelType);
+      solver.train(&rows[0], nRows, nFeatures, &labels[0]);
+      solver.save(modelName);
+    } catch (string err) {
+      sprintf(buffer, "zone %d: ", zone + 1);
+      str = buffer;
+      errors[zone] = str + err;
     }
   }
+
+  string err = "";
+  for (int zone = 0; zone < nZones; zone++)
+    if (errors[zone] != "")
+      err += ((err != "")? "\n" : "") + errors[zone];
+  if (err != "") {
+    err = "Trainer::train. Unable to train models.\n" + err;
+    throw (err);
+  }
+}
+
+// generate
+// Method to generate models from training data. This method is expected to be
+// called once the training data has been used to extract features. The feature
+// store is written once and models are trained from the mapped file
+
+void Trainer::generate() {
+  write();
+
+  // generate a model per zone
+  FeatureStore store(outputDirectory + "/" + Globals::featuresFileName);
+  train(store);
 }
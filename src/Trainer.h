@@ -4,8 +4,8 @@
 // Trainer.h
 // This file contains the definition of class Trainer. We use this class to train
 // a model based on a set of features that we extract using a set of feature objects.
-// We use SVM-Light for training and classification. This class provides a wrapper
-// around the functionality provided by SVM-Light to train our model
+// Models are trained in-process, one per zone, and written in the SVM-Light model
+// format that the classifier reads
 
 #include <sys/types.h>
 #include <dirent.h>
@@ -18,16 +18,11 @@
 
 #include "Globals.h"
 #include "Annotations.h"
-#include "FeatureLX.h"
-#include "FeatureRX.h"
-#include "FeatureNX.h"
-#include "FeatureLRDist.h"
-#include "FeatureLNDist.h"
-#include "FeatureRNDist.h"
-#include "FeatureLNAngle.h"
-#include "FeatureRNAngle.h"
-#include "FeatureLRNArea.h"
+#include "FeatureSet.h"
 #include "Location.h"
+#include "SMOSolver.h"
+#include "FeatureStore.h"
+#include "FeatureBatch.h"
 
 // openCV stuff
 #include <cv.h>
@@ -35,58 +30,37 @@
 
 using namespace std;
 
-// helper type used to store data vectors and the class they belong to
-// as annotated in the frame from which the data has been extracted
-
-class DataClass {
- private:
-  int zone;
-  vector<double> data;
- 
- public:
-  DataClass(int z) : zone(z) { }
-  ~DataClass() { }
-
-  int getZone() { return zone; }
-  void add(double value) { data.push_back(value); }
-  vector<double>& getData() { return data; }
-
-  string getDataSVMLight() {
-    string line = "";
-    for (unsigned int i = 0; i < data.size(); i++) {
-      char buffer[32];
-      sprintf(buffer, " %d:%f", i + 1, data[i]);
-      string str = buffer;
-      line += str;
-    }
-    return line;
-  }
-};
-
 class Trainer {
  private:
   string outputDirectory;       // the output directory name for all generated data
-  string svmPath;               // optional path to the SVM Light executables
 
   // vector of feature extraction objects
   vector<Feature*> featureExtractors;
 
   int nFeatures;                // the number of features
 
-  // vector of DataClass objects used to store features and the class for
-  // those features as specified in the frame annotations
-  vector<DataClass*> data;
-
-  // the number of samples to accumulate before flushing them to file
-  static int nSamplesBeforeFlush;
+  // the raw feature values of all training samples, along with the zone of
+  // each sample as specified in the frame annotations
+  FeatureStore* features;
 
   // locations of interest extractors
   Location* leftEye;            // the left eye location extractor
   Location* rightEye;           // the right eye location extractor
   Location* nose;               // the nose extractor
 
+  // copies of the location extractors, one per thread, used to find the raw
+  // locations of interest concurrently. Smoothing the locations across frames
+  // is done in frame order using the extractors above
+  vector<Location*> leftEyes;
+  vector<Location*> rightEyes;
+  vector<Location*> noses;
+
   roiFnT roiFunction;           // the ROI extractor
 
+  // the number of frames that are loaded and processed together when
+  // extracting locations of interest
+  static int nFramesPerBatch;
+
  public:
   enum KernelType {
     Linear = 0,
@@ -98,7 +72,7 @@ class Trainer {
  public:
   Trainer(string output, KernelType kernelType, 
 	  Location* le, Location* re, Location* n,
-	  roiFnT roiFunction = 0, string svmPath = "");
+	  roiFnT roiFunction = 0);
   virtual ~Trainer();
 
   // method to add training data directories
@@ -107,12 +81,20 @@ class Trainer {
   // method to create models
   virtual void generate();
 
+  // method to create one feature extraction object per feature, in the order
+  // of the feature ids
+  static void createFeatureExtractors(vector<Feature*>& extractors);
+
  private:
-  KernelType kernelType;        // the Kernel type for learning direct from SVM Light
+  KernelType kernelType;        // the Kernel type, numbered as in SVM Light
 
   void write();
-  void normalize();
-  bool getLocations(IplImage* frame, FrameAnnotation& fa);
+  void train(FeatureStore& store);
+  void getLocations(string directory, vector<FrameAnnotation*>& frames);
+  void getEyePeaks(IplImage* frame, FrameAnnotation& fa, int thread,
+		   CvPoint& offset, CvPoint2D64f& left, CvPoint2D64f& right);
+  void getNosePeak(IplImage* frame, FrameAnnotation& fa, int thread,
+		   CvPoint& offset, CvPoint2D64f& location);
 };
 
 #endif
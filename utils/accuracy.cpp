@@ -1,39 +1,126 @@
 // accuracy.cpp
-// Code that computes the accuracy of filters and the classifier
+// Code that computes the accuracy of filters and the classifier. Evaluation
+// can be split into shards that are run as separate processes, possibly on
+// separate machines. Each shard writes its result into a file and the results
+// are then merged
+
+#include <sys/time.h>
 
 #include "GazeTracker.h"
 
 using namespace std;
 
+static void usage() {
+  cout << "Usage: accuracy <modelsDirectory> <trainingDirectory>... " <<
+    "[--shard <i>/<n>] [--output <resultFile>] [--filters] " <<
+    "[--pyramid <eyeFactor>,<noseFactor>]" << endl;
+  cout << "       accuracy --merge <resultFile>..." << endl;
+}
+
+static double getTime() {
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static void printResult(EvaluationResult& result, bool filters) {
+  if (filters) {
+    Annotations::Tag tags[] = { Annotations::LeftEye, Annotations::RightEye,
+				Annotations::Nose };
+    string names[] = { "Left eye", "Right eye", "Nose" };
+    for (int i = 0; i < 3; i++)
+      cout << names[i] << " filter error (1-norm, 2-norm, MSE) = (" <<
+	result.getOneNormError(tags[i]) << ", " << result.getTwoNormError(tags[i]) <<
+	", " << result.getMSE(tags[i]) << ") over " <<
+	result.getNFilterFrames(tags[i]) << " frames" << endl;
+  }
+
+  // print out the percentage of miss-classifications for the classifier
+  cout << "Classifier Error = " << result.getError() << "%" << endl;
+  cout << "Classifier Zone Error = " << result.getZoneError() << "%" << endl;
+  cout << "Classifier message = " << result.getMessage() << endl;
+}
+
 int main(int argc, char** argv) {
   if (argc < 3) {
-    cout << "Usage: accuracy <modelsDirectory> <trainingDirectory>" << endl;
+    usage();
     return -1;
   }
 
-  string modelsDirectory = argv[1];
-  string trainingDirectory = argv[2];
-
   try {
+    if (string(argv[1]) == "--merge") {
+      EvaluationResult result;
+      result.read(argv[2]);
+      for (int i = 3; i < argc; i++) {
+	EvaluationResult shardResult;
+	shardResult.read(argv[i]);
+	result.merge(shardResult);
+      }
+      printResult(result, result.getNFilterFrames(Annotations::LeftEye) > 0);
+      return 0;
+    }
+
+    string modelsDirectory = argv[1];
+    vector<string> directories;
+    string outputFile;
+    int shard = 0;
+    int nShards = 1;
+    bool filters = false;
+
+    for (int i = 2; i < argc; i++) {
+      string arg = argv[i];
+      if (arg == "--shard" && i + 1 < argc) {
+	if (sscanf(argv[++i], "%d/%d", &shard, &nShards) != 2) {
+	  usage();
+	  return -1;
+	}
+      } else if (arg == "--output" && i + 1 < argc)
+	outputFile = argv[++i];
+      else if (arg == "--filters")
+	filters = true;
+      else if (arg == "--pyramid" && i + 1 < argc) {
+	if (sscanf(argv[++i], "%d,%d", &Globals::eyePyramidFactor,
+		   &Globals::nosePyramidFactor) != 2) {
+	  usage();
+	  return -1;
+	}
+      }
+      else
+	directories.push_back(arg);
+    }
+    if (directories.empty()) {
+      usage();
+      return -1;
+    }
+
     GazeTracker tracker(modelsDirectory, false /* online */);
 
-    // print out error for each filter
-/*    double lError = tracker.getFilterAccuracy(trainingDirectory, 
-  					      Annotations::LeftEye, Classifier::OneNorm);
-    double rError = tracker.getFilterAccuracy(trainingDirectory, 
-  					      Annotations::RightEye, Classifier::OneNorm);
-    double nError = tracker.getFilterAccuracy(trainingDirectory, 
-  					      Annotations::Nose, Classifier::OneNorm);
-
-    cout << "Filter Error (L, R, N) = (" << lError << ", " << rError << ", " << nError << ")" << endl;
-*/
-    // print out the percentage of miss-classifications for the classifier
-    pair<double, string> error = tracker.getClassifierAccuracy(trainingDirectory);
-
-    cout << "Classifier Error = " << error.first << "%" << endl;
-    cout << "Classifier message = " << error.second << endl;
+    double start = getTime();
+    EvaluationResult result = tracker.evaluate(directories, shard, nShards);
+    if (result.getNFrames())
+      cout << "Classification time = " <<
+	(getTime() - start) / result.getNFrames() << " ms per frame" << endl;
+    if (filters) {
+      Annotations::Tag tags[] = { Annotations::LeftEye, Annotations::RightEye,
+				  Annotations::Nose };
+      for (int i = 0; i < 3; i++) {
+	start = getTime();
+	EvaluationResult filterResult = 
+	  tracker.evaluateFilter(directories, tags[i], shard, nShards);
+	if (filterResult.getNFilterFrames(tags[i]))
+	  cout << Filter::filterName(tags[i]) << " filter time = " <<
+	    (getTime() - start) / filterResult.getNFilterFrames(tags[i]) <<
+	    " ms per frame" << endl;
+	result.merge(filterResult);
+      }
+    }
+
+    if (outputFile != "")
+      result.write(outputFile);
+    printResult(result, filters);
   } catch (string err) {
     cout << err << endl;
+    return -1;
   }
 
   return 0;
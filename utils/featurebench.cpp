@@ -0,0 +1,111 @@
+// featurebench.cpp
+// Code that measures the time taken to extract each of the feature sets, using
+// the feature extraction objects one frame and one feature at a time and using
+// the feature pipeline of the set. The landmarks are random points in an image
+
+#include <sys/time.h>
+#include <stdlib.h>
+
+#include "FeatureSet.h"
+
+using namespace std;
+
+// now
+// Function that returns the wall clock time in seconds
+
+static double now() {
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// benchmark
+// Function that times the extraction of a feature set for a set of annotations
+// and checks that both extraction methods compute the same values
+
+template <class Set>
+static void benchmark(string name, vector<FrameAnnotation>& annotations, int nRuns) {
+  int n = annotations.size();
+  int nFeatures = FeaturePipeline<Set>::size;
+
+  vector<Feature*> extractors;
+  FeaturePipeline<Set>::create(extractors);
+
+  // extract using the feature extraction objects
+  vector<double> rows(n * nFeatures);
+  double start = now();
+  for (int r = 0; r < nRuns; r++)
+    for (int i = 0; i < n; i++)
+      for (int j = 0; j < nFeatures; j++)
+	rows[i * nFeatures + j] = extractors[j]->extract(&annotations[i]);
+  double objectTime = (now() - start) / nRuns;
+
+  // extract using the pipeline
+  vector<double> lx(n), ly(n), rx(n), ry(n), nx(n), ny(n);
+  for (int i = 0; i < n; i++) {
+    lx[i] = annotations[i].getLeftIris().x;
+    ly[i] = annotations[i].getLeftIris().y;
+    rx[i] = annotations[i].getRightIris().x;
+    ry[i] = annotations[i].getRightIris().y;
+    nx[i] = annotations[i].getNose().x;
+    ny[i] = annotations[i].getNose().y;
+  }
+  FeaturePoints points;
+  points.lx = &lx[0];
+  points.ly = &ly[0];
+  points.rx = &rx[0];
+  points.ry = &ry[0];
+  points.nx = &nx[0];
+  points.ny = &ny[0];
+
+  vector<double> columns(n * nFeatures);
+  start = now();
+  for (int r = 0; r < nRuns; r++)
+    FeaturePipeline<Set>::extract(points, n, &columns[0]);
+  double pipelineTime = (now() - start) / nRuns;
+
+  long mismatches = 0;
+  for (int i = 0; i < n; i++) {
+    for (int j = 0; j < nFeatures; j++) {
+      double a = rows[i * nFeatures + j];
+      double b = columns[j * n + i];
+      if (a != b && (a == a || b == b))
+	mismatches++;
+    }
+  }
+
+  cout << name << " (" << nFeatures << " features): objects " <<
+    objectTime * 1e9 / n << " ns/frame, pipeline " << pipelineTime * 1e9 / n <<
+    " ns/frame, speedup " << objectTime / pipelineTime << endl;
+  if (mismatches)
+    cout << "  " << mismatches << " values differ" << endl;
+
+  for (int j = 0; j < nFeatures; j++)
+    delete extractors[j];
+}
+
+int main(int argc, char** argv) {
+  int nFrames = (argc > 1)? atoi(argv[1]) : 100000;
+  int nRuns = (argc > 2)? atoi(argv[2]) : 20;
+  if (nFrames < 1 || nRuns < 1) {
+    cout << "Usage: featurebench [<nFrames> [<nRuns>]]" << endl;
+    return -1;
+  }
+
+  srand(1);
+  vector<FrameAnnotation> annotations(nFrames);
+  for (int i = 0; i < nFrames; i++) {
+    CvPoint l = cvPoint(rand() % Globals::imgWidth, rand() % Globals::imgHeight);
+    CvPoint r = cvPoint(rand() % Globals::imgWidth, rand() % Globals::imgHeight);
+    CvPoint n = cvPoint(rand() % Globals::imgWidth, rand() % Globals::imgHeight);
+    annotations[i].setLeftIris(l);
+    annotations[i].setRightIris(r);
+    annotations[i].setNose(n);
+  }
+
+  benchmark<StandardFeatures>("Standard", annotations, nRuns);
+  benchmark<CenterFeatures>("Center", annotations, nRuns);
+  benchmark<CornerFeatures>("Corner", annotations, nRuns);
+
+  return 0;
+}
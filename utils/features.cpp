@@ -0,0 +1,51 @@
+// features.cpp
+// Code that summarizes a feature file written during training and optionally
+// exports it as SVM-Light training files, one per zone
+
+#include "FeatureStore.h"
+
+using namespace std;
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    cout << "Usage: features <featureFile> [<exportDirectory>]" << endl;
+    return -1;
+  }
+
+  string featureFile = argv[1];
+
+  try {
+    FeatureStore store(featureFile);
+
+    cout << "Samples = " << store.getNRows() << ", features = " << 
+      store.getNFeatures() << endl;
+
+    // print the number of samples per zone
+    vector<long> counts(Globals::numZones + 1, 0);
+    for (long i = 0; i < store.getNRows(); i++) {
+      int zone = store.getZone(i);
+      if (zone > 0 && zone <= (int)Globals::numZones)
+	counts[zone]++;
+      else
+	counts[0]++;
+    }
+    for (unsigned int i = 1; i <= Globals::numZones; i++)
+      cout << "Zone " << i << " = " << counts[i] << endl;
+    if (counts[0])
+      cout << "Unknown zone = " << counts[0] << endl;
+
+    // print the feature ranges
+    for (int i = 0; i < store.getNFeatures(); i++)
+      cout << "Feature " << i + 1 << " range = [" << store.getMinVal(i) << ", " <<
+	store.getMaxVal(i) << "]" << endl;
+
+    if (argc > 2) {
+      string exportDirectory = argv[2];
+      store.exportSVMLight(exportDirectory);
+    }
+  } catch (string err) {
+    cout << err << endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,97 @@
+// filters.cpp
+// Code that creates filters in steps. Each frame set directory is trained
+// into its own accumulator checkpoints, which can be done in separate
+// processes, possibly on separate machines. The checkpoints are then merged
+// into filters. Adding a frame set only requires training that frame set
+// and merging its checkpoints with the existing ones. Filters can also be
+// cross validated, leaving out one frame set at a time
+
+#include "GazeTracker.h"
+
+using namespace std;
+
+static void usage() {
+  cout << "Usage: filters --train <outputDirectory> <checkpointDirectory> " <<
+    "<frameSetDirectory>... [--affine]" << endl;
+  cout << "       filters --merge <outputDirectory> <checkpoint>..." << endl;
+  cout << "       filters --cross-validate <outputDirectory> " <<
+    "<frameSetDirectory>... [--affine]" << endl;
+}
+
+static void printErrors(string name, EvaluationResult& result) {
+  Annotations::Tag tags[] = { Annotations::LeftEye, Annotations::RightEye,
+			      Annotations::Nose };
+  for (int i = 0; i < 3; i++)
+    cout << name << " " << Filter::filterName(tags[i]) <<
+      " error (1-norm, 2-norm, MSE) = (" << result.getOneNormError(tags[i]) <<
+      ", " << result.getTwoNormError(tags[i]) << ", " << result.getMSE(tags[i]) <<
+      ") over " << result.getNFilterFrames(tags[i]) << " frames" << endl;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 4) {
+    usage();
+    return -1;
+  }
+
+  try {
+    string mode = argv[1];
+    string outputDirectory = argv[2];
+
+    if (mode == "--train") {
+      string checkpointDirectory = argv[3];
+      GazeTracker tracker(outputDirectory, false /* online */);
+
+      int nSets = 0;
+      for (int i = 4; i < argc; i++) {
+	if (string(argv[i]) == "--affine")
+	  Globals::affineTraining = true;
+	else {
+	  tracker.addFrameSet(argv[i]);
+	  nSets++;
+	}
+      }
+      if (!nSets) {
+	usage();
+	return -1;
+      }
+
+      tracker.createCheckpoints(checkpointDirectory);
+    } else if (mode == "--cross-validate") {
+      GazeTracker tracker(outputDirectory, false /* online */);
+
+      vector<string> directories;
+      for (int i = 3; i < argc; i++) {
+	if (string(argv[i]) == "--affine")
+	  Globals::affineTraining = true;
+	else {
+	  tracker.addFrameSet(argv[i]);
+	  directories.push_back(argv[i]);
+	}
+      }
+
+      vector<EvaluationResult> results = tracker.crossValidateFilters();
+      EvaluationResult total;
+      for (unsigned int i = 0; i < results.size(); i++) {
+	printErrors(directories[i], results[i]);
+	total.merge(results[i]);
+      }
+      printErrors("All", total);
+    } else if (mode == "--merge") {
+      vector<string> checkpoints;
+      for (int i = 3; i < argc; i++)
+	checkpoints.push_back(argv[i]);
+
+      GazeTracker tracker(outputDirectory, false /* online */);
+      tracker.mergeCheckpoints(checkpoints);
+    } else {
+      usage();
+      return -1;
+    }
+  } catch (string err) {
+    cout << err << endl;
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,130 @@
+// sweep.cpp
+// Code that sweeps the filter parameters. Filters are trained on a set of
+// training directories and evaluated on a set of test directories for each
+// point of a grid of ROI sizes, window scales and gaussian widths. As with
+// createFilters, training frames are binned, and affine variants are used
+// when --affine is given. Frames are read from ROI caches, which are built on
+// first use and re-used by later sweeps. The results are written as a table,
+// one line per point and LOI
+
+#include "FilterSweep.h"
+
+using namespace std;
+
+static void usage() {
+  cout << "Usage: sweep <outputDirectory> <cacheDirectory> --train <directory>... " <<
+    "--test <directory>... [--roi <width>x<height>,...] " <<
+    "[--window <xScale>:<yScale>,...] [--gaussian <width>,...] " <<
+    "[--output <tableFile>] [--affine]" << endl;
+}
+
+// split a comma separated list
+static vector<string> split(string list) {
+  vector<string> items;
+  size_t start = 0;
+  while (start <= list.size()) {
+    size_t end = list.find(',', start);
+    if (end == string::npos)
+      end = list.size();
+    if (end > start)
+      items.push_back(list.substr(start, end - start));
+    start = end + 1;
+  }
+  return items;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 7) {
+    usage();
+    return -1;
+  }
+
+  try {
+    string outputDirectory = argv[1];
+    string cacheDirectory = argv[2];
+    vector<string> trainingDirectories;
+    vector<string> testDirectories;
+    vector<string>* directories = 0;
+    vector<CvSize> sizes;
+    vector<pair<double, double> > scales;
+    vector<int> widths;
+    string outputFile;
+
+    for (int i = 3; i < argc; i++) {
+      string arg = argv[i];
+      if (arg == "--train")
+	directories = &trainingDirectories;
+      else if (arg == "--test")
+	directories = &testDirectories;
+      else if (arg == "--roi" && i + 1 < argc) {
+	vector<string> items = split(argv[++i]);
+	for (unsigned int j = 0; j < items.size(); j++) {
+	  CvSize size;
+	  if (sscanf(items[j].c_str(), "%dx%d", &size.width, &size.height) != 2) {
+	    usage();
+	    return -1;
+	  }
+	  sizes.push_back(size);
+	}
+	directories = 0;
+      } else if (arg == "--window" && i + 1 < argc) {
+	vector<string> items = split(argv[++i]);
+	for (unsigned int j = 0; j < items.size(); j++) {
+	  double x, y;
+	  if (sscanf(items[j].c_str(), "%lf:%lf", &x, &y) != 2) {
+	    usage();
+	    return -1;
+	  }
+	  scales.push_back(make_pair(x, y));
+	}
+	directories = 0;
+      } else if (arg == "--gaussian" && i + 1 < argc) {
+	vector<string> items = split(argv[++i]);
+	for (unsigned int j = 0; j < items.size(); j++)
+	  widths.push_back(atoi(items[j].c_str()));
+	directories = 0;
+      } else if (arg == "--output" && i + 1 < argc) {
+	outputFile = argv[++i];
+	directories = 0;
+      } else if (arg == "--affine") {
+	Globals::affineTraining = true;
+	directories = 0;
+      } else if (directories)
+	directories->push_back(arg);
+      else {
+	usage();
+	return -1;
+      }
+    }
+    if (trainingDirectories.empty() || testDirectories.empty()) {
+      usage();
+      return -1;
+    }
+
+    FilterSweep sweep(outputDirectory, cacheDirectory, trainingDirectories,
+		      testDirectories);
+    for (unsigned int i = 0; i < sizes.size(); i++)
+      sweep.addROISize(sizes[i]);
+    for (unsigned int i = 0; i < scales.size(); i++)
+      sweep.addWindowScale(scales[i].first, scales[i].second);
+    for (unsigned int i = 0; i < widths.size(); i++)
+      sweep.addGaussianWidth(widths[i]);
+
+    if (outputFile != "") {
+      ofstream table;
+      table.open((const char*)outputFile.c_str());
+      if (!table.good()) {
+	cout << "Unable to open file " << outputFile << endl;
+	return -1;
+      }
+      sweep.run(table);
+      table.close();
+    } else
+      sweep.run(cout);
+  } catch (string err) {
+    cout << err << endl;
+    return -1;
+  }
+
+  return 0;
+}